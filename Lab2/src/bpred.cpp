@@ -8,9 +8,8 @@
 // Implements the branch predictor class.
 
 #include "bpred.h"
-#include <iostream>
-#include <vector>
-#include <bitset>
+#include "predictors.h"
+#include <stddef.h>
 
 /**
  * Construct a branch predictor with the given policy.
@@ -19,16 +18,33 @@
  * 
  * @param policy the policy this branch predictor should use
  */
-BPred::BPred(BPredPolicy policy)
+BPred::BPred(BPredPolicy policy) : BPred(policy, 0, 0)
+{
+}
+
+/**
+ * Construct a branch predictor with the given policy and size.
+ *
+ * @param policy the policy this branch predictor should use
+ * @param size_kb the storage budget in KB, or 0 for the policy's default
+ * @param hist_len the global history length, or 0 for the policy's default
+ *                 (ignored by policies without a configurable one)
+ */
+BPred::BPred(BPredPolicy policy, uint32_t size_kb, uint32_t hist_len)
 {
-    // TODO: Initialize member variables here.
     this->policy = policy;
     stat_num_branches = 0;
     stat_num_mispred = 0;
-    GHR = 0;
-    PHT.resize(entries, 2);
-    // As a reminder, you can declare any additional member variables you need
-    // in the BPred class in bpred.h and initialize them here.
+    impl = NULL;
+    if (policy != BPRED_PERFECT)
+    {
+        impl = make_dir_predictor(policy, size_kb, hist_len);
+    }
+}
+
+BPred::~BPred()
+{
+    delete impl;
 }
 
 /**
@@ -41,33 +57,9 @@ BPred::BPred(BPredPolicy policy)
  */
 BranchDirection BPred::predict(uint64_t pc)
 {
-    // TODO: Return a prediction for whether the branch at address pc will be
-    // TAKEN or NOT_TAKEN according to this branch predictor's policy.
-
     // Note that you do not have to handle the BPRED_PERFECT policy here; this
-    // function will not be called for that policy.    
-    if (policy == BPRED_ALWAYS_TAKEN)
-    {
-        return TAKEN;
-    }
-    else if(policy == BPRED_GSHARE)
-    {
-        //get lower 12 bits of pc
-        uint32_t lower_12_PC = pc & mask;
-        //XOR
-        xor_result = GHR ^ lower_12_PC;
-        //return section
-        if(PHT[xor_result]>1)
-        {
-            return TAKEN;
-        }
-        else
-        {
-            return NOT_TAKEN;
-        }
-    }
-    // This is just a placeholder.
-    return TAKEN;
+    // function will not be called for that policy.
+    return impl->predict(pc);
 }
 
 
@@ -85,43 +77,21 @@ BranchDirection BPred::predict(uint64_t pc)
 void BPred::update(uint64_t pc, BranchDirection prediction,
                    BranchDirection resolution)
 {
-    // TODO: Update the stat_num_branches and stat_num_mispred member variables
-    // according to the prediction and resolution of the branch.
     stat_num_branches++;
-    //std::cout<<"branches ++ "<<std::endl;
-    if(prediction != resolution) 
+    if (prediction != resolution)
     {
-        //std::cout<<"mis ++ "<<std::endl;
         stat_num_mispred++;
     }
 
-    // TODO: Update any other internal state you may need to keep track of.
-    // Update GHR
-    if (resolution== NOT_TAKEN)
-    {
-        GHR = GHR << 1;
-        GHR = GHR & mask;
-    }
-    else
-    {
-        GHR = (GHR << 1);
-        GHR += 1;
-        GHR = GHR & mask;
-    }
-    
-    // Update PHT
-    old_state = PHT[xor_result];
-    if(resolution)
-    {
-        new_state = sat_increment(old_state,max);
-    }
-    else
-    {
-        new_state = sat_decrement(old_state);
-    }
-
-    PHT[xor_result] = new_state;
-
     // Note that you do not have to handle the BPRED_PERFECT policy here; this
     // function will not be called for that policy.
+    impl->update(pc, resolution);
+}
+
+/**
+ * @return the number of bits of state this branch predictor keeps
+ */
+uint64_t BPred::storage_bits() const
+{
+    return impl ? impl->storage_bits() : 0;
 }
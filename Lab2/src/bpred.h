@@ -24,6 +24,12 @@ typedef enum BPredPolicyEnum
     BPRED_PERFECT,      // The branch predictor is (magically) always correct.
     BPRED_ALWAYS_TAKEN, // The branch predictor always predicts a branch taken.
     BPRED_GSHARE,       // The branch predictor uses the Gshare algorithm.
+    BPRED_BIMODAL,      // The branch predictor uses a PC-indexed counter table.
+    BPRED_TOURNAMENT,   // The branch predictor chooses between Gshare and
+                        // bimodal predictions.
+    BPRED_PERCEPTRON,   // The branch predictor uses perceptrons.
+    BPRED_TAGE,         // The branch predictor uses the TAGE algorithm.
+    BPRED_LTAGE,        // The branch predictor uses TAGE plus a loop predictor.
     NUM_BPRED_POLICIES
 } BPredPolicy;
 
@@ -38,6 +44,8 @@ typedef enum BranchDirectionEnum
     TAKEN = 1      // The branch is taken.
 } BranchDirection;
 
+class DirPredictor;
+
 /**
  * A branch predictor.
  * 
@@ -49,6 +57,8 @@ class BPred
 private:
     /** The policy this branch predictor uses. */
     BPredPolicy policy;
+    /** The direction predictor of the policy (see predictors.h). */
+    DirPredictor *impl;
 
 public:
     /** The total number of branches this branch predictor has seen. */
@@ -65,6 +75,18 @@ public:
      */
     BPred(BPredPolicy policy);
 
+    /**
+     * Construct a branch predictor with the given policy and size.
+     *
+     * @param policy the policy this branch predictor should use
+     * @param size_kb the storage budget in KB, or 0 for the policy's default
+     * @param hist_len the global history length, or 0 for the policy's
+     *                 default (ignored by policies without a configurable one)
+     */
+    BPred(BPredPolicy policy, uint32_t size_kb, uint32_t hist_len);
+
+    ~BPred();
+
     /**
      * Get a prediction for the branch with the given address.
      * 
@@ -88,6 +110,11 @@ public:
      */
     void update(uint64_t pc, BranchDirection prediction,
                 BranchDirection resolution);
+
+    /**
+     * @return the number of bits of state this branch predictor keeps
+     */
+    uint64_t storage_bits() const;
 };
 
 /**
@@ -0,0 +1,481 @@
+// bpred_bench.cpp
+// Evaluates many branch predictor configurations over the same trace in one
+// pass, without simulating the pipeline.
+//
+// Only the conditional branches of the trace are kept. The trace is read in
+// chunks; while the predictors work through one chunk on worker threads, the
+// main thread reads the next. Each configuration is always run by the same
+// worker, so its results do not depend on the number of threads.
+//
+// A configuration is a policy number, optionally followed by a storage budget
+// in KB and a global history length, as in -bpredpolicy, -bpredsize, and
+// -bpredhist. For example, "-config 6,32" is a 32 KB TAGE predictor.
+
+#include "bpred.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of branches per chunk of the trace. */
+#define CHUNK_BRANCHES (1 << 20)
+/** The number of trace records read from the pipe at once. */
+#define READ_RECORDS 4096
+
+static const char *policy_names[NUM_BPRED_POLICIES] = {
+    "Perfect", "AlwaysTaken", "Gshare", "Bimodal", "Tournament",
+    "Perceptron", "TAGE", "L-TAGE"};
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A conditional branch from the trace. */
+typedef struct BranchRec
+{
+    uint64_t pc;
+    BranchDirection dir;
+} BranchRec;
+
+/** A chunk of consecutive branches. */
+typedef struct BranchChunk
+{
+    std::vector<BranchRec> branches;
+} BranchChunk;
+
+/** One predictor configuration, and its results. */
+typedef struct BenchConfig
+{
+    BPredPolicy policy;
+    uint32_t size_kb;
+    uint32_t hist_len;
+
+    BPred *bpred;
+    /** The time spent predicting and updating, in seconds. */
+    double seconds;
+} BenchConfig;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              GLOBAL VARIABLES                             //
+///////////////////////////////////////////////////////////////////////////////
+
+std::vector<BenchConfig> configs;
+
+/** The number of worker threads. */
+unsigned int num_threads;
+
+const char *trace_filename;
+
+/** The number of instructions read from the trace. */
+uint64_t stat_num_inst;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+int parse_args(int argc, char *argv[]);
+int parse_config(const char *arg, BenchConfig *cfg);
+int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
+bool read_chunk(int fd, BranchChunk *chunk);
+void run_worker(unsigned int worker, const BranchChunk *chunk);
+void print_results(double wall_seconds);
+void print_usage(char *program_name);
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    int status = parse_args(argc, argv);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        configs[i].bpred = new BPred(configs[i].policy, configs[i].size_kb,
+                                     configs[i].hist_len);
+        configs[i].seconds = 0;
+    }
+    if (num_threads > configs.size())
+    {
+        num_threads = configs.size();
+    }
+
+    int trace_fd;
+    pid_t pid;
+    status = open_gunzip_pipe(trace_filename, &trace_fd, &pid);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    // Double buffering: the workers run over one chunk while the next one is
+    // read.
+    BranchChunk chunks[2];
+    unsigned int cur = 0;
+    bool more = read_chunk(trace_fd, &chunks[cur]);
+    while (!chunks[cur].branches.empty())
+    {
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < num_threads; w++)
+        {
+            workers.push_back(std::thread(run_worker, w, &chunks[cur]));
+        }
+
+        chunks[1 - cur].branches.clear();
+        if (more)
+        {
+            more = read_chunk(trace_fd, &chunks[1 - cur]);
+        }
+
+        for (size_t w = 0; w < workers.size(); w++)
+        {
+            workers[w].join();
+        }
+        cur = 1 - cur;
+    }
+
+    double wall_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    close(trace_fd);
+    waitpid(pid, &status, 0);
+    status = WEXITSTATUS(status);
+    if (status == 127)
+    {
+        return 1;
+    }
+
+    print_results(wall_seconds);
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        delete configs[i].bpred;
+    }
+    return 0;
+}
+
+int parse_args(int argc, char *argv[])
+{
+    num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+    trace_filename = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+            {
+                print_usage(argv[0]);
+                return 2;
+            }
+            else if (strcmp(argv[i], "-threads") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -threads\n");
+                    return 2;
+                }
+
+                int threads = atoi(argv[i]);
+                if (threads < 1)
+                {
+                    fprintf(stderr, "Error: invalid argument for -threads\n");
+                    return 2;
+                }
+
+                num_threads = threads;
+            }
+            else if (strcmp(argv[i], "-config") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -config\n");
+                    return 2;
+                }
+
+                BenchConfig cfg;
+                if (parse_config(argv[i], &cfg) != 0)
+                {
+                    fprintf(stderr, "Error: invalid argument for -config: %s\n",
+                            argv[i]);
+                    return 2;
+                }
+
+                configs.push_back(cfg);
+            }
+            else
+            {
+                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else
+        {
+            // Parse trace file name.
+            if (trace_filename != NULL)
+            {
+                fprintf(stderr, "Error: only one trace file may be specified\n");
+                return 2;
+            }
+
+            trace_filename = argv[i];
+        }
+    }
+
+    if (trace_filename == NULL)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // By default, compare every policy at its default size.
+    if (configs.empty())
+    {
+        for (int p = BPRED_ALWAYS_TAKEN; p < NUM_BPRED_POLICIES; p++)
+        {
+            BenchConfig cfg = {(BPredPolicy)p, 0, 0, NULL, 0};
+            configs.push_back(cfg);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Parse a configuration of the form <policy>[,<KB>[,<hist>]].
+ *
+ * @param arg the configuration
+ * @param cfg the configuration to fill in
+ * @return 0 on success, or 1 if the configuration is invalid
+ */
+int parse_config(const char *arg, BenchConfig *cfg)
+{
+    int policy = 0;
+    int size_kb = 0;
+    int hist_len = 0;
+    int n = sscanf(arg, "%d,%d,%d", &policy, &size_kb, &hist_len);
+    if (n < 1 || policy <= BPRED_PERFECT || policy >= NUM_BPRED_POLICIES ||
+        (n >= 2 && (size_kb < 1 || size_kb > 1024)) ||
+        (n >= 3 && (hist_len < 1 || hist_len > 63)))
+    {
+        return 1;
+    }
+
+    cfg->policy = (BPredPolicy)policy;
+    cfg->size_kb = size_kb;
+    cfg->hist_len = hist_len;
+    cfg->bpred = NULL;
+    cfg->seconds = 0;
+    return 0;
+}
+
+/**
+ * Open a gzipped trace file through a gunzip child process, as sim does.
+ *
+ * @param filename the trace file
+ * @param fd set to the read end of the pipe from gunzip
+ * @param pid set to the process ID of gunzip
+ * @return 0 on success, or nonzero on failure
+ */
+int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
+{
+    int status;
+    int pipefd[2];
+
+    status = pipe(pipefd);
+    if (status != 0)
+    {
+        perror("Couldn't create pipe");
+        return 1;
+    }
+
+    *pid = fork();
+    if (*pid == -1)
+    {
+        perror("Couldn't fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return 1;
+    }
+
+    if (*pid == 0)
+    {
+        // Child process: exec gunzip.
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        execlp("gunzip", "gunzip", "-c", filename, NULL);
+        perror("Couldn't exec gunzip");
+        fprintf(stderr, "Is gunzip installed?\n");
+        exit(127);
+    }
+
+    // Parent process: return the read end of the pipe.
+    *fd = pipefd[0];
+    close(pipefd[1]);
+    return 0;
+}
+
+/**
+ * Read the conditional branches of the trace into a chunk until it is full or
+ * the trace ends.
+ *
+ * @param fd the trace file descriptor
+ * @param chunk the chunk, which must be empty
+ * @return whether there may be more of the trace to read
+ */
+bool read_chunk(int fd, BranchChunk *chunk)
+{
+    static TraceRec recs[READ_RECORDS];
+    static size_t rec_bytes = 0;
+    static size_t rec_pos = 0;
+
+    chunk->branches.reserve(CHUNK_BRANCHES);
+    while (chunk->branches.size() < CHUNK_BRANCHES)
+    {
+        size_t whole = rec_bytes / sizeof(TraceRec);
+        if (rec_pos == whole)
+        {
+            // Move any partial record to the front and refill the buffer.
+            size_t left = rec_bytes - whole * sizeof(TraceRec);
+            memmove(recs, (uint8_t *)recs + whole * sizeof(TraceRec), left);
+            rec_bytes = left;
+            rec_pos = 0;
+
+            ssize_t n = read(fd, (uint8_t *)recs + rec_bytes,
+                             sizeof(recs) - rec_bytes);
+            if (n <= 0)
+            {
+                if (rec_bytes != 0)
+                {
+                    fprintf(stderr, "Error: Invalid trace file\n");
+                }
+                return false;
+            }
+            rec_bytes += n;
+            continue;
+        }
+
+        for (; rec_pos < whole &&
+               chunk->branches.size() < CHUNK_BRANCHES; rec_pos++)
+        {
+            const TraceRec *rec = &recs[rec_pos];
+            stat_num_inst++;
+            if (rec->op_type == OP_CBR)
+            {
+                BranchRec br = {rec->inst_addr,
+                                rec->br_dir ? TAKEN : NOT_TAKEN};
+                chunk->branches.push_back(br);
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Run the configurations of a worker over a chunk of branches.
+ *
+ * @param worker the worker; it runs every num_threads-th configuration
+ * @param chunk the branches
+ */
+void run_worker(unsigned int worker, const BranchChunk *chunk)
+{
+    for (size_t i = worker; i < configs.size(); i += num_threads)
+    {
+        BenchConfig *cfg = &configs[i];
+        BPred *bpred = cfg->bpred;
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        const BranchRec *br = chunk->branches.data();
+        size_t n = chunk->branches.size();
+        for (size_t j = 0; j < n; j++)
+        {
+            BranchDirection prediction = bpred->predict(br[j].pc);
+            bpred->update(br[j].pc, prediction, br[j].dir);
+        }
+
+        cfg->seconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void print_results(double wall_seconds)
+{
+    uint64_t total_branches = 0;
+
+    printf("BENCH_NUM_INST          \t : %10lu\n", (unsigned long)stat_num_inst);
+    printf("BENCH_NUM_BRANCHES      \t : %10lu\n",
+           configs.empty() ? 0 : (unsigned long)configs[0].bpred->stat_num_branches);
+    printf("BENCH_THREADS           \t : %10u\n", num_threads);
+    printf("\n");
+    printf("%-12s %7s %5s %10s %10s %8s %9s %10s\n", "POLICY", "SIZE_KB",
+           "HIST", "STORAGE_KB", "MISPRED", "MPKI", "ACCURACY", "MBRANCH/S");
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const BenchConfig *cfg = &configs[i];
+        const BPred *bpred = cfg->bpred;
+        uint64_t branches = bpred->stat_num_branches;
+        total_branches += branches;
+
+        double mpki = stat_num_inst
+            ? 1000.0 * (double)bpred->stat_num_mispred / (double)stat_num_inst
+            : 0;
+        double accuracy = branches
+            ? 100.0 * (double)(branches - bpred->stat_num_mispred) / (double)branches
+            : 0;
+        double rate = cfg->seconds > 0 ? (double)branches / cfg->seconds / 1e6 : 0;
+
+        char size[16];
+        char hist[16];
+        snprintf(size, sizeof(size), cfg->size_kb ? "%u" : "def", cfg->size_kb);
+        snprintf(hist, sizeof(hist), cfg->hist_len ? "%u" : "def", cfg->hist_len);
+
+        printf("%-12s %7s %5s %10.2f %10lu %8.3f %9.3f %10.2f\n",
+               policy_names[cfg->policy], size, hist,
+               (double)bpred->storage_bits() / 8192.0,
+               (unsigned long)bpred->stat_num_mispred, mpki, accuracy, rate);
+    }
+
+    printf("\n");
+    printf("BENCH_WALL_SECONDS      \t : %10.3f\n", wall_seconds);
+    printf("BENCH_MBRANCH_PER_SEC   \t : %10.2f\n",
+           wall_seconds > 0 ? (double)total_branches / wall_seconds / 1e6 : 0);
+}
+
+void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <trace file>\n\n", program_name);
+    fprintf(stderr, "Branch predictor evaluation over the conditional branches of a trace\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -config <p>[,<KB>[,<hist>]]  Add a predictor with policy <p> (as in\n");
+    fprintf(stderr, "                                 -bpredpolicy), storage budget <KB>, and\n");
+    fprintf(stderr, "                                 global history length <hist> (Default:\n");
+    fprintf(stderr, "                                 every policy at its default size)\n");
+    fprintf(stderr, "    -threads <num>               Set number of worker threads (Default:\n");
+    fprintf(stderr, "                                 number of CPUs)\n");
+}
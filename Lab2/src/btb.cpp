@@ -0,0 +1,160 @@
+// btb.cpp
+// Implements the branch target buffer class.
+
+#include "btb.h"
+#include <stddef.h>
+
+/**
+ * Construct a branch target buffer.
+ *
+ * @param num_entries the number of entries; a power of 2
+ * @param assoc the number of ways; a power of 2, at most num_entries
+ * @param repl the replacement policy
+ * @param tc_entries the number of target cache entries; 0 or a power of 2
+ */
+BTB::BTB(uint32_t num_entries, uint32_t assoc, BTBReplPolicy repl,
+         uint32_t tc_entries)
+{
+    BTBEntry empty = {false, 0, 0, false, 0};
+    entries.assign(num_entries, empty);
+    this->assoc = assoc;
+    num_sets = num_entries / assoc;
+    this->repl = repl;
+    clock = 0;
+    rng = 0x9E3779B9;
+
+    target_cache.assign(tc_entries, 0);
+    path_hist = 0;
+
+    last_entry = NULL;
+    stat_num_lookups = 0;
+    stat_num_hits = 0;
+}
+
+/**
+ * @return the target cache index of the branch at the given address under
+ *         the current path history
+ */
+size_t BTB::tc_index(uint64_t pc) const
+{
+    uint64_t h = pc ^ path_hist ^ (path_hist >> 16);
+    return (size_t)(h & (target_cache.size() - 1));
+}
+
+/**
+ * @return the entry of the given set to replace
+ */
+BTB::BTBEntry *BTB::victim(size_t set)
+{
+    BTBEntry *ways = &entries[set * assoc];
+    for (unsigned int w = 0; w < assoc; w++)
+    {
+        if (!ways[w].valid)
+        {
+            return &ways[w];
+        }
+    }
+
+    if (repl == BTB_REPL_RANDOM)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return &ways[rng % assoc];
+    }
+
+    // LRU and FIFO both evict the smallest stamp; they differ in whether a
+    // hit refreshes it.
+    BTBEntry *oldest = &ways[0];
+    for (unsigned int w = 1; w < assoc; w++)
+    {
+        if (ways[w].stamp < oldest->stamp)
+        {
+            oldest = &ways[w];
+        }
+    }
+    return oldest;
+}
+
+/**
+ * Look up the target of the branch with the given address.
+ *
+ * @param pc the address (program counter) of the branch
+ * @param target set to the predicted target on a hit
+ * @return whether the branch target buffer hit
+ */
+bool BTB::predict(uint64_t pc, uint64_t *target)
+{
+    size_t set = pc & (num_sets - 1);
+    uint64_t tag = pc / num_sets;
+    clock++;
+    stat_num_lookups++;
+
+    last_entry = NULL;
+    BTBEntry *ways = &entries[set * assoc];
+    for (unsigned int w = 0; w < assoc; w++)
+    {
+        if (ways[w].valid && ways[w].tag == tag)
+        {
+            last_entry = &ways[w];
+            break;
+        }
+    }
+    if (!last_entry)
+    {
+        return false;
+    }
+
+    stat_num_hits++;
+    if (repl == BTB_REPL_LRU)
+    {
+        last_entry->stamp = clock;
+    }
+
+    *target = last_entry->target;
+    if (last_entry->indirect && !target_cache.empty())
+    {
+        uint64_t tc_target = target_cache[tc_index(pc)];
+        if (tc_target != 0)
+        {
+            *target = tc_target;
+        }
+    }
+    return true;
+}
+
+/**
+ * Update the branch target buffer with the target of the branch just looked
+ * up, which was taken.
+ *
+ * @param pc the address (program counter) of the branch
+ * @param target the actual target of the branch
+ */
+void BTB::update(uint64_t pc, uint64_t target)
+{
+    if (last_entry)
+    {
+        if (last_entry->target != target)
+        {
+            last_entry->indirect = true;
+            last_entry->target = target;
+        }
+        if (last_entry->indirect && !target_cache.empty())
+        {
+            target_cache[tc_index(pc)] = target;
+        }
+    }
+    else
+    {
+        // Allocate an entry for the branch.
+        size_t set = pc & (num_sets - 1);
+        BTBEntry *e = victim(set);
+        e->valid = true;
+        e->tag = pc / num_sets;
+        e->target = target;
+        e->indirect = false;
+        e->stamp = clock;
+    }
+
+    path_hist = (path_hist << 4) ^ target;
+}
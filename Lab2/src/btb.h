@@ -0,0 +1,109 @@
+// btb.h
+// Declares the branch target buffer class, which predicts the targets of
+// taken branches, along with an optional target cache for branches with more
+// than one target.
+
+#ifndef _BTB_H_
+#define _BTB_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * The possible replacement policies of the branch target buffer.
+ */
+typedef enum BTBReplPolicyEnum
+{
+    BTB_REPL_LRU,    // Evict the least recently used entry of the set.
+    BTB_REPL_FIFO,   // Evict the oldest entry of the set.
+    BTB_REPL_RANDOM, // Evict a random entry of the set.
+    NUM_BTB_REPL_POLICIES
+} BTBReplPolicy;
+
+/**
+ * A set-associative branch target buffer.
+ *
+ * Branches are allocated an entry when they are first taken. A branch seen
+ * going to more than one target is marked indirect; if there is a target
+ * cache, the targets of indirect branches are predicted from it instead,
+ * indexed by the branch address and the targets of the last taken branches.
+ *
+ * The traces only record conditional branches, and each of them has a single
+ * target, so no branch is ever marked indirect and the target cache goes
+ * unexercised by them. It is there for traces with indirect branches.
+ *
+ * The pipeline always calls update() right after predict() for the same
+ * taken branch.
+ */
+class BTB
+{
+private:
+    /** An entry of the branch target buffer. */
+    struct BTBEntry
+    {
+        bool valid;
+        uint64_t tag;
+        uint64_t target;
+        /** Whether the branch has been seen going to more than one target. */
+        bool indirect;
+        /** When the entry was last used (LRU) or filled (FIFO). */
+        uint64_t stamp;
+    };
+
+    std::vector<BTBEntry> entries;
+    unsigned int num_sets;
+    unsigned int assoc;
+    BTBReplPolicy repl;
+    /** The number of lookups so far, used to order the entries of a set. */
+    uint64_t clock;
+    uint32_t rng;
+
+    /** The target cache for indirect branches (empty if there is none). */
+    std::vector<uint64_t> target_cache;
+    /** A hash of the targets of the last taken branches. */
+    uint64_t path_hist;
+
+    /** The entry the last prediction hit, or NULL if it missed. */
+    BTBEntry *last_entry;
+
+    size_t tc_index(uint64_t pc) const;
+    BTBEntry *victim(size_t set);
+
+public:
+    /** The number of branches looked up, taken or not. */
+    uint64_t stat_num_lookups;
+    /** The number of lookups that hit in the branch target buffer. */
+    uint64_t stat_num_hits;
+
+    /**
+     * Construct a branch target buffer.
+     *
+     * @param num_entries the number of entries; a power of 2
+     * @param assoc the number of ways; a power of 2, at most num_entries
+     * @param repl the replacement policy
+     * @param tc_entries the number of target cache entries; 0 or a power of 2
+     */
+    BTB(uint32_t num_entries, uint32_t assoc, BTBReplPolicy repl,
+        uint32_t tc_entries);
+
+    /**
+     * Look up the target of the branch with the given address.
+     *
+     * @param pc the address (program counter) of the branch
+     * @param target set to the predicted target on a hit
+     * @return whether the branch target buffer hit
+     */
+    bool predict(uint64_t pc, uint64_t *target);
+
+    /**
+     * Update the branch target buffer with the target of the branch just
+     * looked up, which was taken.
+     *
+     * @param pc the address (program counter) of the branch
+     * @param target the actual target of the branch
+     */
+    void update(uint64_t pc, uint64_t target);
+};
+
+#endif
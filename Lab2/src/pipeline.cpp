@@ -9,6 +9,8 @@
 // Implements functions to simulate a pipelined processor.
 
 #include "pipeline.h"
+#include "memsys.h"
+#include "config.h"
 #include <cstdlib>
 #include <stdio.h>
 #include <unistd.h>
@@ -26,7 +28,12 @@
  */
 void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
 {
-    TraceRec *trace_rec = &fetch_op->trace_rec;
+    // Take an entry from the instruction pool; it is put back if there is no
+    // instruction to read.
+    fetch_op->inst = p->inst_free[--p->inst_free_count];
+    PipelineInst *inst = pipe_inst(p, fetch_op);
+
+    TraceRec *trace_rec = &inst->trace_rec;
     uint8_t *trace_rec_buf = (uint8_t *)trace_rec;
     size_t bytes_read_total = 0;
     ssize_t bytes_read_last = 0;
@@ -47,10 +54,18 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
         bytes_left -= bytes_read_last;
     }
 
+    // The scoreboard only tracks the architectural registers, so a record
+    // naming any other register can't be simulated.
+    bool regs_valid =
+        (!trace_rec->src1_needed || trace_rec->src1_reg < NUM_ARCH_REGS) &&
+        (!trace_rec->src2_needed || trace_rec->src2_reg < NUM_ARCH_REGS) &&
+        (!trace_rec->dest_needed || trace_rec->dest_reg < NUM_ARCH_REGS);
+
     // Check for error conditions.
-    if (bytes_left > 0 || trace_rec->op_type >= NUM_OP_TYPES)
+    if (bytes_left > 0 || trace_rec->op_type >= NUM_OP_TYPES || !regs_valid)
     {
         fetch_op->valid = false;
+        p->inst_free[p->inst_free_count++] = fetch_op->inst;
         p->halt_op_id = p->last_op_id;
 
         if (p->last_op_id == 0)
@@ -71,8 +86,14 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
             return;
         }
 
-        // Too few bytes read or invalid op_type
+        // Too few bytes read, invalid op_type, or invalid register
         fprintf(stderr, "\n");
+        if (bytes_left == 0 && trace_rec->op_type < NUM_OP_TYPES)
+        {
+            fprintf(stderr, "Error: Invalid trace file: register number "
+                            "above %d\n", NUM_ARCH_REGS - 1);
+            return;
+        }
         fprintf(stderr, "Error: Invalid trace file\n");
         return;
     }
@@ -80,8 +101,8 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
     // Got a valid trace record!
     fetch_op->valid = true;
     fetch_op->stall = false;
-    fetch_op->is_mispred_cbr = false;
-    fetch_op->op_id = ++p->last_op_id;
+    inst->is_mispred_cbr = false;
+    inst->op_id = ++p->last_op_id;
 }
 
 /**
@@ -103,10 +124,40 @@ Pipeline *pipe_init(int trace_fd)
     p->trace_fd = trace_fd;
     p->halt_op_id = (uint64_t)(-1) - 3;
 
+    // Allocate the instruction pool, with room for an instruction in every
+    // latch and fetch queue entry, and one read ahead by fetch.
+    uint32_t pool_size = NUM_LATCH_TYPES * MAX_PIPE_WIDTH + FETCH_QUEUE_SIZE + 1;
+    p->inst_pool = (PipelineInst *)calloc(pool_size, sizeof(PipelineInst));
+    p->inst_free = (InstIndex *)calloc(pool_size, sizeof(InstIndex));
+    for (uint32_t i = 0; i < pool_size; i++)
+    {
+        // Hand out the lowest indices first.
+        p->inst_free[i] = pool_size - 1 - i;
+    }
+    p->inst_free_count = pool_size;
+
     // Allocate and initialize a branch predictor if needed.
     if (BPRED_POLICY != BPRED_PERFECT)
     {
-        p->b_pred = new BPred(BPRED_POLICY);
+        p->b_pred = new BPred(BPRED_POLICY, BPRED_SIZE_KB, BPRED_HIST_LEN);
+    }
+
+    // Allocate a branch target buffer if targets are not predicted perfectly.
+    if (BTB_SIZE > 0)
+    {
+        p->btb = new BTB(BTB_SIZE, BTB_ASSOC, BTB_REPL, INDIRECT_SIZE);
+    }
+
+    // Allocate a fetch queue for a decoupled front end.
+    if (FETCH_QUEUE_SIZE > 0)
+    {
+        p->fetch_queue = (PipelineLatch *)calloc(FETCH_QUEUE_SIZE,
+                                                 sizeof(PipelineLatch));
+    }
+
+    if (ENABLE_MEMSYS)
+    {
+        p->memsys = memsys_new();
     }
 
     return p;
@@ -159,7 +210,7 @@ void pipe_print_state(Pipeline *p)
             if (p->pipe_latch[latch_type][i].valid)
             {
                 printf(" %6lu ",
-                       (unsigned long)p->pipe_latch[latch_type][i].op_id);
+                       (unsigned long)pipe_inst(p, &p->pipe_latch[latch_type][i])->op_id);
             }
             else
             {
@@ -175,28 +226,29 @@ void pipe_print_state(Pipeline *p)
         {
             if (p->pipe_latch[latch_type][i].valid)
             {
-                int dest = (p->pipe_latch[latch_type][i].trace_rec.dest_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.dest_reg : -1;
-                int src1 = (p->pipe_latch[latch_type][i].trace_rec.src1_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.src1_reg : -1;
-                int src2 = (p->pipe_latch[latch_type][i].trace_rec.src2_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.src2_reg : -1;
-                int cc_read = p->pipe_latch[latch_type][i].trace_rec.cc_read;
-                int cc_write = p->pipe_latch[latch_type][i].trace_rec.cc_write;
+                const PipelineInst *inst = pipe_inst(p, &p->pipe_latch[latch_type][i]);
+                int dest = (inst->trace_rec.dest_needed) ? 
+                        inst->trace_rec.dest_reg : -1;
+                int src1 = (inst->trace_rec.src1_needed) ? 
+                        inst->trace_rec.src1_reg : -1;
+                int src2 = (inst->trace_rec.src2_needed) ? 
+                        inst->trace_rec.src2_reg : -1;
+                int cc_read = inst->trace_rec.cc_read;
+                int cc_write = inst->trace_rec.cc_write;
                 const char *op_type;
-                if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_ALU)
+                if (inst->trace_rec.op_type == OP_ALU)
                     op_type = "ALU";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_LD)
+                else if (inst->trace_rec.op_type == OP_LD)
                     op_type = "LD";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_ST)
+                else if (inst->trace_rec.op_type == OP_ST)
                     op_type = "ST";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_CBR)
+                else if (inst->trace_rec.op_type == OP_CBR)
                     op_type = "BR";
                 else
                     op_type = "OTHER";
 
                 printf("(%lu : %s) dest: %d, src1: %d, src2: %d , ccread: %d, ccwrite: %d\n",
-                       (unsigned long)p->pipe_latch[latch_type][i].op_id,
+                       (unsigned long)inst->op_id,
                        op_type,
                        dest,
                        src1,
@@ -265,27 +317,76 @@ void pipe_cycle_WB(Pipeline *p)
 {
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
-        if (!p->pipe_latch[MA_LATCH][i].valid) continue;
+        if (!p->pipe_latch[MA_LATCH][i].valid)
+        {
+            p->stat_bubbles[p->pipe_latch[MA_LATCH][i].bubble_cause]++;
+            continue;
+        }
 
+        PipelineInst *inst = pipe_inst(p, &p->pipe_latch[MA_LATCH][i]);
         p->stat_retired_inst++;
 
-        if (p->pipe_latch[MA_LATCH][i].op_id >= p->halt_op_id)
+        if (inst->op_id >= p->halt_op_id)
         {
             // Halt the pipeline if we've reached the end of the trace.
             p->halt = true;
         }
 
         //check is_mispred_cbr signal
-        if (p->pipe_latch[MA_LATCH][i].is_mispred_cbr == true)
+        if (inst->is_mispred_cbr == true)
         {
             // conceal stall
             p->fetch_cbr_stall = false;
         }
-        
+
+        // The instruction leaves the pipeline; MA overwrites its latch later
+        // this cycle.
+        p->inst_free[p->inst_free_count++] = p->pipe_latch[MA_LATCH][i].inst;
 
     }
 }
 
+/**
+ * Access the memory system for the loads and stores in the EX latch.
+ * 
+ * @param p the pipeline
+ * @return the longest delay of the loads, or 0 if there are none
+ */
+static uint64_t pipe_mem_access(Pipeline *p)
+{
+    uint64_t delay = 0;
+    current_cycle = p->stat_num_cycle;
+    for (unsigned int i = 0; i < PIPE_WIDTH; i++)
+    {
+        if (!p->pipe_latch[EX_LATCH][i].valid) continue;
+
+        const TraceRec *rec = &pipe_inst(p, &p->pipe_latch[EX_LATCH][i])->trace_rec;
+        p->memsys->access_pc = rec->inst_addr;
+        if (rec->op_type == OP_LD)
+        {
+            uint64_t ld_delay = memsys_access(p->memsys, rec->mem_addr,
+                                              ACCESS_TYPE_LOAD, 0);
+            if (ld_delay > delay) delay = ld_delay;
+        }
+        else if (rec->op_type == OP_ST)
+        {
+            memsys_access(p->memsys, rec->mem_addr, ACCESS_TYPE_STORE, 0);
+        }
+    }
+    return delay;
+}
+
+/**
+ * Return whether MA is busy with loads, freezing the stages before it.
+ * 
+ * @param p the pipeline
+ * @return whether the stages before MA are frozen this cycle
+ */
+static inline bool pipe_ma_busy(const Pipeline *p)
+{
+    return p->stat_num_cycle < p->ma_busy_until;
+}
+
 /**
  * Simulate one cycle of the Memory Access stage (MA) of a pipeline.
  * 
@@ -296,11 +397,46 @@ void pipe_cycle_WB(Pipeline *p)
  */
 void pipe_cycle_MA(Pipeline *p)
 {
+    /*
+    With the memory system, the instructions in the EX latch access it as
+    they enter MA. The loads among them hold MA for as long as the slowest
+    takes beyond the one cycle of a dcache hit; stores go through without
+    waiting, as in Lab4's cores. Meanwhile they stay in the EX latch, MA
+    sends bubbles on to WB, and the earlier stages are frozen.
+    */
+    if (p->memsys)
+    {
+        if (!p->ma_access_done)
+        {
+            uint64_t delay = pipe_mem_access(p);
+            if (delay > 1)
+            {
+                p->ma_busy_until = p->stat_num_cycle + delay - 1;
+                p->ma_access_done = true;
+            }
+        }
+
+        if (p->stat_num_cycle < p->ma_busy_until)
+        {
+            for (unsigned int i = 0; i < PIPE_WIDTH; i++)
+            {
+                p->pipe_latch[MA_LATCH][i].valid = false;
+                p->pipe_latch[MA_LATCH][i].bubble_cause = BUBBLE_MEMORY;
+            }
+            p->sb.ma_writes = 0;
+            return;
+        }
+        p->ma_access_done = false;
+    }
+
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         // Copy each instruction from the EX latch to the MA latch.
         p->pipe_latch[MA_LATCH][i] = p->pipe_latch[EX_LATCH][i];
     }
+
+    // The pending writes move along with the instructions.
+    p->sb.ma_writes = p->sb.ex_writes;
 }
 
 /**
@@ -313,6 +449,8 @@ void pipe_cycle_MA(Pipeline *p)
  */
 void pipe_cycle_EX(Pipeline *p)
 {
+    if (pipe_ma_busy(p)) return;
+
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         // Copy each instruction from the ID latch to the EX latch.
@@ -335,6 +473,114 @@ void pipe_cycle_EX(Pipeline *p)
             p->pipe_latch[EX_LATCH][i].valid = 0;
         }
     }
+
+    // The pending writes of the instructions ID let through last cycle.
+    p->sb.ex_writes = p->sb.id_writes;
+    p->sb.ex_load_writes = p->sb.id_load_writes;
+}
+
+/**
+ * Return the registers an instruction reads, as a scoreboard mask.
+ * 
+ * @param rec the trace record of the instruction
+ * @return the registers it reads, including the condition codes
+ */
+static inline RegMask reg_reads(const TraceRec *rec)
+{
+    RegMask mask = 0;
+    if (rec->src1_needed) mask |= (RegMask)1 << rec->src1_reg;
+    if (rec->src2_needed) mask |= (RegMask)1 << rec->src2_reg;
+    if (rec->cc_read) mask |= REGMASK_CC;
+    return mask;
+}
+
+/**
+ * Return the registers an instruction writes, as a scoreboard mask.
+ * 
+ * @param rec the trace record of the instruction
+ * @return the registers it writes, including the condition codes
+ */
+static inline RegMask reg_writes(const TraceRec *rec)
+{
+    RegMask mask = 0;
+    if (rec->dest_needed) mask |= (RegMask)1 << rec->dest_reg;
+    if (rec->cc_write) mask |= REGMASK_CC;
+    return mask;
+}
+
+/**
+ * Return the class of functional unit an instruction executes on.
+ * 
+ * @param rec the trace record of the instruction
+ * @return its functional unit class
+ */
+static inline FUClass fu_class(const TraceRec *rec)
+{
+    switch (rec->op_type) {
+    case OP_LD:
+        return FU_LOAD;
+    case OP_ST:
+        return FU_STORE;
+    case OP_CBR:
+        return FU_BRANCH;
+    default:
+        return FU_ALU;
+    }
+}
+
+/**
+ * Claim a free functional unit of a class for an instruction leaving ID this
+ * cycle.
+ * 
+ * @param p the pipeline
+ * @param fc the functional unit class
+ * @return whether a unit was free
+ */
+static bool fu_claim(Pipeline *p, FUClass fc)
+{
+    const FUConfig *cfg = &FU_CONFIG[fc];
+    uint32_t count = cfg->count ? cfg->count : PIPE_WIDTH;
+    for (uint32_t u = 0; u < count; u++) {
+        if (p->fu_busy_until[fc][u] <= p->stat_num_cycle) {
+            p->fu_busy_until[fc][u] = p->stat_num_cycle +
+                                      (cfg->pipelined ? 1 : cfg->latency);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Return the registers an instruction reads whose results from multi-cycle
+ * units are not ready for it to leave ID this cycle.
+ * 
+ * @param p the pipeline
+ * @param reads the registers the instruction reads
+ * @return the registers not ready yet
+ */
+static inline RegMask regs_pending(const Pipeline *p, RegMask reads)
+{
+    RegMask pending = 0;
+    for (; reads; reads &= reads - 1) {
+        int r = __builtin_ctzll(reads);
+        if (p->reg_ready[r] > p->stat_num_cycle) pending |= (RegMask)1 << r;
+    }
+    return pending;
+}
+
+/**
+ * Return the bubble cause of a RAW hazard.
+ * 
+ * @param hazards the registers causing the hazard
+ * @param removable whether a disabled forwarding path would remove it
+ * @return the cause
+ */
+static inline BubbleCause raw_cause(RegMask hazards, bool removable)
+{
+    if (hazards & ~REGMASK_CC) {
+        return removable ? BUBBLE_RAW_REG_FWDOFF : BUBBLE_RAW_REG_NOPATH;
+    }
+    return removable ? BUBBLE_RAW_CC_FWDOFF : BUBBLE_RAW_CC_NOPATH;
 }
 
 /**
@@ -364,223 +610,199 @@ void pipe_cycle_ID(Pipeline *p)
     This is incorrect since we havn't stalled yet, so 7 & 8 should always
     be together.
     */  
+    if (pipe_ma_busy(p)) return;
+
+    unsigned int order[MAX_PIPE_WIDTH];
+    unsigned int num_ops = 0;
     for (unsigned int i = 0; i < PIPE_WIDTH; i++) {
         // Copy each instruction from the IF latch to the ID latch.
         p->pipe_latch[ID_LATCH][i] = p->pipe_latch[IF_LATCH][i];
-        
-        // Check whether there is a bubble in IF 
-        if(p->fetch_cbr_stall == true)
-        {
-            continue;
+        p->pipe_latch[ID_LATCH][i].stall = false;
+
+        if (!p->pipe_latch[ID_LATCH][i].valid) continue;
+
+        // Keep the valid lanes sorted by program order (insertion sort; the
+        // lanes are nearly always in order already).
+        unsigned int k = num_ops++;
+        uint64_t op_id = pipe_inst(p, &p->pipe_latch[ID_LATCH][i])->op_id;
+        while (k > 0 && pipe_inst(p, &p->pipe_latch[ID_LATCH][order[k - 1]])->op_id >
+                            op_id) {
+            order[k] = order[k - 1];
+            k--;
         }
+        order[k] = i;
     }
 
     /*
-    ============================{ A1 }============================
-    Iterate through each of our pipelines and check for RAW hazards
-    */  
-    for (unsigned int i = 0; i < PIPE_WIDTH; i++) {
-        /*
-        ============================{ A3 }============================
-        Create index trackers for oldest dependency of each type.
-
-        Initialize to PIPE_WIDTH since no index should ever equal our 
-        superscalar width. If we never change from PIPE_WIDTH, there were no 
-        dependencies of that type on pipeline i's ID_LATCH in the EX phase.
-        */  
-        unsigned int oldest_src1_j = PIPE_WIDTH;
-        unsigned int oldest_src2_j = PIPE_WIDTH;
-        unsigned int oldest_cc_j = PIPE_WIDTH;
-
-        /*
-        ============================{ A2 }============================
-        Inner-for loop to iterate through each of our pipelines again.
-        Allows you to check for, as an example, RAW hazards between the ID
-        stage of pipeline 0 and the EX stage of pipeline 1.
-        */ 
-        for (unsigned int j = 0; j < PIPE_WIDTH; j++) {
-            if (ENABLE_MEM_FWD) {
-                /*
-                ============================{ A3 }============================
-                You can always forward from the ME stage, so if forwarding is
-                enabled then no need to check the MA_LATCH
-                */  
-            } else {
-                /*
-                ============================{ A1 }============================
-                Check for RAW hazards in the MA latch. Generalize to a function
-                call for nicer-looking code.
-                */ 
-                if (has_raw_hazards(p, i, j, MA_LATCH)) {
-                    p->pipe_latch[ID_LATCH][i].stall = 1;
-                }
-            }
-
-            if (ENABLE_EXE_FWD) {
-                /*
-                ============================{ A3 }============================
-                We only have a load-use hazard if the oldest (later in program trace) 
-                instruction for any of the hazard-causing dependencies (src1, src2, cc)
-                is caused by an LD instruction. Therefore, iterate through all the EX 
-                stages and track the oldest hazard-causing pipeline index for src1, src2, 
-                and cc. If any of these are an LD instruction, then we have a load-use hazard.
-                */
-                int output = has_raw_hazards(p, i, j, EX_LATCH);
-
-                // Check the bits of the output for each type of dependency
-                // See the has_raw_hazards docstring for details
-                int cc_dependency = output >> 2 & 1;
-                int src2_dependency = output >> 1 & 1;
-                int src1_dependency = output & 1;
-
-                // Checking if we can update src1 dependency
-                if (src1_dependency && 
-                    (oldest_src1_j == PIPE_WIDTH || p->pipe_latch[EX_LATCH][j].op_id > p->pipe_latch[EX_LATCH][oldest_src1_j].op_id)) 
-                {
-                    oldest_src1_j = j;
-                }
-
-                // Checking we can update src2 dependency
-                if (src2_dependency && 
-                    (oldest_src2_j == PIPE_WIDTH || p->pipe_latch[EX_LATCH][j].op_id > p->pipe_latch[EX_LATCH][oldest_src2_j].op_id)) 
-                {
-                    oldest_src2_j = j;
-                }
-
-                // Checking if we can update cc dependency
-                if (cc_dependency &&
-                    (oldest_cc_j == PIPE_WIDTH || p->pipe_latch[EX_LATCH][j].op_id > p->pipe_latch[EX_LATCH][oldest_cc_j].op_id)) 
-                {
-                    oldest_cc_j = j;
-                }
-            } else {
-                /*
-                ============================{ A1 }============================
-                Check for RAW hazards in the EX latch. Generalize to a function
-                call for nicer-looking code.
-                */ 
-                if (has_raw_hazards(p, i, j, EX_LATCH)) {
-                    p->pipe_latch[ID_LATCH][i].stall = 1;
-                }
-            }
-            /*
-            ============================{ A2 }============================
-            Check for RAW hazards in the ID latch on instructions which 
-            come earlier in the program trace. For example...
-            IF:   ID:   EX:   MA:
-            7     5     3     1
-            8     6     4     2 
-
-            6 can depend on 1, 2, 3, or 4, but can also depend on 5.
-            5 can depend on 1, 2, 3, or 4, but not 6 because it comes later.
-
-            Therefore, we need to check for RAW hazards in the ID stage ONLY
-            if the instruction comes earlier in the program trace.
-            */ 
-            if (p->pipe_latch[ID_LATCH][i].op_id > p->pipe_latch[ID_LATCH][j].op_id && 
-                has_raw_hazards(p, i, j, ID_LATCH)) 
-            {
-                p->pipe_latch[ID_LATCH][i].stall = 1;
+    The scoreboard says which registers are still to be written by the
+    instructions in EX and MA. Without forwarding from a stage, reading any
+    of them is a RAW hazard. With forwarding from EX, only reading a register
+    whose youngest writer in EX is a load is (the load-use hazard); MA can
+    always forward.
+
+    Within ID, an instruction also depends on the older ones beside it, so
+    the lanes are checked in program order, collecting what the older ones
+    write. To keep the pipeline in order, once one instruction stalls all
+    younger ones stall too.
+
+    An instruction also needs a free functional unit of its class and, for
+    loads and stores, a memory port. A unit with a latency of more than one
+    cycle delays the instructions reading its result; the reg_ready table
+    keeps the cycle from which each register can be read, and for one-cycle
+    units agrees with the scoreboard.
+    */
+    RegMask stall_mask = 0;
+    if (!ENABLE_MEM_FWD) stall_mask |= p->sb.ma_writes;
+    stall_mask |= ENABLE_EXE_FWD ? p->sb.ex_load_writes : p->sb.ex_writes;
+
+    RegMask older_writes = 0;
+    RegMask pass_writes = 0;
+    RegMask pass_load_writes = 0;
+    unsigned int mem_ops = 0;
+    bool stalled = false;
+    BubbleCause stall_cause = BUBBLE_FILL_DRAIN;
+    for (unsigned int k = 0; k < num_ops; k++) {
+        PipelineLatch *op = &p->pipe_latch[ID_LATCH][order[k]];
+        const TraceRec *rec = &pipe_inst(p, op)->trace_rec;
+        RegMask reads = reg_reads(rec);
+        RegMask writes = reg_writes(rec);
+        FUClass fc = fu_class(rec);
+        bool is_mem = fc == FU_LOAD || fc == FU_STORE;
+
+        // Only the oldest stalled instruction says why ID stalled. A hazard
+        // on a writer beside it in ID or on a load in EX stays with all
+        // forwarding enabled.
+        if (!stalled) {
+            RegMask hazards = reads & (stall_mask | older_writes);
+            RegMask pending;
+            if (hazards) {
+                RegMask unremovable = hazards & (older_writes | p->sb.ex_load_writes);
+                stall_cause = unremovable ? raw_cause(unremovable, false)
+                                          : raw_cause(hazards, true);
+                stalled = true;
+            } else if ((pending = regs_pending(p, reads))) {
+                p->stat_latency_stalls++;
+                stall_cause = raw_cause(pending, false);
+                stalled = true;
+            } else if (is_mem && MEM_PORTS && mem_ops >= MEM_PORTS) {
+                p->stat_port_stalls++;
+                stall_cause = BUBBLE_STRUCTURAL;
+                stalled = true;
+            } else if (!fu_claim(p, fc)) {
+                p->stat_fu_stalls[fc]++;
+                stall_cause = BUBBLE_STRUCTURAL;
+                stalled = true;
             }
         }
-        /*
-        ============================{ A3 }============================
-        After iterating through EX in each pipeline j to check if there is a RAW dependency
-        on pipeline i's ID, check if any of the oldest (latest in the program trace) 
-        hazard-causing instructions for each type (src1, src2, cc) are a LD. If any of them 
-        are a LD, we have to stall ID.
-
-        Ensure that our indices were actually updated; they were set to PIPE_WIDTH by default.
-        */
-        if (ENABLE_EXE_FWD) {
-            if ((oldest_src1_j != PIPE_WIDTH && p->pipe_latch[EX_LATCH][oldest_src1_j].trace_rec.op_type == OP_LD) ||
-                (oldest_src2_j != PIPE_WIDTH && p->pipe_latch[EX_LATCH][oldest_src2_j].trace_rec.op_type == OP_LD) ||
-                (oldest_cc_j != PIPE_WIDTH && p->pipe_latch[EX_LATCH][oldest_cc_j].trace_rec.op_type == OP_LD)) {
-                p->pipe_latch[ID_LATCH][i].stall = 1;
-            }
-        }
-    }
 
-    /*
-    ============================{ A2 }============================
-    To maintain the in-order property of the pipeline, if we ever have
-    a stalled instruction in ID then we must stall all later instructions
-    in the program trace. For instance...
-    IF:   ID:   EX:   MA:
-    7     5     3     1
-    8     6     4     2
-
-    If 5 is stalled here and we allow 6 to move, then we'd get...
-    IF:   ID:   EX:   MA:
-    7     5     ---   3 
-    9     8     6     4 
-
-    This would mean 6 to finishes before 5, which is not allowed. Therefore,
-    we should instead also stall 6 regardless of there being a RAW hazard...
-    IF:   ID:   EX:   MA:
-    7     5     ---   3
-    8     6     ---   4
-    */ 
-    for (unsigned int i = 0; i < PIPE_WIDTH; i++) {
-        if (!p->pipe_latch[ID_LATCH][i].stall) continue;
-
-        for (unsigned int j = 0; j < PIPE_WIDTH; j++) {
-            if (p->pipe_latch[ID_LATCH][j].op_id > p->pipe_latch[ID_LATCH][i].op_id) {
-                p->pipe_latch[ID_LATCH][j].stall = 1;
+        if (stalled) {
+            // The younger instructions are held behind the oldest stalled
+            // one, and their bubbles share its cause.
+            op->stall = true;
+            op->bubble_cause = stall_cause;
+        } else {
+            // This instruction enters EX next cycle; it is now the youngest
+            // writer of its destinations there.
+            pass_writes |= writes;
+            pass_load_writes &= ~writes;
+            if (rec->op_type == OP_LD) pass_load_writes |= writes;
+            if (is_mem) mem_ops++;
+
+            // A one-cycle result can be read by an instruction leaving ID
+            // next cycle with forwarding from EX, but a load's only in the
+            // cycle after from MA, and without forwarding only once it has
+            // left MA.
+            uint64_t ready = p->stat_num_cycle + FU_CONFIG[fc].latency - 1;
+            ready += (rec->op_type != OP_LD && ENABLE_EXE_FWD) ? 1 : ENABLE_MEM_FWD ? 2 : 3;
+            for (RegMask w = writes; w; w &= w - 1) {
+                p->reg_ready[__builtin_ctzll(w)] = ready;
             }
         }
+        older_writes |= writes;
     }
+
+    p->sb.id_writes = pass_writes;
+    p->sb.id_load_writes = pass_load_writes;
 }
 
 /**
- * Helper method for pipe_cycle_ID.
- * 
- * Using the passed in pipeline, checks the ID_LATCH of i &
- * the latch of j to see if there are any src1, src2, or cc
- * RAW hazards.
+ * Fetch the next instruction of this cycle's fetch block, if there is one.
  * 
- * Reurns an bit-vector (set as an int) based on the type of hazard (for A3 logic).
- * The bits in the vector are as follows:
- * {31 - 3}: Unused
- * {2}: cc dependency
- * {1}: src2 dependency
- * {0}: src1 dependency
+ * The fetch block ends after FETCH_WIDTH instructions, at the first
+ * instruction outside its aligned FETCH_BYTES, or after a taken branch if
+ * FETCH_BREAK_TAKEN is set. Nothing is fetched while fetch is stalled on a
+ * mispredicted branch or redirected after a BTB miss.
  * 
- * @param p the pipeline to simulate
- * @param i the pipeline index of the ID_LATCH to compare to
- * @param j the pipeline index of the @latch to compare with
- * @param latch the latch of the pipeline to compare with
- * @return bit-vector as an int where the first 3 bits indicate the type of dependency/dependencies
+ * @param p the pipeline
+ * @param fetch_op the PipelineLatch struct to populate
+ * @return whether an instruction was fetched
  */
-int has_raw_hazards(Pipeline *p, unsigned int i, unsigned int j, LatchType latch) {
-    if (!p->pipe_latch[latch][j].valid) return 0;
-
-    int output = 0;
-
-    uint8_t src1_needed = p->pipe_latch[ID_LATCH][i].trace_rec.src1_needed;
-    uint8_t src2_needed = p->pipe_latch[ID_LATCH][i].trace_rec.src2_needed;
-    uint8_t dest_needed = p->pipe_latch[latch][j].trace_rec.dest_needed;
-
-    uint8_t src1_reg = p->pipe_latch[ID_LATCH][i].trace_rec.src1_reg;
-    uint8_t src2_reg = p->pipe_latch[ID_LATCH][i].trace_rec.src2_reg;
-    uint8_t dest_reg = p->pipe_latch[latch][j].trace_rec.dest_reg;
+static bool pipe_fetch_next(Pipeline *p, PipelineLatch *fetch_op)
+{
+    if (p->fetch_cbr_stall)
+    {
+        p->fetch_stall_cause = BUBBLE_BRANCH;
+        return false;
+    }
+    if (p->stat_num_cycle < p->fetch_redirect_until || p->fetch_block_done ||
+        p->fetch_count >= (FETCH_WIDTH ? FETCH_WIDTH : PIPE_WIDTH))
+    {
+        p->fetch_stall_cause = BUBBLE_FRONTEND;
+        return false;
+    }
 
-    uint8_t cc_read = p->pipe_latch[ID_LATCH][i].trace_rec.cc_read;
-    uint8_t cc_write = p->pipe_latch[latch][j].trace_rec.cc_write;
+    // Read an instruction from the trace file.
+    if (!p->fetch_next_valid)
+    {
+        pipe_get_fetch_op(p, &p->fetch_next_op);
+        if (!p->fetch_next_op.valid)
+        {
+            // The end of the trace. If fetch was stalled on the last
+            // instruction until it retired, nothing is left to halt the
+            // pipeline in WB.
+            if (p->stat_retired_inst == p->last_op_id)
+            {
+                p->halt = true;
+            }
+            p->fetch_stall_cause = BUBBLE_FILL_DRAIN;
+            return false;
+        }
+        p->fetch_next_valid = true;
+    }
 
-    if (src1_needed && dest_needed && src1_reg == dest_reg) {
-        output |= 1;
+    if (FETCH_BYTES)
+    {
+        uint64_t block_addr = pipe_inst(p, &p->fetch_next_op)->trace_rec.inst_addr &
+                              ~(uint64_t)(FETCH_BYTES - 1);
+        if (p->fetch_count == 0)
+        {
+            p->fetch_block_addr = block_addr;
+        }
+        else if (block_addr != p->fetch_block_addr)
+        {
+            p->fetch_block_done = true;
+            p->fetch_stall_cause = BUBBLE_FRONTEND;
+            return false;
+        }
     }
 
-    if (src2_needed && dest_needed && src2_reg == dest_reg) {
-        output |= 2;
+    *fetch_op = p->fetch_next_op;
+    p->fetch_next_valid = false;
+    p->fetch_count++;
+
+    // Handle branch (mis)prediction.
+    if (BPRED_POLICY != BPRED_PERFECT || p->btb)
+    {
+        pipe_check_bpred(p, fetch_op);
     }
 
-    if (cc_read && cc_write) {
-        output |= 4;
+    const TraceRec *rec = &pipe_inst(p, fetch_op)->trace_rec;
+    if (FETCH_BREAK_TAKEN && rec->op_type == OP_CBR && rec->br_dir)
+    {
+        p->fetch_block_done = true;
     }
 
-    return output;
+    return true;
 }
 
 /**
@@ -593,6 +815,36 @@ int has_raw_hazards(Pipeline *p, unsigned int i, unsigned int j, LatchType latch
  */
 void pipe_cycle_IF(Pipeline *p)
 {
+    p->fetch_count = 0;
+    p->fetch_block_done = false;
+    // A fetch queue too small to feed the IF latch also starves it.
+    p->fetch_stall_cause = BUBBLE_FRONTEND;
+
+    // With a decoupled front end, the fetch unit fills the fetch queue even
+    // while ID is stalled, and the IF latch takes instructions from it.
+    if (p->fetch_queue)
+    {
+        while (p->fq_count < FETCH_QUEUE_SIZE)
+        {
+            PipelineLatch fetch_op;
+            if (!pipe_fetch_next(p, &fetch_op))
+            {
+                break;
+            }
+            p->fetch_queue[(p->fq_head + p->fq_count) % FETCH_QUEUE_SIZE] = fetch_op;
+            p->fq_count++;
+        }
+
+        p->stat_fq_occupancy += p->fq_count;
+        if (p->fq_count == FETCH_QUEUE_SIZE)
+        {
+            p->stat_fq_full_cycles++;
+        }
+    }
+
+    // The IF latch holds its instructions while MA is busy.
+    if (pipe_ma_busy(p)) return;
+
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         // If ID is stalled, do not fetch the next instruction
@@ -601,34 +853,33 @@ void pipe_cycle_IF(Pipeline *p)
             //std::cout<<"ID stall Signal detected at IF Stage"<<std::endl;
             continue;
         }
-        //If IF is stalled by wrong prediction
-        if (p->fetch_cbr_stall == true)
+
+        if (p->fetch_queue)
         {
-            //std::cout<<"CBR Stall Signal detected at IF Stage"<<std::endl;
-            p->pipe_latch[IF_LATCH][i].valid = false;
+            if (p->fq_count == 0)
+            {
+                p->pipe_latch[IF_LATCH][i].valid = false;
+                p->pipe_latch[IF_LATCH][i].bubble_cause = p->fetch_stall_cause;
+                continue;
+            }
+            p->pipe_latch[IF_LATCH][i] = p->fetch_queue[p->fq_head];
+            p->fq_head = (p->fq_head + 1) % FETCH_QUEUE_SIZE;
+            p->fq_count--;
             continue;
         }
-        else
-        {
-            p->pipe_latch[IF_LATCH][i].valid = true;
-        }
-
-        //std::cout<<"Normal Fetch at IF Stage"<<std::endl;
 
-        // Read an instruction from the trace file.
+        // Copy the instruction to the IF latch, or insert a bubble if fetch
+        // is stalled by a wrong prediction, redirected by a BTB miss, or at
+        // the end of its fetch block.
         PipelineLatch fetch_op;
-        pipe_get_fetch_op(p, &fetch_op);
-
-        // Handle branch (mis)prediction.
-        if (BPRED_POLICY != BPRED_PERFECT)
-        {   
-            //std::cout<<"Normal predict check at IF Stage"<<std::endl;
-            pipe_check_bpred(p, &fetch_op);
+        if (!pipe_fetch_next(p, &fetch_op))
+        {
+            p->pipe_latch[IF_LATCH][i].valid = false;
+            p->pipe_latch[IF_LATCH][i].bubble_cause = p->fetch_stall_cause;
+            continue;
         }
-
-        // Copy the instruction to the IF latch.
         p->pipe_latch[IF_LATCH][i] = fetch_op;
-        //printf("Fetching %lu!\n", p->pipe_latch[IF_LATCH][i].op_id);
+        //printf("Fetching %lu!\n", pipe_inst(p, &p->pipe_latch[IF_LATCH][i])->op_id);
     }
 }
 
@@ -644,35 +895,62 @@ void pipe_cycle_IF(Pipeline *p)
  */
 void pipe_check_bpred(Pipeline *p, PipelineLatch *fetch_op)
 {
+    PipelineInst *inst = pipe_inst(p, fetch_op);
+
     // Check whether it is OP_CBR first
-    if (fetch_op->trace_rec.op_type == OP_CBR)
+    if (inst->trace_rec.op_type == OP_CBR)
     {
-        //std::cout<<"Predict at IF stage"<<std::endl;
+        BranchDirection resolution =
+            static_cast<BranchDirection>(inst->trace_rec.br_dir);
+
         // TODO: For a conditional branch instruction, get a prediction from the
         // branch predictor.
-      
-        BranchDirection takenChoice;
+        // With the perfect policy, only the target may be mispredicted.
+        BranchDirection takenChoice = resolution;
+        if (BPRED_POLICY != BPRED_PERFECT)
+        {
+            takenChoice = p->b_pred->predict(inst->trace_rec.inst_addr);
+
+            // TODO: Immediately update the branch predictor.
+            p->b_pred->update(inst->trace_rec.inst_addr, takenChoice, resolution);
+        }
 
-        takenChoice = p->b_pred->predict(fetch_op->trace_rec.inst_addr);
-        
         // TODO: If the branch predictor mispredicted, mark the fetch_op
         // accordingly.
-        //std::cout<<"Check whether mis at IF stage"<<std::endl;                 
-        if (takenChoice != static_cast<BranchDirection>(fetch_op->trace_rec.br_dir))
-        {
-            //std::cout<<"Find mis at prediction"<<std::endl; 
-            fetch_op->is_mispred_cbr = true;
-            p->fetch_cbr_stall = true;
-        }        
+        bool mispred = takenChoice != resolution;
 
-        // TODO: Immediately update the branch predictor.
-        //void BPred::update(uint64_t pc, BranchDirection prediction, BranchDirection resolution)
-        //std::cout<<"Update at IF stage"<<std::endl; 
-        p->b_pred->update(fetch_op->trace_rec.inst_addr, takenChoice, static_cast<BranchDirection>(fetch_op->trace_rec.br_dir));
+        // A branch correctly predicted taken also needs its target. On a BTB
+        // miss, fetch waits for decode to compute it; a wrong target from the
+        // BTB is only found out when the branch resolves, like a wrong
+        // direction.
+        if (p->btb)
+        {
+            uint64_t target = 0;
+            bool hit = p->btb->predict(inst->trace_rec.inst_addr, &target);
+            if (resolution == TAKEN)
+            {
+                if (!mispred && !hit)
+                {
+                    p->stat_btb_redirects++;
+                    p->fetch_redirect_until = p->stat_num_cycle + BTB_MISS_PENALTY + 1;
+                }
+                else if (!mispred && target != inst->trace_rec.br_target)
+                {
+                    p->stat_target_mispred++;
+                    mispred = true;
+                }
+                p->btb->update(inst->trace_rec.inst_addr,
+                               inst->trace_rec.br_target);
+            }
+        }
 
         // TODO: If needed, stall the IF stage by setting the flag
         // p->fetch_cbr_stall.
-
+        if (mispred)
+        {
+            inst->is_mispred_cbr = true;
+            p->fetch_cbr_stall = true;
+        }
     }
 
 }
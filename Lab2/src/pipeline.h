@@ -13,15 +13,19 @@
 
 #include "trace.h"
 #include "bpred.h"
+#include "btb.h"
 #include <inttypes.h>
 
+// The Lab4 memory system, declared in memsys.h.
+struct MemorySystem;
+
 /**
  * [Internal] The maximum allowed width of the pipeline.
  * 
  * This is an implementation detail that defines the array size of
  * Pipeline::pipe_latch; you should not have to use this value directly.
  */
-#define MAX_PIPE_WIDTH 8
+#define MAX_PIPE_WIDTH 16
 
 /**
  * The width of the pipeline; that is, the maximum number of instructions that
@@ -67,24 +71,179 @@ extern uint32_t ENABLE_EXE_FWD;
 extern BPredPolicy BPRED_POLICY;
 
 /**
- * One of the latches in the pipeline. 
- * Each one of these can contain one
- * operation to be processed by the next pipeline stage.
+ * The storage budget of the branch predictor in KB, or 0 for the default of
+ * its policy.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredsize.
  */
-typedef struct PipelineLatchStruct
+extern uint32_t BPRED_SIZE_KB;
+
+/**
+ * The global history length of the branch predictor, or 0 for the default of
+ * its policy and size.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredhist.
+ */
+extern uint32_t BPRED_HIST_LEN;
+
+/**
+ * The number of entries in the branch target buffer, or 0 to predict the
+ * targets of taken branches perfectly.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbsize.
+ */
+extern uint32_t BTB_SIZE;
+
+/**
+ * The associativity of the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbassoc.
+ */
+extern uint32_t BTB_ASSOC;
+
+/**
+ * The replacement policy of the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbrepl.
+ */
+extern BTBReplPolicy BTB_REPL;
+
+/**
+ * The number of cycles fetch is redirected for when a taken branch misses in
+ * the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbpenalty.
+ */
+extern uint32_t BTB_MISS_PENALTY;
+
+/**
+ * The number of entries in the target cache for indirect branches, or 0 for
+ * none. The traces have only conditional branches, which never use it.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -indirectsize.
+ */
+extern uint32_t INDIRECT_SIZE;
+
+/**
+ * The number of entries in the fetch queue between the fetch unit and the IF
+ * latch, or 0 for a front end where fetch fills the IF latch directly.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchq.
+ */
+extern uint32_t FETCH_QUEUE_SIZE;
+
+/**
+ * The maximum number of instructions fetched per cycle, or 0 for the width
+ * of the pipeline.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchwidth.
+ */
+extern uint32_t FETCH_WIDTH;
+
+/**
+ * The size in bytes of the aligned fetch block that the instructions fetched
+ * in a cycle must lie in, or 0 for no limit.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchbytes.
+ */
+extern uint32_t FETCH_BYTES;
+
+/**
+ * A Boolean indicating whether a taken branch ends the fetch block, so that
+ * its target is fetched in the next cycle.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchbreak.
+ */
+extern uint32_t FETCH_BREAK_TAKEN;
+
+/**
+ * The classes of functional units. Each type of operation executes on a unit
+ * of one class.
+ */
+typedef enum FUClassEnum
 {
+    FU_ALU,    // ALU operations, and any other operation
+    FU_LOAD,   // Loads
+    FU_STORE,  // Stores
+    FU_BRANCH, // Conditional branches
+    NUM_FU_CLASSES
+} FUClass;
+
+/**
+ * [Internal] The maximum number of functional units of each class.
+ */
+#define MAX_FU_UNITS 16
+
+/**
+ * The configuration of the functional units of one class.
+ */
+typedef struct FUConfigStruct
+{
+    /** The number of units, or 0 for one per lane of the pipeline. */
+    uint32_t count;
+
     /**
-     * Is this operation valid? Set to Bubble?
-     * 
-     * If false, this latch does not contain an instruction, but rather a
-     * bubble in the pipeline, and so it should not be processed further. Any
-     * other fields in this struct should be ignored.
-     * 
-     * Your code may set this to false at any time to create a bubble in the
-     * pipeline.
+     * The number of cycles an operation spends executing. Its result can be
+     * forwarded latency - 1 cycles later than that of a one-cycle operation;
+     * the operation itself still moves on through MA and WB as usual.
      */
-    bool valid;
+    uint32_t latency;
+
+    /**
+     * Whether a unit can start a new operation every cycle. If not, it is
+     * busy for the whole latency of each operation.
+     */
+    bool pipelined;
+} FUConfig;
+
+/**
+ * The functional units of each class, indexed by FUClass.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fu.
+ */
+extern FUConfig FU_CONFIG[NUM_FU_CLASSES];
+
+/**
+ * The number of loads and stores that can leave ID per cycle, or 0 for no
+ * limit.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -memports.
+ */
+extern uint32_t MEM_PORTS;
+
+/**
+ * A Boolean indicating whether loads and stores should access the Lab4
+ * memory system in MA, so that loads take as long as their cache and DRAM
+ * accesses do.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -memsys.
+ */
+extern uint32_t ENABLE_MEMSYS;
 
+/**
+ * An instruction in flight in the pipeline.
+ * 
+ * Each instruction is allocated from the pipeline's instruction pool when it
+ * is fetched and freed when it retires. The latches only refer to it by its
+ * index in the pool, so moving an instruction from one stage to the next does
+ * not copy its trace record.
+ */
+typedef struct PipelineInstStruct
+{
     /**
      * A unique, monotonically increasing ID for this operation in the trace
      * file.
@@ -98,16 +257,6 @@ typedef struct PipelineLatchStruct
      */
     uint64_t op_id;
 
-    /**
-     * Should this operation be stalled?
-     * 
-     * Your code may set this to stall or unstall an operation as needed.
-     * However, setting this flag does not inherently change anything; it is up
-     * to you to write the code to do the right thing when a stall flag is
-     * encountered in a PipelineLatch.
-     */
-    bool stall;
-
     /**
      * The trace record containing information about this instruction, 
      * such as what type of instruction it is, 
@@ -125,6 +274,80 @@ typedef struct PipelineLatchStruct
      * This is only relevant for part B of the lab.
      */
     bool is_mispred_cbr;
+} PipelineInst;
+
+/**
+ * The index of an instruction in the pipeline's instruction pool.
+ */
+typedef uint32_t InstIndex;
+
+/**
+ * The causes of a bubble in the pipeline, for the CPI stack.
+ * 
+ * A bubble gets its cause where it is created and keeps it down to WB, where
+ * every lane that does not retire an instruction is charged to the cause of
+ * its bubble. A RAW hazard is removable if a disabled forwarding path would
+ * have removed it; load-use hazards, dependences within ID, and results of
+ * multi-cycle units are not. A BTB miss counts as a front end bubble, and a
+ * wrong target from the BTB as a mispredicted branch.
+ */
+typedef enum BubbleCauseEnum
+{
+    BUBBLE_FILL_DRAIN,     // The pipeline filling up or draining at the end
+    BUBBLE_RAW_REG_FWDOFF, // RAW on a register, removable by forwarding
+    BUBBLE_RAW_REG_NOPATH, // RAW on a register, not removable by forwarding
+    BUBBLE_RAW_CC_FWDOFF,  // RAW on the condition codes, removable
+    BUBBLE_RAW_CC_NOPATH,  // RAW on the condition codes, not removable
+    BUBBLE_STRUCTURAL,     // No free functional unit or memory port
+    BUBBLE_BRANCH,         // Fetch stalled on a mispredicted branch
+    BUBBLE_FRONTEND,       // Fetch delivered too few instructions
+    BUBBLE_MEMORY,         // MA waiting on the memory system for a load
+    NUM_BUBBLE_CAUSES
+} BubbleCause;
+
+/**
+ * One of the latches in the pipeline. 
+ * Each one of these can contain one
+ * operation to be processed by the next pipeline stage.
+ */
+typedef struct PipelineLatchStruct
+{
+    /**
+     * Is this operation valid? Set to Bubble?
+     * 
+     * If false, this latch does not contain an instruction, but rather a
+     * bubble in the pipeline, and so it should not be processed further. Any
+     * other fields in this struct should be ignored.
+     * 
+     * Your code may set this to false at any time to create a bubble in the
+     * pipeline.
+     */
+    bool valid;
+
+    /**
+     * Should this operation be stalled?
+     * 
+     * Your code may set this to stall or unstall an operation as needed.
+     * However, setting this flag does not inherently change anything; it is up
+     * to you to write the code to do the right thing when a stall flag is
+     * encountered in a PipelineLatch.
+     */
+    bool stall;
+
+    /**
+     * The instruction in this latch, as an index into the pipeline's
+     * instruction pool; use pipe_inst() to get to it.
+     * 
+     * A stalled instruction may be in two latches at once, e.g., IF and ID,
+     * but only one copy moves on.
+     */
+    InstIndex inst;
+
+    /**
+     * Why this latch holds a bubble, as a BubbleCause; only meaningful if the
+     * latch is not valid, or is stalled in ID.
+     */
+    uint8_t bubble_cause;
 } PipelineLatch;
 
 /**
@@ -140,6 +363,46 @@ typedef enum LatchTypeEnum
     NUM_LATCH_TYPES
 } LatchType;
 
+/**
+ * A set of registers, as a bitmask with one bit per architectural register
+ * (bit r for register r) and one more for the condition codes.
+ */
+typedef uint64_t RegMask;
+
+/**
+ * The number of architectural registers in the ISA of the traces. Trace
+ * records naming a register at or above this are rejected when read.
+ */
+#define NUM_ARCH_REGS 32
+
+/** The bit of a RegMask for the condition codes. */
+#define REGMASK_CC ((RegMask)1 << NUM_ARCH_REGS)
+
+/**
+ * The register scoreboard: which registers have a pending writer in each of
+ * the latches the ID stage checks for RAW hazards.
+ * 
+ * The masks move along with the instructions they describe: the ID stage
+ * computes them for the instructions it lets through, which then become the
+ * EX latch's masks in the next cycle and the MA latch's in the one after.
+ */
+typedef struct ScoreboardStruct
+{
+    /**
+     * The registers written by the instructions leaving ID this cycle, and
+     * those of them whose youngest writer is a load.
+     */
+    RegMask id_writes;
+    RegMask id_load_writes;
+
+    /** The same for the instructions in the EX latch. */
+    RegMask ex_writes;
+    RegMask ex_load_writes;
+
+    /** The registers written by the instructions in the MA latch. */
+    RegMask ma_writes;
+} Scoreboard;
+
 /**
  * The data structure for a pipelined processor.
  */
@@ -158,6 +421,15 @@ typedef struct Pipeline
      */
     PipelineLatch pipe_latch[NUM_LATCH_TYPES][MAX_PIPE_WIDTH];
 
+    /**
+     * The instruction pool: an entry for every instruction that can be in
+     * flight at once (in the latches, the fetch queue, or read ahead by
+     * fetch), and a stack of the indices of the free entries.
+     */
+    PipelineInst *inst_pool;
+    InstIndex *inst_free;
+    uint32_t inst_free_count;
+
     /**
      * The branch predictor.
      * 
@@ -188,6 +460,78 @@ typedef struct Pipeline
      */
     bool fetch_cbr_stall;
 
+    /**
+     * The branch target buffer, or NULL if targets are predicted perfectly.
+     */
+    BTB *btb;
+
+    /**
+     * Fetch is redirected until this cycle after a taken branch missed in the
+     * branch target buffer: the branch's target is only known once it has
+     * been decoded.
+     */
+    uint64_t fetch_redirect_until;
+
+    /**
+     * The fetch queue between the fetch unit and the IF latch, as a ring
+     * buffer of FETCH_QUEUE_SIZE entries, or NULL if the fetch unit fills the
+     * IF latch directly.
+     */
+    PipelineLatch *fetch_queue;
+    unsigned int fq_head;
+    unsigned int fq_count;
+
+    /**
+     * The next instruction of the trace, if it has been read ahead to check
+     * whether it fits in the current fetch block.
+     */
+    PipelineLatch fetch_next_op;
+    bool fetch_next_valid;
+
+    /**
+     * This cycle's fetch block: the instructions fetched so far, its aligned
+     * address, and whether it has ended.
+     */
+    unsigned int fetch_count;
+    uint64_t fetch_block_addr;
+    bool fetch_block_done;
+
+    /**
+     * Why fetch last failed to deliver an instruction this cycle.
+     */
+    BubbleCause fetch_stall_cause;
+
+    /**
+     * The memory system that loads and stores access in MA, or NULL if they
+     * all take one cycle.
+     */
+    MemorySystem *memsys;
+
+    /**
+     * MA is busy until this cycle with the loads of the instructions in the
+     * EX latch, whose accesses have been made if ma_access_done is set. The
+     * earlier stages are frozen meanwhile.
+     */
+    uint64_t ma_busy_until;
+    bool ma_access_done;
+
+    /**
+     * The register scoreboard used by the ID stage to detect RAW hazards.
+     */
+    Scoreboard sb;
+
+    /**
+     * The cycle from which each functional unit can start a new operation.
+     */
+    uint64_t fu_busy_until[NUM_FU_CLASSES][MAX_FU_UNITS];
+
+    /**
+     * The cycle from which an instruction reading each register (indexed by
+     * its bit in a RegMask) may leave ID, given the latency of its youngest
+     * writer.
+     */
+    uint64_t reg_ready[NUM_ARCH_REGS + 1];
+
     /**
      * The total number of committed instructions.
      * 
@@ -204,6 +548,36 @@ typedef struct Pipeline
      */
     uint64_t stat_num_cycle;
 
+    /** The number of taken branches that missed in the branch target buffer. */
+    uint64_t stat_btb_redirects;
+
+    /**
+     * The number of branches whose direction was predicted correctly but
+     * whose target was not.
+     */
+    uint64_t stat_target_mispred;
+
+    /** The fetch queue occupancy summed over all cycles. */
+    uint64_t stat_fq_occupancy;
+
+    /** The number of cycles the fetch queue was full. */
+    uint64_t stat_fq_full_cycles;
+
+    /**
+     * The number of cycles ID stalled because no functional unit of each
+     * class was free, because all memory ports were taken, and because a
+     * source operand was still being computed by a multi-cycle unit.
+     */
+    uint64_t stat_fu_stalls[NUM_FU_CLASSES];
+    uint64_t stat_port_stalls;
+    uint64_t stat_latency_stalls;
+
+    /**
+     * The number of lanes of WB that retired no instruction, by the cause of
+     * their bubble.
+     */
+    uint64_t stat_bubbles[NUM_BUBBLE_CAUSES];
+
     /** [Internal] The file descriptor from which to read trace records.
      
      */
@@ -216,6 +590,18 @@ typedef struct Pipeline
     bool halt;
 } Pipeline;
 
+/**
+ * Return the instruction in a pipeline latch.
+ * 
+ * @param p the pipeline
+ * @param latch the latch, which must be valid
+ * @return the instruction, in the pipeline's instruction pool
+ */
+static inline PipelineInst *pipe_inst(Pipeline *p, const PipelineLatch *latch)
+{
+    return &p->inst_pool[latch->inst];
+}
+
 /**
  * Allocate and initialize a new pipeline.
  * 
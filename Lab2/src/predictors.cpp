@@ -0,0 +1,751 @@
+// predictors.cpp
+// Implements the direction predictors behind the BPred class.
+
+#include "predictors.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/** The bits of a loop predictor entry: valid bit, tag, two iteration counts,
+ *  confidence, age, and direction. */
+#define LOOP_ENTRY_BITS (1 + 14 + 14 + 14 + 2 + 8 + 1)
+#define LOOP_WAYS 4
+#define LOOP_TAG_MASK 0x3FFF
+#define LOOP_ITER_MAX 0x3FFF
+#define LOOP_NEW_AGE 31
+
+/** The usefulness counters of TAGE are aged every this many branches. */
+#define TAGE_U_RESET_PERIOD (1 << 18)
+
+/**
+ * @return the base-2 logarithm of the largest power of 2 not above x, or 0 if
+ *         x is 0
+ */
+static unsigned int floor_log2(uint64_t x)
+{
+    unsigned int bits = 0;
+    while (x > 1)
+    {
+        x >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+/**
+ * @return a mask of the given number of low bits
+ */
+static inline uint64_t low_mask(unsigned int bits)
+{
+    return bits >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+}
+
+/**
+ * Move a 2-bit saturating counter towards the branch outcome.
+ *
+ * @param ctr the counter
+ * @param resolution the outcome of the branch
+ */
+static inline void update_counter(uint8_t *ctr, BranchDirection resolution)
+{
+    if (resolution == TAKEN)
+    {
+        *ctr = sat_increment(*ctr, 3);
+    }
+    else
+    {
+        *ctr = sat_decrement(*ctr);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                ALWAYS TAKEN                               //
+///////////////////////////////////////////////////////////////////////////////
+
+BranchDirection AlwaysTakenPredictor::predict(uint64_t pc)
+{
+    return TAKEN;
+}
+
+void AlwaysTakenPredictor::update(uint64_t pc, BranchDirection resolution)
+{
+}
+
+uint64_t AlwaysTakenPredictor::storage_bits() const
+{
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                  BIMODAL                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+BimodalPredictor::BimodalPredictor(uint64_t budget_bits)
+{
+    uint64_t entries = (uint64_t)1 << floor_log2(std::max<uint64_t>(budget_bits / 2, 1));
+    pht.assign(entries, 2);
+    mask = entries - 1;
+}
+
+BranchDirection BimodalPredictor::predict(uint64_t pc)
+{
+    return pht[pc & mask] > 1 ? TAKEN : NOT_TAKEN;
+}
+
+void BimodalPredictor::update(uint64_t pc, BranchDirection resolution)
+{
+    update_counter(&pht[pc & mask], resolution);
+}
+
+uint64_t BimodalPredictor::storage_bits() const
+{
+    return 2 * pht.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                   GSHARE                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+GsharePredictor::GsharePredictor(uint64_t budget_bits, unsigned int hist_len)
+{
+    index_bits = floor_log2(std::max<uint64_t>(budget_bits / 2, 1));
+    pht.assign((size_t)1 << index_bits, 2);
+    this->hist_len = hist_len ? std::min(hist_len, 64u) : index_bits;
+    ghr = 0;
+    last_index = 0;
+}
+
+/**
+ * @return the PHT index of the branch at the given address under the current
+ *         global history
+ */
+uint64_t GsharePredictor::index(uint64_t pc) const
+{
+    uint64_t mask = low_mask(index_bits);
+    uint64_t folded = 0;
+    if (index_bits > 0)
+    {
+        for (uint64_t h = ghr; h != 0; h >>= index_bits)
+        {
+            folded ^= h & mask;
+            if (index_bits >= 64)
+            {
+                break;
+            }
+        }
+    }
+    return (folded ^ pc) & mask;
+}
+
+BranchDirection GsharePredictor::predict(uint64_t pc)
+{
+    last_index = index(pc);
+    return pht[last_index] > 1 ? TAKEN : NOT_TAKEN;
+}
+
+void GsharePredictor::update(uint64_t pc, BranchDirection resolution)
+{
+    update_counter(&pht[last_index], resolution);
+    ghr = ((ghr << 1) | (resolution == TAKEN)) & low_mask(hist_len);
+}
+
+uint64_t GsharePredictor::storage_bits() const
+{
+    return 2 * pht.size() + hist_len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 TOURNAMENT                                //
+///////////////////////////////////////////////////////////////////////////////
+
+TournamentPredictor::TournamentPredictor(uint64_t budget_bits,
+                                         unsigned int hist_len)
+    : gshare(budget_bits / 2, hist_len), bimodal(budget_bits / 4)
+{
+    uint64_t entries = (uint64_t)1 << floor_log2(std::max<uint64_t>(budget_bits / 8, 1));
+    // Start out weakly preferring the gshare.
+    chooser.assign(entries, 2);
+    mask = entries - 1;
+    last_gshare = NOT_TAKEN;
+    last_bimodal = NOT_TAKEN;
+}
+
+BranchDirection TournamentPredictor::predict(uint64_t pc)
+{
+    last_gshare = gshare.predict(pc);
+    last_bimodal = bimodal.predict(pc);
+    return chooser[pc & mask] > 1 ? last_gshare : last_bimodal;
+}
+
+void TournamentPredictor::update(uint64_t pc, BranchDirection resolution)
+{
+    // Train the chooser towards whichever component was right, if only one
+    // was.
+    if (last_gshare != last_bimodal)
+    {
+        update_counter(&chooser[pc & mask],
+                       last_gshare == resolution ? TAKEN : NOT_TAKEN);
+    }
+
+    gshare.update(pc, resolution);
+    bimodal.update(pc, resolution);
+}
+
+uint64_t TournamentPredictor::storage_bits() const
+{
+    return gshare.storage_bits() + bimodal.storage_bits() + 2 * chooser.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 PERCEPTRON                                //
+///////////////////////////////////////////////////////////////////////////////
+
+PerceptronPredictor::PerceptronPredictor(uint64_t budget_bits,
+                                         unsigned int hist_len)
+{
+    // The best history lengths for each budget from Jimenez and Lin.
+    if (hist_len == 0)
+    {
+        uint64_t kb = budget_bits / 8192;
+        hist_len = kb <= 1 ? 12 : kb <= 2 ? 22 : kb <= 4 ? 28 : kb <= 8 ? 34
+                 : kb <= 16 ? 36 : kb <= 32 ? 59 : 62;
+    }
+    this->hist_len = std::min(hist_len, 63u);
+
+    num_perceptrons = std::max<uint64_t>(
+        budget_bits / (8 * (this->hist_len + 1)), 1);
+    weights.assign((size_t)num_perceptrons * (this->hist_len + 1), 0);
+    threshold = (int)(1.93 * this->hist_len + 14);
+    ghr = 0;
+    last_row = 0;
+    last_output = 0;
+}
+
+BranchDirection PerceptronPredictor::predict(uint64_t pc)
+{
+    last_row = pc % num_perceptrons;
+    const int8_t *w = &weights[(size_t)last_row * (hist_len + 1)];
+
+    int y = w[0];
+    for (unsigned int i = 0; i < hist_len; i++)
+    {
+        y += (ghr >> i) & 1 ? w[i + 1] : -w[i + 1];
+    }
+    last_output = y;
+
+    return y >= 0 ? TAKEN : NOT_TAKEN;
+}
+
+void PerceptronPredictor::update(uint64_t pc, BranchDirection resolution)
+{
+    bool taken = resolution == TAKEN;
+
+    // Train on a misprediction, or when the output was not confident enough.
+    if ((last_output >= 0) != taken || abs(last_output) <= threshold)
+    {
+        int8_t *w = &weights[(size_t)last_row * (hist_len + 1)];
+        for (unsigned int i = 0; i <= hist_len; i++)
+        {
+            // The bias weight's input is always 1.
+            bool x = i == 0 || ((ghr >> (i - 1)) & 1);
+            int step = x == taken ? 1 : -1;
+            w[i] = (int8_t)std::max(-128, std::min(127, w[i] + step));
+        }
+    }
+
+    ghr = ((ghr << 1) | taken) & low_mask(hist_len);
+}
+
+uint64_t PerceptronPredictor::storage_bits() const
+{
+    return 8 * weights.size() + hist_len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                    TAGE                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+GlobalHistory::GlobalHistory(unsigned int max_len) : head(0)
+{
+    bits.assign((size_t)1 << (floor_log2(max_len) + 1), 0);
+    mask = bits.size() - 1;
+}
+
+/**
+ * Record the outcome of a branch as the newest in the history.
+ *
+ * @param taken 1 if the branch was taken, 0 otherwise
+ */
+void GlobalHistory::push(uint8_t taken)
+{
+    head = (head - 1) & mask;
+    bits[head] = taken;
+}
+
+/**
+ * Set the lengths of the history to fold and of the result.
+ *
+ * @param orig_len the number of history bits to fold; the global history must
+ *                 hold at least one more
+ * @param comp_len the number of bits to fold them into (at most 31)
+ */
+void FoldedHistory::init(unsigned int orig_len, unsigned int comp_len)
+{
+    this->orig_len = orig_len;
+    this->comp_len = comp_len;
+    comp = 0;
+}
+
+TagePredictor::TagePredictor(uint64_t budget_bits, unsigned int num_tables,
+                             unsigned int min_hist, unsigned int max_hist,
+                             bool with_loop)
+    : ghist(max_hist)
+{
+    this->num_tables = num_tables;
+
+    // The base predictor gets an eighth of the budget.
+    base_bits = floor_log2(std::max<uint64_t>(budget_bits / 16, 1));
+    base.assign((size_t)1 << base_bits, 2);
+    uint64_t left = budget_bits - std::min<uint64_t>(budget_bits, 2 * base.size());
+
+    // The loop predictor gets a sixteenth, in sets of LOOP_WAYS entries.
+    loop_set_bits = 0;
+    use_loop = -1;
+    if (with_loop)
+    {
+        uint64_t sets = std::max<uint64_t>(
+            budget_bits / 16 / (LOOP_ENTRY_BITS * LOOP_WAYS), 1);
+        loop_set_bits = floor_log2(sets);
+        LoopEntry empty = {false, 0, 0, 0, 0, 0, 0};
+        loops.assign(LOOP_WAYS << loop_set_bits, empty);
+        left -= std::min<uint64_t>(left, LOOP_ENTRY_BITS * loops.size());
+    }
+
+    // History lengths grow geometrically, and so, more slowly, do the tags.
+    hist_lens.resize(num_tables);
+    tag_bits.resize(num_tables);
+    unsigned int entry_bits = 0;
+    for (unsigned int t = 0; t < num_tables; t++)
+    {
+        double ratio = num_tables > 1 ? (double)t / (num_tables - 1) : 0;
+        hist_lens[t] = (unsigned int)(min_hist *
+            pow((double)max_hist / min_hist, ratio) + 0.5);
+        tag_bits[t] = std::min(8 + t / 2, 15u);
+        entry_bits += 3 + 2 + tag_bits[t];
+    }
+
+    // The tagged tables share the rest, all with the same number of entries.
+    table_bits = std::max(floor_log2(std::max<uint64_t>(left / entry_bits, 1)), 1u);
+    TageEntry empty = {0, 0, 0};
+    tables.assign(num_tables, std::vector<TageEntry>((size_t)1 << table_bits, empty));
+
+    path_hist = 0;
+    fold_index.resize(num_tables);
+    fold_tag0.resize(num_tables);
+    fold_tag1.resize(num_tables);
+    for (unsigned int t = 0; t < num_tables; t++)
+    {
+        fold_index[t].init(hist_lens[t], table_bits);
+        fold_tag0[t].init(hist_lens[t], tag_bits[t]);
+        fold_tag1[t].init(hist_lens[t], tag_bits[t] - 1);
+    }
+
+    use_alt_on_na = 0;
+    tick = 0;
+    rng = 0x2545F491;
+
+    last_indices.assign(num_tables, 0);
+    last_tags.assign(num_tables, 0);
+    provider = -1;
+    alt_provider = -1;
+    provider_pred = false;
+    alt_pred = false;
+    tage_pred = false;
+    loop_way = -1;
+    loop_valid = false;
+    loop_pred = false;
+}
+
+/**
+ * @return the index of the branch at the given address in tagged table t
+ */
+uint32_t TagePredictor::index(uint64_t pc, unsigned int t) const
+{
+    uint32_t path = path_hist & low_mask(std::min(hist_lens[t], 16u));
+    uint64_t h = pc ^ (pc >> table_bits) ^ fold_index[t].comp ^ path ^
+                 (path >> table_bits);
+    return (uint32_t)(h & low_mask(table_bits));
+}
+
+/**
+ * @return the tag of the branch at the given address in tagged table t
+ */
+uint16_t TagePredictor::tag(uint64_t pc, unsigned int t) const
+{
+    uint64_t h = pc ^ fold_tag0[t].comp ^ ((uint64_t)fold_tag1[t].comp << 1);
+    return (uint16_t)(h & low_mask(tag_bits[t]));
+}
+
+/**
+ * @return the next number of a xorshift pseudo-random sequence
+ */
+uint32_t TagePredictor::next_random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/**
+ * Look up the branch at the given address in the loop predictor, setting
+ * loop_way and loop_pred.
+ *
+ * @return whether the loop predictor is confident in its prediction
+ */
+bool TagePredictor::loop_lookup(uint64_t pc)
+{
+    size_t set = (pc & low_mask(loop_set_bits)) * LOOP_WAYS;
+    uint16_t loop_tag = (pc >> loop_set_bits) & LOOP_TAG_MASK;
+
+    loop_way = -1;
+    for (unsigned int way = 0; way < LOOP_WAYS; way++)
+    {
+        const LoopEntry &e = loops[set + way];
+        if (e.valid && e.tag == loop_tag)
+        {
+            loop_way = way;
+            // Predict the exit once the loop has run as many iterations as
+            // last time.
+            loop_pred = e.curr_iter + 1 == e.past_iter ? !e.dir : e.dir;
+            return e.confidence == 3;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Train the loop predictor with the outcome of the branch just predicted.
+ *
+ * @param pc the address of the branch
+ * @param taken whether the branch was taken
+ */
+void TagePredictor::loop_update(uint64_t pc, bool taken)
+{
+    size_t set = (pc & low_mask(loop_set_bits)) * LOOP_WAYS;
+
+    if (loop_way >= 0)
+    {
+        LoopEntry &e = loops[set + loop_way];
+        LoopEntry empty = {false, 0, 0, 0, 0, 0, 0};
+
+        if (loop_valid)
+        {
+            if (taken != loop_pred)
+            {
+                // A confident entry was wrong: the branch is not a loop with
+                // a constant trip count after all.
+                e = empty;
+                return;
+            }
+            if (loop_pred != tage_pred && e.age < 255)
+            {
+                e.age++;
+            }
+        }
+
+        if (taken == e.dir)
+        {
+            // The loop continues.
+            if (++e.curr_iter > LOOP_ITER_MAX)
+            {
+                e = empty;
+            }
+            return;
+        }
+
+        // The loop exits.
+        if (e.curr_iter == 0)
+        {
+            // Not a loop.
+            e = empty;
+        }
+        else if (e.past_iter == 0)
+        {
+            // First complete run of the loop.
+            e.past_iter = e.curr_iter;
+            e.curr_iter = 0;
+        }
+        else if (e.curr_iter == e.past_iter)
+        {
+            e.confidence = std::min(e.confidence + 1, 3);
+            e.curr_iter = 0;
+        }
+        else
+        {
+            // The trip count changed.
+            e = empty;
+        }
+        return;
+    }
+
+    // Allocate an entry when TAGE mispredicts, assuming the misprediction was
+    // a loop exit.
+    if (taken != tage_pred && (next_random() & 3) == 0)
+    {
+        for (unsigned int way = 0; way < LOOP_WAYS; way++)
+        {
+            LoopEntry &e = loops[set + way];
+            if (e.age == 0)
+            {
+                e.valid = true;
+                e.tag = (pc >> loop_set_bits) & LOOP_TAG_MASK;
+                e.past_iter = 0;
+                e.curr_iter = 0;
+                e.confidence = 0;
+                e.age = LOOP_NEW_AGE;
+                e.dir = !taken;
+                return;
+            }
+        }
+        for (unsigned int way = 0; way < LOOP_WAYS; way++)
+        {
+            loops[set + way].age--;
+        }
+    }
+}
+
+BranchDirection TagePredictor::predict(uint64_t pc)
+{
+    for (unsigned int t = 0; t < num_tables; t++)
+    {
+        last_indices[t] = index(pc, t);
+        last_tags[t] = tag(pc, t);
+    }
+
+    // The longest matching history provides the prediction, and the next
+    // longest the alternate one.
+    provider = -1;
+    alt_provider = -1;
+    for (int t = num_tables - 1; t >= 0; t--)
+    {
+        if (tables[t][last_indices[t]].tag == last_tags[t])
+        {
+            if (provider < 0)
+            {
+                provider = t;
+            }
+            else
+            {
+                alt_provider = t;
+                break;
+            }
+        }
+    }
+
+    bool base_pred = base[pc & low_mask(base_bits)] > 1;
+    alt_pred = alt_provider >= 0
+        ? tables[alt_provider][last_indices[alt_provider]].ctr >= 0
+        : base_pred;
+
+    if (provider >= 0)
+    {
+        const TageEntry &e = tables[provider][last_indices[provider]];
+        provider_pred = e.ctr >= 0;
+        // A weak, not yet useful entry was likely just allocated, and the
+        // alternate prediction is often more accurate.
+        bool newly_allocated = (e.ctr == 0 || e.ctr == -1) && e.u == 0;
+        tage_pred = newly_allocated && use_alt_on_na >= 0 ? alt_pred
+                                                          : provider_pred;
+    }
+    else
+    {
+        provider_pred = base_pred;
+        tage_pred = base_pred;
+    }
+
+    bool pred = tage_pred;
+    if (!loops.empty())
+    {
+        loop_valid = loop_lookup(pc);
+        if (loop_valid && use_loop >= 0)
+        {
+            pred = loop_pred;
+        }
+    }
+
+    return pred ? TAKEN : NOT_TAKEN;
+}
+
+void TagePredictor::update(uint64_t pc, BranchDirection resolution)
+{
+    bool taken = resolution == TAKEN;
+
+    if (!loops.empty())
+    {
+        if (loop_valid && loop_pred != tage_pred)
+        {
+            use_loop = taken == loop_pred ? std::min(use_loop + 1, 63)
+                                          : std::max(use_loop - 1, -64);
+        }
+        loop_update(pc, taken);
+    }
+
+    // Allocate entries with longer histories on a misprediction.
+    bool alloc = tage_pred != taken && provider < (int)num_tables - 1;
+
+    if (provider >= 0)
+    {
+        TageEntry &e = tables[provider][last_indices[provider]];
+        bool newly_allocated = (e.ctr == 0 || e.ctr == -1) && e.u == 0;
+        if (newly_allocated)
+        {
+            if (provider_pred == taken)
+            {
+                alloc = false;
+            }
+            if (provider_pred != alt_pred)
+            {
+                use_alt_on_na = alt_pred == taken
+                    ? std::min(use_alt_on_na + 1, 7)
+                    : std::max(use_alt_on_na - 1, -8);
+            }
+        }
+    }
+
+    if (alloc)
+    {
+        // Start one or two tables further up at random, so that entries are
+        // not always allocated in the same table.
+        unsigned int first = provider + 1;
+        uint32_t r = next_random();
+        if ((r & 1) && first + 1 < num_tables)
+        {
+            first++;
+            if ((r & 2) && first + 1 < num_tables)
+            {
+                first++;
+            }
+        }
+
+        bool allocated = false;
+        for (unsigned int t = first; t < num_tables; t++)
+        {
+            TageEntry &e = tables[t][last_indices[t]];
+            if (e.u == 0)
+            {
+                e.tag = last_tags[t];
+                e.ctr = taken ? 0 : -1;
+                allocated = true;
+                break;
+            }
+        }
+        if (!allocated)
+        {
+            for (unsigned int t = first; t < num_tables; t++)
+            {
+                TageEntry &e = tables[t][last_indices[t]];
+                if (e.u > 0)
+                {
+                    e.u--;
+                }
+            }
+        }
+    }
+
+    // Periodically age the usefulness counters so that stale entries can be
+    // replaced.
+    if (++tick % TAGE_U_RESET_PERIOD == 0)
+    {
+        for (unsigned int t = 0; t < num_tables; t++)
+        {
+            for (size_t i = 0; i < tables[t].size(); i++)
+            {
+                tables[t][i].u >>= 1;
+            }
+        }
+    }
+
+    // Train the provider, and also the alternate while the provider entry is
+    // new.
+    uint8_t *base_ctr = &base[pc & low_mask(base_bits)];
+    if (provider >= 0)
+    {
+        TageEntry &e = tables[provider][last_indices[provider]];
+        if (e.u == 0)
+        {
+            if (alt_provider >= 0)
+            {
+                TageEntry &alt = tables[alt_provider][last_indices[alt_provider]];
+                alt.ctr = taken ? std::min(alt.ctr + 1, 3)
+                                : std::max(alt.ctr - 1, -4);
+            }
+            else
+            {
+                update_counter(base_ctr, resolution);
+            }
+        }
+        e.ctr = taken ? std::min(e.ctr + 1, 3) : std::max(e.ctr - 1, -4);
+        if (provider_pred != alt_pred)
+        {
+            e.u = provider_pred == taken ? std::min(e.u + 1, 3)
+                                         : std::max(e.u - 1, 0);
+        }
+    }
+    else
+    {
+        update_counter(base_ctr, resolution);
+    }
+
+    ghist.push(taken);
+    path_hist = ((path_hist << 1) | (pc & 1)) & 0xFFFF;
+    for (unsigned int t = 0; t < num_tables; t++)
+    {
+        uint8_t oldest = ghist[hist_lens[t]];
+        fold_index[t].update(taken, oldest);
+        fold_tag0[t].update(taken, oldest);
+        fold_tag1[t].update(taken, oldest);
+    }
+}
+
+uint64_t TagePredictor::storage_bits() const
+{
+    uint64_t bits = 2 * base.size() + LOOP_ENTRY_BITS * loops.size();
+    for (unsigned int t = 0; t < num_tables; t++)
+    {
+        bits += (3 + 2 + tag_bits[t]) * tables[t].size();
+    }
+    return bits + hist_lens[num_tables - 1] + 16;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                  FACTORY                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+DirPredictor *make_dir_predictor(BPredPolicy policy, uint32_t size_kb,
+                                 uint32_t hist_len)
+{
+    // The simple predictors default to the 1 KB of the original gshare (4096
+    // counters), the others to 8 KB.
+    bool simple = policy == BPRED_GSHARE || policy == BPRED_BIMODAL;
+    uint64_t budget_bits = (uint64_t)(size_kb ? size_kb : simple ? 1 : 8) * 8192;
+
+    switch (policy)
+    {
+    case BPRED_BIMODAL:
+        return new BimodalPredictor(budget_bits);
+    case BPRED_GSHARE:
+        return new GsharePredictor(budget_bits, hist_len);
+    case BPRED_TOURNAMENT:
+        return new TournamentPredictor(budget_bits, hist_len);
+    case BPRED_PERCEPTRON:
+        return new PerceptronPredictor(budget_bits, hist_len);
+    case BPRED_TAGE:
+        return new TagePredictor(budget_bits, 7, 5, 130, false);
+    case BPRED_LTAGE:
+        return new TagePredictor(budget_bits, 12, 4, 640, true);
+    default:
+        return new AlwaysTakenPredictor();
+    }
+}
@@ -0,0 +1,326 @@
+// predictors.h
+// Declares the direction predictors behind the BPred class: a common
+// interface, and one implementation for each branch prediction policy.
+//
+// Every predictor sizes its tables to fit a storage budget given in KB.
+// BPred always calls update() right after predict() for the same branch, so
+// a predictor may keep what it looked up in predict() for use in update().
+
+#ifndef _PREDICTORS_H_
+#define _PREDICTORS_H_
+
+#include "bpred.h"
+#include <inttypes.h>
+#include <vector>
+
+/**
+ * A branch direction predictor.
+ */
+class DirPredictor
+{
+public:
+    virtual ~DirPredictor() {}
+
+    /**
+     * Get a prediction for the branch with the given address.
+     *
+     * @param pc the address (program counter) of the branch to predict
+     * @return the prediction for whether the branch is taken or not taken
+     */
+    virtual BranchDirection predict(uint64_t pc) = 0;
+
+    /**
+     * Train the predictor with the outcome of the branch just predicted.
+     *
+     * @param pc the address (program counter) of the branch
+     * @param resolution the actual outcome of the branch
+     */
+    virtual void update(uint64_t pc, BranchDirection resolution) = 0;
+
+    /**
+     * @return the number of bits of state the predictor keeps
+     */
+    virtual uint64_t storage_bits() const = 0;
+};
+
+/**
+ * Always predicts taken.
+ */
+class AlwaysTakenPredictor : public DirPredictor
+{
+public:
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * A table of 2-bit saturating counters indexed by the branch address.
+ */
+class BimodalPredictor : public DirPredictor
+{
+private:
+    std::vector<uint8_t> pht;
+    uint64_t mask;
+
+public:
+    /**
+     * @param budget_bits the storage budget in bits
+     */
+    BimodalPredictor(uint64_t budget_bits);
+
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * A table of 2-bit saturating counters indexed by the branch address XORed
+ * with the global history. Histories longer than the index are folded onto
+ * it.
+ */
+class GsharePredictor : public DirPredictor
+{
+private:
+    std::vector<uint8_t> pht;
+    unsigned int index_bits;
+    unsigned int hist_len;
+    uint64_t ghr;
+    /** The PHT index looked up by the last prediction. */
+    uint64_t last_index;
+
+    uint64_t index(uint64_t pc) const;
+
+public:
+    /**
+     * @param budget_bits the storage budget in bits
+     * @param hist_len the number of global history bits (at most 64), or 0
+     *                 for as many as there are index bits
+     */
+    GsharePredictor(uint64_t budget_bits, unsigned int hist_len);
+
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * McFarling's combining predictor: a gshare and a bimodal predictor, and a
+ * table of 2-bit counters indexed by the branch address that chooses between
+ * them. The gshare gets half the budget and the others a quarter each.
+ */
+class TournamentPredictor : public DirPredictor
+{
+private:
+    GsharePredictor gshare;
+    BimodalPredictor bimodal;
+    std::vector<uint8_t> chooser;
+    uint64_t mask;
+    BranchDirection last_gshare;
+    BranchDirection last_bimodal;
+
+public:
+    /**
+     * @param budget_bits the storage budget in bits
+     * @param hist_len the number of global history bits of the gshare, or 0
+     *                 for as many as it has index bits
+     */
+    TournamentPredictor(uint64_t budget_bits, unsigned int hist_len);
+
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * Jimenez and Lin's perceptron predictor: a table of perceptrons indexed by
+ * the branch address, each with one signed 8-bit weight per global history
+ * bit plus a bias weight. The branch is predicted taken if the dot product of
+ * the weights and the history (as +1/-1) is not negative.
+ */
+class PerceptronPredictor : public DirPredictor
+{
+private:
+    std::vector<int8_t> weights;
+    unsigned int num_perceptrons;
+    unsigned int hist_len;
+    int threshold;
+    uint64_t ghr;
+    /** The perceptron and output of the last prediction. */
+    unsigned int last_row;
+    int last_output;
+
+public:
+    /**
+     * @param budget_bits the storage budget in bits
+     * @param hist_len the number of global history bits (at most 63), or 0
+     *                 to choose it from the budget
+     */
+    PerceptronPredictor(uint64_t budget_bits, unsigned int hist_len);
+
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * A global history of up to a few thousand branch outcomes, newest first.
+ */
+class GlobalHistory
+{
+private:
+    /** A ring buffer whose size is a power of 2. */
+    std::vector<uint8_t> bits;
+    unsigned int mask;
+    unsigned int head;
+
+public:
+    GlobalHistory(unsigned int max_len);
+
+    /** @return the outcome i branches ago (0 is the newest) */
+    uint8_t operator[](unsigned int i) const
+    {
+        return bits[(head + i) & mask];
+    }
+
+    void push(uint8_t taken);
+};
+
+/**
+ * A global history of orig_len bits folded by XOR down to comp_len bits,
+ * kept up to date incrementally as the history grows.
+ */
+class FoldedHistory
+{
+public:
+    uint32_t comp;
+    unsigned int comp_len;
+    unsigned int orig_len;
+
+    FoldedHistory() : comp(0), comp_len(0), orig_len(0) {}
+    void init(unsigned int orig_len, unsigned int comp_len);
+
+    /**
+     * Fold in a new outcome.
+     *
+     * @param newest the outcome just added to the history
+     * @param oldest the outcome that just left the orig_len newest ones
+     */
+    void update(uint8_t newest, uint8_t oldest)
+    {
+        // Shift in the newest bit, XOR out the one that left the window, and
+        // wrap the bit shifted out of the top back around to the bottom.
+        comp = (comp << 1) | newest;
+        comp ^= (uint32_t)oldest << (orig_len % comp_len);
+        comp ^= comp >> comp_len;
+        comp &= (1u << comp_len) - 1;
+    }
+};
+
+/**
+ * Seznec's TAGE predictor: a bimodal base predictor and several partially
+ * tagged tables indexed with geometrically increasing global history
+ * lengths. The longest matching history provides the prediction.
+ *
+ * With a loop predictor, this is L-TAGE: branches found to iterate a
+ * constant number of times are predicted by counting iterations.
+ */
+class TagePredictor : public DirPredictor
+{
+private:
+    /** An entry of a tagged table. */
+    struct TageEntry
+    {
+        int8_t ctr;     // 3-bit signed counter; taken if >= 0.
+        uint16_t tag;
+        uint8_t u;      // 2-bit usefulness counter.
+    };
+
+    /** An entry of the loop predictor. */
+    struct LoopEntry
+    {
+        bool valid;
+        uint16_t tag;
+        uint16_t past_iter;     // Iterations of the last complete loop.
+        uint16_t curr_iter;     // Iterations so far of the current loop.
+        uint8_t confidence;     // 2-bit; the entry is used once it is 3.
+        uint8_t age;
+        uint8_t dir;            // The direction while the loop continues.
+    };
+
+    unsigned int num_tables;
+    std::vector<uint8_t> base;
+    unsigned int base_bits;
+    std::vector<std::vector<TageEntry> > tables;
+    std::vector<unsigned int> hist_lens;
+    std::vector<unsigned int> tag_bits;
+    unsigned int table_bits;
+
+    GlobalHistory ghist;
+    uint32_t path_hist;
+    std::vector<FoldedHistory> fold_index;
+    std::vector<FoldedHistory> fold_tag0;
+    std::vector<FoldedHistory> fold_tag1;
+
+    /** 4-bit signed counter: whether to trust the alternate prediction
+     *  when the provider entry was just allocated. */
+    int use_alt_on_na;
+    /** Updates since the usefulness counters were last aged. */
+    uint64_t tick;
+    uint32_t rng;
+
+    /** The loop predictor (L-TAGE only), 4-way set associative. */
+    std::vector<LoopEntry> loops;
+    unsigned int loop_set_bits;
+    /** 7-bit signed counter: whether to trust the loop predictor. */
+    int use_loop;
+
+    /** What the last prediction looked up. */
+    std::vector<uint32_t> last_indices;
+    std::vector<uint16_t> last_tags;
+    int provider;
+    int alt_provider;
+    bool provider_pred;
+    bool alt_pred;
+    bool tage_pred;
+    int loop_way;
+    bool loop_valid;
+    bool loop_pred;
+
+    uint32_t index(uint64_t pc, unsigned int t) const;
+    uint16_t tag(uint64_t pc, unsigned int t) const;
+    uint32_t next_random();
+
+    bool loop_lookup(uint64_t pc);
+    void loop_update(uint64_t pc, bool taken);
+
+public:
+    /**
+     * @param budget_bits the storage budget in bits
+     * @param num_tables the number of tagged tables
+     * @param min_hist the history length of the first tagged table
+     * @param max_hist the history length of the last tagged table
+     * @param with_loop whether to add a loop predictor (L-TAGE)
+     */
+    TagePredictor(uint64_t budget_bits, unsigned int num_tables,
+                  unsigned int min_hist, unsigned int max_hist,
+                  bool with_loop);
+
+    BranchDirection predict(uint64_t pc);
+    void update(uint64_t pc, BranchDirection resolution);
+    uint64_t storage_bits() const;
+};
+
+/**
+ * Create the direction predictor of a branch prediction policy.
+ *
+ * @param policy the policy; must not be BPRED_PERFECT
+ * @param size_kb the storage budget in KB, or 0 for the policy's default
+ * @param hist_len the global history length of gshare, tournament, and
+ *                 perceptron predictors, or 0 to choose it from the budget
+ * @return the predictor
+ */
+DirPredictor *make_dir_predictor(BPredPolicy policy, uint32_t size_kb,
+                                 uint32_t hist_len);
+
+#endif
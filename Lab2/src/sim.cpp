@@ -8,6 +8,8 @@
 
 #include "pipeline.h"
 #include "bpred.h"
+#include "memsys.h"
+#include "config.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -57,6 +59,142 @@ uint32_t ENABLE_EXE_FWD = 0;
  */
 BPredPolicy BPRED_POLICY = BPRED_PERFECT;
 
+/**
+ * The storage budget of the branch predictor in KB, or 0 for the default of
+ * its policy.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredsize.
+ */
+uint32_t BPRED_SIZE_KB = 0;
+
+/**
+ * The global history length of the branch predictor, or 0 for the default of
+ * its policy and size.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredhist.
+ */
+uint32_t BPRED_HIST_LEN = 0;
+
+/**
+ * The number of entries in the branch target buffer, or 0 to predict the
+ * targets of taken branches perfectly.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbsize.
+ */
+uint32_t BTB_SIZE = 0;
+
+/**
+ * The associativity of the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbassoc.
+ */
+uint32_t BTB_ASSOC = 4;
+
+/**
+ * The replacement policy of the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbrepl.
+ */
+BTBReplPolicy BTB_REPL = BTB_REPL_LRU;
+
+/**
+ * The number of cycles fetch is redirected for when a taken branch misses in
+ * the branch target buffer.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbpenalty.
+ */
+uint32_t BTB_MISS_PENALTY = 1;
+
+/**
+ * The number of entries in the target cache for indirect branches, or 0 for
+ * none. The traces have only conditional branches, which never use it.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -indirectsize.
+ */
+uint32_t INDIRECT_SIZE = 0;
+
+/**
+ * The number of entries in the fetch queue between the fetch unit and the IF
+ * latch, or 0 for a front end where fetch fills the IF latch directly.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchq.
+ */
+uint32_t FETCH_QUEUE_SIZE = 0;
+
+/**
+ * The maximum number of instructions fetched per cycle, or 0 for the width
+ * of the pipeline.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchwidth.
+ */
+uint32_t FETCH_WIDTH = 0;
+
+/**
+ * The size in bytes of the aligned fetch block that the instructions fetched
+ * in a cycle must lie in, or 0 for no limit.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchbytes.
+ */
+uint32_t FETCH_BYTES = 0;
+
+/**
+ * A Boolean indicating whether a taken branch ends the fetch block, so that
+ * its target is fetched in the next cycle.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fetchbreak.
+ */
+uint32_t FETCH_BREAK_TAKEN = 0;
+
+/**
+ * The functional units of each class, indexed by FUClass.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -fu.
+ */
+FUConfig FU_CONFIG[NUM_FU_CLASSES] = {
+    {0, 1, true}, // FU_ALU
+    {0, 1, true}, // FU_LOAD
+    {0, 1, true}, // FU_STORE
+    {0, 1, true}, // FU_BRANCH
+};
+
+/**
+ * The number of loads and stores that can leave ID per cycle, or 0 for no
+ * limit.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -memports.
+ */
+uint32_t MEM_PORTS = 0;
+
+/**
+ * A Boolean indicating whether loads and stores should access the Lab4
+ * memory system in MA, so that loads take as long as their cache and DRAM
+ * accesses do.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -memsys.
+ */
+uint32_t ENABLE_MEMSYS = 0;
+
+/**
+ * A Boolean indicating whether to print a CPI stack with the statistics.
+ *
+ * It is set by the command-line argument -cpistack.
+ */
+uint32_t PRINT_CPI_STACK = 0;
+
 #define HEARTBEAT_CYCLES 10000
 #define STAT_CYCLES (HEARTBEAT_CYCLES * 50)
 
@@ -122,6 +260,7 @@ int main(int argc, char *argv[])
 int parse_args(int argc, char *argv[], char **trace_filename)
 {
     *trace_filename = NULL;
+    const char *memsys_option = NULL;
 
     if (argc < 2)
     {
@@ -181,9 +320,246 @@ int parse_args(int argc, char *argv[], char **trace_filename)
 
                 BPRED_POLICY = (BPredPolicy)policy;
             }
+            else if (strcmp(argv[i], "-bpredsize") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredsize\n");
+                    return 2;
+                }
+
+                int size_kb = atoi(argv[i]);
+                if (size_kb < 1 || size_kb > 1024)
+                {
+                    fprintf(stderr, "Error: branch predictor size must be between 1 and 1024 KB\n");
+                    return 2;
+                }
+
+                BPRED_SIZE_KB = size_kb;
+            }
+            else if (strcmp(argv[i], "-bpredhist") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredhist\n");
+                    return 2;
+                }
+
+                int hist_len = atoi(argv[i]);
+                if (hist_len < 1 || hist_len > 63)
+                {
+                    fprintf(stderr, "Error: branch history length must be between 1 and 63\n");
+                    return 2;
+                }
+
+                BPRED_HIST_LEN = hist_len;
+            }
+            else if (strcmp(argv[i], "-btbsize") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -btbsize\n");
+                    return 2;
+                }
+
+                int btb_size = atoi(argv[i]);
+                if (btb_size < 0 || (btb_size & (btb_size - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: BTB size must be 0 or a power of 2\n");
+                    return 2;
+                }
+
+                BTB_SIZE = btb_size;
+            }
+            else if (strcmp(argv[i], "-btbassoc") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -btbassoc\n");
+                    return 2;
+                }
+
+                int btb_assoc = atoi(argv[i]);
+                if (btb_assoc < 1 || (btb_assoc & (btb_assoc - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: BTB associativity must be a power of 2\n");
+                    return 2;
+                }
+
+                BTB_ASSOC = btb_assoc;
+            }
+            else if (strcmp(argv[i], "-btbrepl") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -btbrepl\n");
+                    return 2;
+                }
+
+                int repl = atoi(argv[i]);
+                if (repl < 0 || repl >= NUM_BTB_REPL_POLICIES)
+                {
+                    fprintf(stderr, "Error: invalid argument for -btbrepl\n");
+                    return 2;
+                }
+
+                BTB_REPL = (BTBReplPolicy)repl;
+            }
+            else if (strcmp(argv[i], "-btbpenalty") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -btbpenalty\n");
+                    return 2;
+                }
+
+                int penalty = atoi(argv[i]);
+                if (penalty < 0)
+                {
+                    fprintf(stderr, "Error: invalid argument for -btbpenalty\n");
+                    return 2;
+                }
+
+                BTB_MISS_PENALTY = penalty;
+            }
+            else if (strcmp(argv[i], "-indirectsize") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -indirectsize\n");
+                    return 2;
+                }
+
+                int indirect_size = atoi(argv[i]);
+                if (indirect_size < 0 || (indirect_size & (indirect_size - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: target cache size must be 0 or a power of 2\n");
+                    return 2;
+                }
+
+                INDIRECT_SIZE = indirect_size;
+            }
+            else if (strcmp(argv[i], "-fetchq") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -fetchq\n");
+                    return 2;
+                }
+
+                int fetch_queue_size = atoi(argv[i]);
+                if (fetch_queue_size < 0 || fetch_queue_size > 1024)
+                {
+                    fprintf(stderr, "Error: fetch queue size must be between 0 and 1024\n");
+                    return 2;
+                }
+
+                FETCH_QUEUE_SIZE = fetch_queue_size;
+            }
+            else if (strcmp(argv[i], "-fetchwidth") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -fetchwidth\n");
+                    return 2;
+                }
+
+                int fetch_width = atoi(argv[i]);
+                if (fetch_width < 1 || fetch_width > 64)
+                {
+                    fprintf(stderr, "Error: fetch width must be between 1 and 64\n");
+                    return 2;
+                }
+
+                FETCH_WIDTH = fetch_width;
+            }
+            else if (strcmp(argv[i], "-fetchbytes") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -fetchbytes\n");
+                    return 2;
+                }
+
+                int fetch_bytes = atoi(argv[i]);
+                if (fetch_bytes < 1 || (fetch_bytes & (fetch_bytes - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: fetch block size must be a power of 2\n");
+                    return 2;
+                }
+
+                FETCH_BYTES = fetch_bytes;
+            }
+            else if (strcmp(argv[i], "-fetchbreak") == 0)
+            {
+                FETCH_BREAK_TAKEN = 1;
+            }
+            else if (strcmp(argv[i], "-fu") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -fu\n");
+                    return 2;
+                }
+
+                int fu_class = 0;
+                int count = 0;
+                int latency = 1;
+                int pipelined = 1;
+                int n = sscanf(argv[i], "%d,%d,%d,%d", &fu_class, &count, &latency, &pipelined);
+                if (n < 2 || fu_class < 0 || fu_class >= NUM_FU_CLASSES ||
+                    count < 0 || count > MAX_FU_UNITS ||
+                    latency < 1 || latency > 64 || (pipelined != 0 && pipelined != 1))
+                {
+                    fprintf(stderr, "Error: invalid argument for -fu\n");
+                    return 2;
+                }
+
+                FU_CONFIG[fu_class].count = count;
+                FU_CONFIG[fu_class].latency = latency;
+                FU_CONFIG[fu_class].pipelined = pipelined;
+            }
+            else if (strcmp(argv[i], "-memports") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -memports\n");
+                    return 2;
+                }
+
+                int mem_ports = atoi(argv[i]);
+                if (mem_ports < 0 || mem_ports > MAX_PIPE_WIDTH)
+                {
+                    fprintf(stderr, "Error: memory ports must be between 0 and %d\n", MAX_PIPE_WIDTH);
+                    return 2;
+                }
+
+                MEM_PORTS = mem_ports;
+            }
+            else if (strcmp(argv[i], "-cpistack") == 0)
+            {
+                PRINT_CPI_STACK = 1;
+            }
+            else if (strcmp(argv[i], "-memsys") == 0)
+            {
+                ENABLE_MEMSYS = 1;
+            }
             else
             {
-                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                // The options of the Lab4 memory system, which only take
+                // effect with -memsys (which may come after them).
+                int option = i;
+                int status = config_parse_option(argc, argv, &i);
+                if (status == 1)
+                {
+                    fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                    return 2;
+                }
+                else if (status != 0)
+                {
+                    return status;
+                }
+                memsys_option = argv[option];
             }
         }
         else
@@ -205,6 +581,42 @@ int parse_args(int argc, char *argv[], char **trace_filename)
         return 2;
     }
 
+    if (memsys_option != NULL && !ENABLE_MEMSYS)
+    {
+        fprintf(stderr, "Error: %s requires -memsys\n", memsys_option);
+        return 2;
+    }
+
+    if (BTB_SIZE > 0 && BTB_ASSOC > BTB_SIZE)
+    {
+        fprintf(stderr, "Error: BTB associativity must not exceed its size\n");
+        return 2;
+    }
+
+    if (ENABLE_MEMSYS)
+    {
+        // Part A of Lab4 does not simulate timing, so the caches and DRAM of
+        // part C are the default. The memory controller's reads complete in
+        // the background, which the pipeline does not wait for.
+        if (SIM_MODE == SIM_MODE_A)
+        {
+            SIM_MODE = SIM_MODE_C;
+        }
+        if (SIM_MODE == SIM_MODE_DEF)
+        {
+            // The multicore modes need a second trace, but the pipeline
+            // runs one.
+            fprintf(stderr, "Error: -mode 4 is not supported with -memsys\n");
+            return 2;
+        }
+        if (DRAM_SCHED != SCHED_NONE)
+        {
+            fprintf(stderr, "Error: -dram_sched is not supported with -memsys\n");
+            return 2;
+        }
+        NUM_CORES = 1;
+    }
+
     return 0;
 }
 
@@ -308,6 +720,86 @@ void print_stats()
         printf("LAB2_MISPRED_RATE       \t : %10.3f\n", bpred_mispred_rate);
     }
 
+    if (pipeline->btb)
+    {
+        unsigned long stat_btb_lookups = pipeline->btb->stat_num_lookups;
+        unsigned long stat_btb_hits = pipeline->btb->stat_num_hits;
+        double btb_hit_rate = stat_btb_lookups
+            ? 100.0 * (double)stat_btb_hits / (double)stat_btb_lookups : 0.0;
+
+        printf("LAB2_BTB_LOOKUPS        \t : %10lu\n", stat_btb_lookups);
+        printf("LAB2_BTB_HIT_RATE       \t : %10.3f\n", btb_hit_rate);
+        printf("LAB2_BTB_REDIRECTS      \t : %10lu\n",
+               (unsigned long)pipeline->stat_btb_redirects);
+        printf("LAB2_TARGET_MISPRED     \t : %10lu\n",
+               (unsigned long)pipeline->stat_target_mispred);
+    }
+
+    if (pipeline->fetch_queue)
+    {
+        double fq_occupancy_avg = (double)pipeline->stat_fq_occupancy / (double)stat_num_cycle;
+
+        printf("LAB2_FETCHQ_AVG         \t : %10.3f\n", fq_occupancy_avg);
+        printf("LAB2_FETCHQ_FULL_CYCLES \t : %10lu\n",
+               (unsigned long)pipeline->stat_fq_full_cycles);
+    }
+
+    bool fu_limited = MEM_PORTS > 0;
+    for (int fc = 0; fc < NUM_FU_CLASSES; fc++)
+    {
+        if (FU_CONFIG[fc].count || FU_CONFIG[fc].latency > 1 || !FU_CONFIG[fc].pipelined)
+        {
+            fu_limited = true;
+        }
+    }
+    if (fu_limited)
+    {
+        printf("LAB2_STALL_ALU          \t : %10lu\n",
+               (unsigned long)pipeline->stat_fu_stalls[FU_ALU]);
+        printf("LAB2_STALL_LOAD         \t : %10lu\n",
+               (unsigned long)pipeline->stat_fu_stalls[FU_LOAD]);
+        printf("LAB2_STALL_STORE        \t : %10lu\n",
+               (unsigned long)pipeline->stat_fu_stalls[FU_STORE]);
+        printf("LAB2_STALL_BRANCH       \t : %10lu\n",
+               (unsigned long)pipeline->stat_fu_stalls[FU_BRANCH]);
+        printf("LAB2_STALL_MEMPORT      \t : %10lu\n",
+               (unsigned long)pipeline->stat_port_stalls);
+        printf("LAB2_STALL_FU_LATENCY   \t : %10lu\n",
+               (unsigned long)pipeline->stat_latency_stalls);
+    }
+
+    if (PRINT_CPI_STACK)
+    {
+        // Each cycle has PIPE_WIDTH lanes in WB. A retired instruction takes
+        // 1/PIPE_WIDTH of a cycle, and so does each empty lane, charged to the
+        // cause of its bubble; together they add up to the CPI.
+        static const char *cause_names[NUM_BUBBLE_CAUSES] = {
+            "LAB2_CPI_FILL_DRAIN     ",
+            "LAB2_CPI_RAW_REG_FWDOFF ",
+            "LAB2_CPI_RAW_REG_NOPATH ",
+            "LAB2_CPI_RAW_CC_FWDOFF  ",
+            "LAB2_CPI_RAW_CC_NOPATH  ",
+            "LAB2_CPI_STRUCTURAL     ",
+            "LAB2_CPI_BRANCH         ",
+            "LAB2_CPI_FRONTEND       ",
+            "LAB2_CPI_MEMORY         ",
+        };
+        double slots_per_inst = (double)PIPE_WIDTH * (double)stat_num_inst;
+
+        printf("LAB2_CPI_BASE           \t : %10.3f\n",
+               (double)stat_num_inst / slots_per_inst);
+        for (int c = 0; c < NUM_BUBBLE_CAUSES; c++)
+        {
+            printf("%s\t : %10.3f\n", cause_names[c],
+                   (double)pipeline->stat_bubbles[c] / slots_per_inst);
+        }
+    }
+
+    if (pipeline->memsys)
+    {
+        memsys_print_stats(pipeline->memsys);
+    }
+
     printf("\n");
 }
 
@@ -322,5 +814,38 @@ void print_usage(char *program_name)
     fprintf(stderr, "    -enableexefwd       Enable forwarding from Execute (EX) stage (disabled by\n");
     fprintf(stderr, "                        default)\n");
     fprintf(stderr, "    -bpredpolicy <num>  Set branch predictor [0: Perfect, 1: Always Taken,\n");
-    fprintf(stderr, "                        2: Gshare] (Default: 0)\n");
+    fprintf(stderr, "                        2: Gshare, 3: Bimodal, 4: Tournament, 5: Perceptron,\n");
+    fprintf(stderr, "                        6: TAGE, 7: L-TAGE] (Default: 0)\n");
+    fprintf(stderr, "    -bpredsize <KB>     Set branch predictor storage budget (Default: 1 for\n");
+    fprintf(stderr, "                        Gshare and Bimodal, 8 for the others)\n");
+    fprintf(stderr, "    -bpredhist <bits>   Set global history length of Gshare, Tournament, and\n");
+    fprintf(stderr, "                        Perceptron (Default: chosen from the size)\n");
+    fprintf(stderr, "    -btbsize <num>      Set number of BTB entries, a power of 2, or 0 for\n");
+    fprintf(stderr, "                        perfect target prediction (Default: 0)\n");
+    fprintf(stderr, "    -btbassoc <num>     Set BTB associativity (Default: 4)\n");
+    fprintf(stderr, "    -btbrepl <num>      Set BTB replacement policy [0: LRU, 1: FIFO,\n");
+    fprintf(stderr, "                        2: Random] (Default: 0)\n");
+    fprintf(stderr, "    -btbpenalty <num>   Set fetch redirect cycles on a BTB miss (Default: 1)\n");
+    fprintf(stderr, "    -indirectsize <num> Set number of target cache entries for indirect\n");
+    fprintf(stderr, "                        branches, a power of 2, or 0 for none (Default: 0)\n");
+    fprintf(stderr, "    -fetchq <num>       Set number of fetch queue entries, or 0 for fetch\n");
+    fprintf(stderr, "                        straight into the IF latch (Default: 0)\n");
+    fprintf(stderr, "    -fetchwidth <num>   Set instructions fetched per cycle (Default: pipe width)\n");
+    fprintf(stderr, "    -fetchbytes <num>   Set aligned fetch block size in bytes, a power of 2\n");
+    fprintf(stderr, "                        (Default: unlimited)\n");
+    fprintf(stderr, "    -fetchbreak         End the fetch block at a taken branch (disabled by\n");
+    fprintf(stderr, "                        default)\n");
+    fprintf(stderr, "    -fu <class>,<count>[,<latency>[,<pipelined>]]\n");
+    fprintf(stderr, "                        Set functional units of a class [0: ALU, 1: Load,\n");
+    fprintf(stderr, "                        2: Store, 3: Branch]; <count> 0 is one per lane\n");
+    fprintf(stderr, "                        (Default: 0,1,1 for every class)\n");
+    fprintf(stderr, "    -memports <num>     Set loads and stores issued per cycle, or 0 for no\n");
+    fprintf(stderr, "                        limit (Default: 0)\n");
+    fprintf(stderr, "    -cpistack           Print a CPI stack, breaking down the CPI by the\n");
+    fprintf(stderr, "                        causes of stalls (disabled by default)\n");
+    fprintf(stderr, "    -memsys             Time loads and stores with the Lab4 memory system\n");
+    fprintf(stderr, "                        (disabled by default)\n");
+    fprintf(stderr, "\nMemory system options (with -memsys; mode 1 is taken as 3, and mode 4 is\n");
+    fprintf(stderr, "not supported):\n");
+    config_print_usage();
 }
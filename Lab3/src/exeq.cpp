@@ -6,6 +6,7 @@
 // Implements the execution queue.
 
 #include "exeq.h"
+#include "memsys.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -85,6 +86,20 @@ bool exeq_insert(EXEQ *exeq, InstInfo inst)
                 exeq->entries[i].inst.exe_wait_cycles = LOAD_EXE_CYCLES;
             }
 
+            // With the memory system, an LD takes as long as its access,
+            // including the dcache hit latency; an ST updates the caches but
+            // does not wait for them.
+            if (exeq->memsys && inst.op_type == OP_LD)
+            {
+                uint64_t delay = memsys_access(exeq->memsys, inst.mem_addr,
+                                               ACCESS_TYPE_LOAD, 0);
+                exeq->entries[i].inst.exe_wait_cycles = delay > 1 ? (int)delay : 1;
+            }
+            else if (exeq->memsys && inst.op_type == OP_ST)
+            {
+                memsys_access(exeq->memsys, inst.mem_addr, ACCESS_TYPE_STORE, 0);
+            }
+
             return true;
         }
     }
@@ -8,14 +8,20 @@
 #ifndef _EXEQ_H_
 #define _EXEQ_H_
 
+#include "rob.h"
 #include "trace.h"
 #include <inttypes.h>
 
+// The Lab4 memory system, declared in memsys.h.
+struct MemorySystem;
+
 /**
  * The maximum number of instructions that can be in the execution queue at
- * once.
+ * once: as many as the largest ROB holds, since every executing instruction
+ * occupies a ROB entry and loads that miss in the memory system can keep the
+ * whole window waiting.
  */
-#define MAX_EXEQ_ENTRIES 16
+#define MAX_EXEQ_ENTRIES MAX_ROB_ENTRIES
 
 /**
  * The number of cycles an LD instruction should take to execute.
@@ -39,6 +45,12 @@ typedef struct EXEQStruct
 {
     /** An array of execution queue entries. */
     EXEQEntry entries[MAX_EXEQ_ENTRIES];
+
+    /**
+     * The memory system that loads and stores access as they start
+     * executing, or NULL if every LD takes LOAD_EXE_CYCLES.
+     */
+    MemorySystem *memsys;
 } EXEQ;
 
 /**
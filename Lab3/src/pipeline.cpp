@@ -10,6 +10,8 @@
 // Implements the out-of-order pipeline.
 
 #include "pipeline.h"
+#include "memsys.h"
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -55,6 +57,13 @@ extern SchedulingPolicy SCHED_POLICY;
  */
 extern uint32_t LOAD_EXE_CYCLES;
 
+/**
+ * Whether LD and ST instructions should access the Lab4 memory system, so
+ * that an LD takes as long as its cache and DRAM accesses do instead of
+ * LOAD_EXE_CYCLES.
+ */
+extern uint32_t ENABLE_MEMSYS;
+
 /**
  * Read a single trace record from the trace file and use it to populate the
  * given fe_latch.
@@ -134,6 +143,7 @@ void pipe_fetch_inst(Pipeline *p, PipelineLatch *fe_latch)
     inst->src1_ready = false;
     inst->src2_ready = false;
     inst->exe_wait_cycles = 0;
+    inst->mem_addr = trace_rec.mem_addr;
 }
 
 /**
@@ -158,6 +168,11 @@ Pipeline *pipe_init(int trace_fd)
     p->trace_fd = trace_fd;
     p->halt_inst_num = (uint64_t)(-1) - 3;
 
+    if (ENABLE_MEMSYS)
+    {
+        p->exeq->memsys = memsys_new();
+    }
+
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         p->FE_latch[i].valid = false;
@@ -377,7 +392,7 @@ void pipe_cycle_decode(Pipeline *p)
 void pipe_cycle_exe(Pipeline *p)
 {
     // If all operations are single-cycle, just copy SC latches to EX latches.
-    if (LOAD_EXE_CYCLES == 1)
+    if (LOAD_EXE_CYCLES == 1 && !p->exeq->memsys)
     {
         for (unsigned int i = 0; i < PIPE_WIDTH; i++)
         {
@@ -392,7 +407,9 @@ void pipe_cycle_exe(Pipeline *p)
 
     // Otherwise, we need to handle multi-cycle instructions with EXEQ.
 
-    // All valid entries from the SC latches are inserted into the EXEQ.
+    // All valid entries from the SC latches are inserted into the EXEQ,
+    // accessing the memory system at this cycle.
+    current_cycle = p->stat_num_cycle;
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         if (p->SC_latch[i].valid)
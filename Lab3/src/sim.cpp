@@ -7,6 +7,8 @@
 // 4100/6100 & CS 4290/6290.
 
 #include "pipeline.h"
+#include "memsys.h"
+#include "config.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -53,6 +55,16 @@ uint32_t NUM_ROB_ENTRIES = 32;
  */
 uint32_t LOAD_EXE_CYCLES = 4;
 
+/**
+ * Whether LD and ST instructions should access the Lab4 memory system, so
+ * that an LD takes as long as its cache and DRAM accesses do instead of
+ * LOAD_EXE_CYCLES.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -memsys.
+ */
+uint32_t ENABLE_MEMSYS = 0;
+
 /**
  * Whether to use in-order scheduling or out-of-order scheduling.
  * 
@@ -132,6 +144,7 @@ int main(int argc, char *argv[])
 int parse_args(int argc, char *argv[], char **trace_filename)
 {
     *trace_filename = NULL;
+    const char *memsys_option = NULL;
 
     if (argc < 2)
     {
@@ -200,9 +213,26 @@ int parse_args(int argc, char *argv[], char **trace_filename)
 
                 SCHED_POLICY = (SchedulingPolicy)policy;
             }
+            else if (strcmp(argv[i], "-memsys") == 0)
+            {
+                ENABLE_MEMSYS = 1;
+            }
             else
             {
-                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                // The options of the Lab4 memory system, which only take
+                // effect with -memsys (which may come after them).
+                int option = i;
+                int status = config_parse_option(argc, argv, &i);
+                if (status == 1)
+                {
+                    fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                    return 2;
+                }
+                else if (status != 0)
+                {
+                    return status;
+                }
+                memsys_option = argv[option];
             }
         }
         else
@@ -224,6 +254,36 @@ int parse_args(int argc, char *argv[], char **trace_filename)
         return 2;
     }
 
+    if (memsys_option != NULL && !ENABLE_MEMSYS)
+    {
+        fprintf(stderr, "Error: %s requires -memsys\n", memsys_option);
+        return 2;
+    }
+
+    if (ENABLE_MEMSYS)
+    {
+        // Part A of Lab4 does not simulate timing, so the caches and DRAM of
+        // part C are the default. The memory controller's reads complete in
+        // the background, which the EXEQ does not wait for.
+        if (SIM_MODE == SIM_MODE_A)
+        {
+            SIM_MODE = SIM_MODE_C;
+        }
+        if (SIM_MODE == SIM_MODE_DEF)
+        {
+            // The multicore modes need a second trace, but the EXEQ
+            // runs one.
+            fprintf(stderr, "Error: -mode 4 is not supported with -memsys\n");
+            return 2;
+        }
+        if (DRAM_SCHED != SCHED_NONE)
+        {
+            fprintf(stderr, "Error: -dram_sched is not supported with -memsys\n");
+            return 2;
+        }
+        NUM_CORES = 1;
+    }
+
     return 0;
 }
 
@@ -314,6 +374,11 @@ void print_stats()
     printf("LAB3_NUM_INST           \t : %10lu\n", stat_num_inst);
     printf("LAB3_NUM_CYCLES         \t : %10lu\n", stat_num_cycle);
     printf("LAB3_CPI                \t : %10.3f\n", cpi);
+
+    if (pipeline->exeq->memsys)
+    {
+        memsys_print_stats(pipeline->exeq->memsys);
+    }
     printf("\n");
 }
 
@@ -326,4 +391,9 @@ void print_usage(char *program_name)
     fprintf(stderr, "    -schedpolicy <num>  Set scheduling policy [0: in-order, 1: out-of-order]\n");
     fprintf(stderr, "                        (default: 1)\n");
     fprintf(stderr, "    -loadlatency <num>  Set number of cycles for LD to execute (default: 4)\n");
+    fprintf(stderr, "    -memsys             Time LD with the Lab4 memory system instead of\n");
+    fprintf(stderr, "                        -loadlatency (disabled by default)\n");
+    fprintf(stderr, "\nMemory system options (with -memsys; mode 1 is taken as 3, and mode 4 is\n");
+    fprintf(stderr, "not supported):\n");
+    config_print_usage();
 }
@@ -181,6 +181,12 @@ typedef struct InstInfoStruct
      * structure for multi-cycle execution.
      */
     int exe_wait_cycles;
+
+    /**
+     * The memory address this instruction reads or writes, if it is an LD or
+     * ST.
+     */
+    uint64_t mem_addr;
 } InstInfo;
 
 #endif
@@ -25,7 +25,7 @@
  * 
  * This can be used as a timestamp for implementing the LRU replacement policy.
  */
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
 
 /**
  * For static way partitioning, the quota of ways in each set that can be
@@ -35,14 +35,17 @@ extern uint64_t current_cycle;
  * 
  * This is used to implement extra credit part E.
  */
-extern unsigned int SWP_CORE0_WAYS;
+extern thread_local unsigned int SWP_CORE0_WAYS;
+
+/** The state of the random number generator used by random replacement. */
+extern thread_local unsigned int rand_seed;
 
 // New New New New New New New New New
 // New New New New New New New New New
 // Store the hit number
-uint64_t num_Hit_core0 = 0;
-uint64_t num_Hit_core1 = 0;
-long unsigned int num_ways_core0 = 8;
+thread_local uint64_t num_Hit_core0 = 0;
+thread_local uint64_t num_Hit_core1 = 0;
+thread_local long unsigned int num_ways_core0 = 8;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -61,7 +64,8 @@ long unsigned int num_ways_core0 = 8;
  * This is intended to be implemented in part A.
  *
  * @param size The size of the cache in bytes.
- * @param associativity The associativity of the cache.
+ * @param associativity The associativity of the cache, or 0 for a fully
+ *                      associative cache.
  * @param line_size The size of a cache line in bytes.
  * @param replacement_policy The replacement policy of the cache.
  * @return A pointer to the cache.
@@ -76,18 +80,28 @@ Cache *cache_new(uint64_t size, uint64_t associativity, uint64_t line_size,
     Cache *c = (Cache *) calloc(1,sizeof(Cache));
 
     //Allocate related values
+    // An associativity of 0 means fully associative: a single set holding
+    // every line.
     c->num_ways=associativity;
-        //Error Test
-        if(c->num_ways > MAX_WAYS_PER_CACHE_SET)
-        {
-            std::cout<<"Num of ways exceed max numeber"<<MAX_WAYS_PER_CACHE_SET<<std::endl; 
-        }
+    if (c->num_ways == 0)
+    {
+        c->num_ways = size/line_size;
+    }
 
     c->replacementPolicy = replacement_policy;
 
     c->num_sets = size/(line_size*c->num_ways);
+        //Error Test
+        if(c->num_sets == 0)
+        {
+            fprintf(stderr, "Error: a %llu-byte cache can't be %llu-way "
+                            "associative\n", (unsigned long long)size,
+                    (unsigned long long)c->num_ways);
+            exit(1);
+        }
 
-    c->sets = (CacheSet *) calloc (c->num_sets, sizeof(CacheSet));
+    // All lines in one flat array, set by set
+    c->lines = (CacheLine *) calloc (c->num_sets * c->num_ways, sizeof(CacheLine));
     
     c->stat_write_miss = 0;
     c->stat_write_access = 0;
@@ -130,20 +144,22 @@ CacheResult cache_access(Cache *c, uint64_t line_addr, bool is_write,
         // Faster
         // set_index = lineaddr & (c->num_sets-1); 
 
+    CacheLine *set = &c->lines[set_num * c->num_ways];
+
     //For test use
     //std::cout<<"Line_addr"<<line_addr<<"set_num"<<set_num<<"tag"<<tag<<std::endl;
     for ( uint64_t way_num = 0; way_num < c->num_ways; way_num++)
     {   
         // For Hit 
         // Valid true + core id match + tag match
-        if((c->sets[set_num].line[way_num].valid == true)
-            && (c->sets[set_num].line[way_num].core_id == core_id)
-            && (c->sets[set_num].line[way_num].tag == tag)  
+        if((set[way_num].valid == true)
+            && (set[way_num].core_id == core_id)
+            && (set[way_num].tag == tag)  
           )
         {   
             // If Match
             // Update LRU Time  
-            c->sets[set_num].line[way_num].lastAccessTime = current_cycle;
+            set[way_num].lastAccessTime = current_cycle;
             
             // Check read or write
             // IF it is write
@@ -153,7 +169,7 @@ CacheResult cache_access(Cache *c, uint64_t line_addr, bool is_write,
                 c->stat_write_access++;
             
                 // update dirty
-                c->sets[set_num].line[way_num].dirty=true;
+                set[way_num].dirty=true;
 
                 // Install the line
                 //cache_install(c,line_addr,is_write,core_id);                
@@ -165,6 +181,11 @@ CacheResult cache_access(Cache *c, uint64_t line_addr, bool is_write,
                 c->stat_read_access++;  
             }
 
+            if (c->stat_set_access)
+            {
+                c->stat_set_access[set_num]++;
+            }
+
             // For Lab4 
             // New New New New New New New New New
             // New New New New New New New New New
@@ -197,6 +218,12 @@ CacheResult cache_access(Cache *c, uint64_t line_addr, bool is_write,
         c->stat_read_miss++;        
     } 
 
+    if (c->stat_set_access)
+    {
+        c->stat_set_access[set_num]++;
+        c->stat_set_miss[set_num]++;
+    }
+
     return MISS;
 }
 
@@ -226,35 +253,40 @@ void cache_install(Cache *c, uint64_t line_addr, bool is_write,
     // Calculate set index and tag for find() function
     uint64_t set_num = line_addr % c->num_sets;
     uint64_t tag = line_addr / c->num_sets;
+    CacheLine *set = &c->lines[set_num * c->num_ways];
     // Find the cache line id
     unsigned int line_id = cache_find_victim(c, set_num, core_id);
 
     // Then move it to evicted line
-    c->lastEvictedLine = c->sets[set_num].line[line_id];
+    c->lastEvictedLine = set[line_id];
     // Empty the original one
-    c->sets[set_num].line[line_id].valid = false;
-    c->sets[set_num].line[line_id].dirty = false;
+    set[line_id].valid = false;
+    set[line_id].dirty = false;
 
     // Update the cache statistics
     if ((c->lastEvictedLine.valid==true) && (c->lastEvictedLine.dirty==true))
     {
         c->stat_dirty_evicts++;
     }
+    if (c->stat_set_evict && c->lastEvictedLine.valid)
+    {
+        c->stat_set_evict[set_num]++;
+    }
 
     // Initialize the victim line with the line to install
-    c->sets[set_num].line[line_id].valid = true;
-    c->sets[set_num].line[line_id].core_id = core_id;
-    c->sets[set_num].line[line_id].lastAccessTime = current_cycle;
-    c->sets[set_num].line[line_id].tag = tag;
+    set[line_id].valid = true;
+    set[line_id].core_id = core_id;
+    set[line_id].lastAccessTime = current_cycle;
+    set[line_id].tag = tag;
 
     // For write or not
     if (is_write == true)
     {
-        c->sets[set_num].line[line_id].dirty = true;        
+        set[line_id].dirty = true;        
     }
     else
     {
-        c->sets[set_num].line[line_id].dirty = false;
+        set[line_id].dirty = false;
     }
     
     // Update Cache access
@@ -286,8 +318,9 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     // TODO: In part E, for extra credit, implement static way partitioning.
     // TODO: In part F, for extra credit, implement dynamic way partitioning.
 
+    CacheLine *set = &c->lines[(uint64_t)set_index * c->num_ways];
     unsigned int return_id = c->num_ways;
-    uint64_t least_cycle = 0xFFFFFFFF;
+    uint64_t least_cycle = UINT64_MAX;
 
     //Select which policy
     switch (c->replacementPolicy)
@@ -297,11 +330,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
         {
             /* code */
-            if (c->sets[set_index].line[way_num].valid==true)
+            if (set[way_num].valid==true)
             {
-                if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+                if (least_cycle > set[way_num].lastAccessTime)
                 {
-                    least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+                    least_cycle = set[way_num].lastAccessTime;
                     return_id = way_num;
                 }
             }
@@ -318,9 +351,9 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     {
         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
         {
-            if (c->sets[set_index].line[way_num].valid==true)
+            if (set[way_num].valid==true)
             {
-                return_id = (rand() % c->num_ways);
+                return_id = (rand_r(&rand_seed) % c->num_ways);
             }
             else
             {
@@ -337,7 +370,7 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
         {
             /* code */
-            if (c->sets[set_index].line[way_num].valid==false)
+            if (set[way_num].valid==false)
             {
                 return way_num;
             }        
@@ -349,12 +382,12 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         
         for(uint64_t i=0; i<c->num_ways; i++) 
         {
-            if (c->sets[set_index].line[i].core_id == 0) 
+            if (set[i].core_id == 0) 
             {
                 num_core0++;
             }
             else 
-            //if (c->sets[set_index].line[i].core_id == 1 )
+            //if (set[i].core_id == 1 )
             {
                 num_core1++;
             }
@@ -378,11 +411,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         {
             for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
             {
-                if(c->sets[set_index].line[way_num].core_id == 0)
+                if(set[way_num].core_id == 0)
                 {
-                    if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+                    if (least_cycle > set[way_num].lastAccessTime)
                     {
-                        least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+                        least_cycle = set[way_num].lastAccessTime;
                         return_id = way_num;
                     }
                 }
@@ -393,11 +426,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         {
             for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
             {   
-                if(c->sets[set_index].line[way_num].core_id == 1)
+                if(set[way_num].core_id == 1)
                 {
-                    if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+                    if (least_cycle > set[way_num].lastAccessTime)
                     {
-                        least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+                        least_cycle = set[way_num].lastAccessTime;
                         return_id = way_num;
                     }
                 }
@@ -413,7 +446,7 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     //     for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
     //     {
     //         /* code */
-    //         if (c->sets[set_index].line[way_num].valid==false)
+    //         if (set[way_num].valid==false)
     //         {
     //             return way_num;
     //         }        
@@ -425,12 +458,12 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         
     //     for(uint64_t i=0; i<c->num_ways; i++) 
     //     {
-    //         if (c->sets[set_index].line[i].core_id == 0) 
+    //         if (set[i].core_id == 0) 
     //         {
     //             num_core0++;
     //         }
     //         else 
-    //         //if (c->sets[set_index].line[i].core_id == 1 )
+    //         //if (set[i].core_id == 1 )
     //         {
     //             num_core1++;
     //         }
@@ -463,11 +496,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     //     {
     //         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
     //         {
-    //             if(c->sets[set_index].line[way_num].core_id == 0)
+    //             if(set[way_num].core_id == 0)
     //             {
-    //                 if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+    //                 if (least_cycle > set[way_num].lastAccessTime)
     //                 {
-    //                     least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+    //                     least_cycle = set[way_num].lastAccessTime;
     //                     return_id = way_num;
     //                 }
     //             }
@@ -478,11 +511,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     //     {
     //         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
     //         {   
-    //             if(c->sets[set_index].line[way_num].core_id == 1)
+    //             if(set[way_num].core_id == 1)
     //             {
-    //                 if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+    //                 if (least_cycle > set[way_num].lastAccessTime)
     //                 {
-    //                     least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+    //                     least_cycle = set[way_num].lastAccessTime;
     //                     return_id = way_num;
     //                 }
     //             }
@@ -500,7 +533,7 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
         {
             /* code */
-            if (c->sets[set_index].line[way_num].valid==false)
+            if (set[way_num].valid==false)
             {
                 return way_num;
             }        
@@ -512,12 +545,12 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         
         for(uint64_t i=0; i<c->num_ways; i++) 
         {
-            if (c->sets[set_index].line[i].core_id == 0) 
+            if (set[i].core_id == 0) 
             {
                 num_core0++;
             }
             else 
-            //if (c->sets[set_index].line[i].core_id == 1 )
+            //if (set[i].core_id == 1 )
             {
                 num_core1++;
             }
@@ -556,14 +589,14 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         
         // for(uint64_t i=0; i<c->num_ways; i++) 
         // {
-        //     if (c->sets[set_index].line[i].core_id == 0
-        //     && c->sets[set_index].line[i].valid == 1) 
+        //     if (set[i].core_id == 0
+        //     && set[i].valid == 1) 
         //     {
         //         num_core0_using++;
         //     }
         //     else 
-        //     if (c->sets[set_index].line[i].core_id == 1 
-        //     && c->sets[set_index].line[i].valid == 1) 
+        //     if (set[i].core_id == 1 
+        //     && set[i].valid == 1) 
         //     {
         //         num_core1_using++;
         //     }
@@ -601,11 +634,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         {
             for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
             {
-                if(c->sets[set_index].line[way_num].core_id == 0)
+                if(set[way_num].core_id == 0)
                 {
-                    if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+                    if (least_cycle > set[way_num].lastAccessTime)
                     {
-                        least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+                        least_cycle = set[way_num].lastAccessTime;
                         return_id = way_num;
                     }
                 }
@@ -616,11 +649,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
         {
             for (uint64_t way_num = 0; way_num < c->num_ways; way_num++)
             {   
-                if(c->sets[set_index].line[way_num].core_id == 1)
+                if(set[way_num].core_id == 1)
                 {
-                    if (least_cycle > c->sets[set_index].line[way_num].lastAccessTime)
+                    if (least_cycle > set[way_num].lastAccessTime)
                     {
-                        least_cycle = c->sets[set_index].line[way_num].lastAccessTime;
+                        least_cycle = set[way_num].lastAccessTime;
                         return_id = way_num;
                     }
                 }
@@ -638,6 +671,21 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
     return return_id;
 }
 
+/**
+ * Start counting accesses, misses, and evictions per set.
+ *
+ * @param c The cache.
+ */
+void cache_enable_set_stats(Cache *c)
+{
+    c->stat_set_access = (unsigned long long *)calloc(
+        c->num_sets, sizeof(unsigned long long));
+    c->stat_set_miss = (unsigned long long *)calloc(
+        c->num_sets, sizeof(unsigned long long));
+    c->stat_set_evict = (unsigned long long *)calloc(
+        c->num_sets, sizeof(unsigned long long));
+}
+
 /**
  * Print the statistics of the given cache.
  * 
@@ -673,3 +721,17 @@ void cache_print_stats(Cache *c, const char *header)
     printf("%s_WRITE_MISS_PERC \t\t : %10.3f\n", header, write_miss_percent);
     printf("%s_DIRTY_EVICTS    \t\t : %10llu\n", header, c->stat_dirty_evicts);
 }
+
+/**
+ * Free a cache.
+ *
+ * @param c The cache.
+ */
+void cache_free(Cache *c)
+{
+    free(c->lines);
+    free(c->stat_set_access);
+    free(c->stat_set_miss);
+    free(c->stat_set_evict);
+    free(c);
+}
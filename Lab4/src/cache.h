@@ -13,18 +13,6 @@
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
-///////////////////////////////////////////////////////////////////////////////
-//                                 CONSTANTS                                 //
-///////////////////////////////////////////////////////////////////////////////
-
-/**
- * The maximum allowed number of ways in a cache set.
- * 
- * At runtime, the actual number of ways in each cache set is guaranteed to be
- * less than or equal to this value.
- */
-#define MAX_WAYS_PER_CACHE_SET 16
-
 ///////////////////////////////////////////////////////////////////////////////
 //                              DATA STRUCTURES                              //
 ///////////////////////////////////////////////////////////////////////////////
@@ -47,14 +35,6 @@ typedef struct CacheLine
 
 } CacheLine;
 
-typedef struct CacheSet
-{
-    /* */
-    public:
-        CacheLine line[MAX_WAYS_PER_CACHE_SET];
-
-}CacheSet;
-
 
 /** Whether a cache access is a hit or a miss. */
 typedef enum CacheResultEnum
@@ -117,6 +97,14 @@ typedef struct Cache
      */
     unsigned long long stat_dirty_evicts ;
 
+    /**
+     * Per-set access, miss, and eviction counts, indexed by set. These are
+     * NULL unless cache_enable_set_stats() was called.
+     */
+    unsigned long long *stat_set_access;
+    unsigned long long *stat_set_miss;
+    unsigned long long *stat_set_evict;
+
     /**
      * Cache Set Design
      */
@@ -131,9 +119,10 @@ typedef struct Cache
     CacheLine lastEvictedLine;
 
     /**
-     * Set Pointer
+     * Line array, num_sets * num_ways entries: way w of set s is at
+     * lines[s * num_ways + w]
      */
-    CacheSet *sets;
+    CacheLine *lines;
 
 } Cache;
 
@@ -160,7 +149,8 @@ typedef struct Cache
  * This is intended to be implemented in part A.
  *
  * @param size The size of the cache in bytes.
- * @param associativity The associativity of the cache.
+ * @param associativity The associativity of the cache, or 0 for a fully
+ *                      associative cache.
  * @param line_size The size of a cache line in bytes.
  * @param replacement_policy The replacement policy of the cache.
  * @return A pointer to the cache.
@@ -220,6 +210,13 @@ void cache_install(Cache *c, uint64_t line_addr, bool is_write,
 unsigned int cache_find_victim(Cache *c, unsigned int set_index,
                                unsigned int core_id);
 
+/**
+ * Start counting accesses, misses, and evictions per set.
+ *
+ * @param c The cache.
+ */
+void cache_enable_set_stats(Cache *c);
+
 /**
  * Print the statistics of the given cache.
  * 
@@ -231,4 +228,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
  */
 void cache_print_stats(Cache *c, const char *label);
 
+/**
+ * Free a cache.
+ *
+ * @param c The cache.
+ */
+void cache_free(Cache *c);
+
 #endif // __CACHE_H__
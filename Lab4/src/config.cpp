@@ -0,0 +1,983 @@
+// config.cpp
+// Defines the simulator configuration, the per-thread simulation state, and
+// the parsing of configuration options.
+//
+// Every variable here is thread_local, so that each thread of the sweep
+// driver simulates its own independent memory system. A single-threaded run
+// of sim behaves exactly as if they were ordinary globals.
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                              GLOBAL VARIABLES                             //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The current mode under which the simulation is running, corresponding to
+ * which part of the lab is being evaluated.
+ */
+thread_local Mode SIM_MODE = SIM_MODE_A;
+
+/** The number of bytes in a cache line. */
+thread_local uint64_t CACHE_LINESIZE = 64;
+
+/** The replacement policy to use for the L1 data and instruction caches. */
+thread_local ReplacementPolicy REPL_POLICY = LRU;
+
+/** The size of the data cache in bytes. */
+thread_local uint64_t DCACHE_SIZE = 32 * 1024;
+
+/** The associativity of the data cache. */
+thread_local uint64_t DCACHE_ASSOC = 8;
+
+/** The size of the instruction cache in bytes. */
+thread_local uint64_t ICACHE_SIZE = 32 * 1024;
+
+/** The associativity of the instruction cache. */
+thread_local uint64_t ICACHE_ASSOC = 8;
+
+/** The size of the L2 cache in bytes. */
+thread_local uint64_t L2CACHE_SIZE = 1024 * 1024;
+
+/** The associativity of the L2 cache. */
+thread_local uint64_t L2CACHE_ASSOC = 16;
+
+/** The replacement policy to use for the L2 cache. */
+thread_local ReplacementPolicy L2CACHE_REPL = LRU;
+
+/**
+ * For static way partitioning, the quota of ways in each set that can be
+ * assigned to core 0.
+ * 
+ * The remaining number of ways is the quota for core 1.
+ * 
+ * This is used to implement extra credit part E.
+ */
+thread_local unsigned int SWP_CORE0_WAYS = 0;
+
+/** The number of cores being simulated. */
+thread_local unsigned int NUM_CORES = 0;
+
+/** The timing model of the cores. */
+thread_local CoreModel CORE_MODEL = CORE_BLOCKING;
+
+/** For the out-of-order core, the number of instructions in the window. */
+thread_local unsigned int CORE_WINDOW = 128;
+
+/** For the out-of-order core, the number of loads and stores in the window. */
+thread_local unsigned int CORE_LSQ = 48;
+
+/**
+ * For the out-of-order core, the number of load misses that can be
+ * outstanding at once.
+ */
+thread_local unsigned int CORE_MSHRS = 16;
+
+/**
+ * For the out-of-order core, the number of instructions dispatched and
+ * retired per cycle.
+ */
+thread_local unsigned int CORE_WIDTH = 1;
+
+/** Which page policy the DRAM should use. */
+thread_local DRAMPolicy DRAM_PAGE_POLICY = OPEN_PAGE;
+
+/** The idle cycles after which the timer page policies close a row. */
+thread_local uint64_t DRAM_PAGE_TIMER = 200;
+
+/** How the DRAM is refreshed. */
+thread_local DRAMRefresh DRAM_REFRESH = REFRESH_NONE;
+
+/** The number of DRAM channels. */
+thread_local unsigned int DRAM_CHANNELS = 1;
+
+/** The number of ranks per DRAM channel. */
+thread_local unsigned int DRAM_RANKS = 1;
+
+/** The number of bank groups per DRAM rank. */
+thread_local unsigned int DRAM_BANKGROUPS = 1;
+
+/** The number of banks per DRAM bank group. */
+thread_local unsigned int DRAM_BANKS = 16;
+
+/** The DRAM row buffer size, in bytes. */
+thread_local uint64_t DRAM_ROW_BUFFER_SIZE = 1024;
+
+/** How physical addresses map to DRAM locations. */
+thread_local DRAMMapping DRAM_MAPPING = MAP_ROW_BANK_COL;
+
+/** Whether to print per-channel and per-bank DRAM statistics. */
+thread_local bool DRAM_STATS = false;
+
+/**
+ * The request scheduler of the DRAM memory controller, or SCHED_NONE to give
+ * every DRAM access its unloaded latency (modes 3 and 4 only).
+ */
+thread_local DRAMScheduler DRAM_SCHED = SCHED_NONE;
+
+/**
+ * The number of writes queued in a DRAM channel at which the memory
+ * controller starts draining them, and the number at which it stops.
+ */
+thread_local unsigned int DRAM_WQ_HIGH = 32;
+thread_local unsigned int DRAM_WQ_LOW = 16;
+
+/** The DRAM timing preset or timing file name; see dram_timing_load(). */
+thread_local const char *DRAM_TIMING = "LAB";
+
+/** The CPU clock frequency in MHz, used to convert DRAM clocks to cycles. */
+thread_local uint64_t CPU_MHZ = 3200;
+
+/** Whether the reuse-distance and per-PC locality profiler is enabled. */
+thread_local bool PROFILE = false;
+
+/** The number of PCs the profiler reports, ordered by miss contribution. */
+thread_local unsigned int PROFILE_TOPN = 10;
+
+/** The number of distinct lines each reuse-distance tracker remembers. */
+thread_local uint64_t PROFILE_LINES = 64 * 1024;
+
+/** The prefix of the heatmap output files, or NULL if heatmaps are disabled. */
+thread_local const char *HEATMAP_PREFIX = NULL;
+
+/** The number of cycles between heatmap dumps, or 0 to dump only at the end. */
+thread_local uint64_t HEATMAP_INTERVAL = 0;
+
+/** The prefix of the DRAM time-series files, or NULL if disabled. */
+thread_local const char *DRAM_RECORD_PREFIX = NULL;
+
+/** The number of cycles per row of the DRAM time series. */
+thread_local uint64_t DRAM_RECORD_INTERVAL = 10000;
+
+/** Whether to write DRAM command traces along with the time series. */
+thread_local bool DRAM_CMD_TRACE = false;
+
+/** Whether address translation goes through TLBs (mode 4 only). */
+thread_local bool TLB_ENABLE = false;
+
+/** The number of entries in each core's L1 instruction TLB. */
+thread_local uint64_t ITLB_ENTRIES = 64;
+
+/** The associativity of the L1 instruction TLBs. */
+thread_local uint64_t ITLB_ASSOC = 8;
+
+/** The number of entries in each core's L1 data TLB. */
+thread_local uint64_t DTLB_ENTRIES = 64;
+
+/** The associativity of the L1 data TLBs. */
+thread_local uint64_t DTLB_ASSOC = 4;
+
+/** The number of entries in the shared L2 TLB. */
+thread_local uint64_t L2TLB_ENTRIES = 1536;
+
+/** The associativity of the shared L2 TLB. */
+thread_local uint64_t L2TLB_ASSOC = 12;
+
+/** The latency of a page walk in cycles, unless walks go through memory. */
+thread_local uint64_t PAGE_WALK_LATENCY = 30;
+
+/** Whether page walks read the page tables through the L2 cache and DRAM. */
+thread_local bool PAGE_WALK_MEM = false;
+
+/** Whether memory is mapped with 2MB pages instead of 4KB pages. */
+thread_local bool HUGEPAGES = false;
+
+/** How physical frames are allocated to virtual pages (mode 4 only). */
+thread_local PagePolicy PAGE_POLICY = PAGE_FIXED;
+
+/** The amount of physical memory available to the page allocator, in MB. */
+thread_local uint64_t PHYS_MEM_MB = 4096;
+
+/**
+ * The current clock cycle number.
+ * 
+ * This can be used as a timestamp for implementing the LRU replacement policy.
+ */
+thread_local uint64_t current_cycle;
+
+/**
+ * The state of the random number generator used by random replacement. Each
+ * thread starts from the same seed, so results do not depend on how the
+ * threads of a sweep interleave.
+ */
+thread_local unsigned int rand_seed = 42;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Parse the configuration option at argv[*i], consuming its argument if it
+ * has one.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param i The index of the option; advanced past any consumed argument.
+ * @return 0 on success, 1 if the option is not recognized, or 2 if its
+ *         argument is missing or invalid.
+ */
+int config_parse_option(int argc, char **argv, int *i)
+{
+    if (strcasecmp(argv[*i], "-mode") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -mode\n");
+            return 2;
+        }
+
+        int mode = atoi(argv[*i]);
+        if (mode < 1 || mode > 4)
+        {
+            fprintf(stderr, "Error: mode must be between 1 and 4\n");
+            if (mode == 5)
+            {
+                fprintf(stderr, "Note: for part E, use -mode 4 "
+                                "-L2repl 2\n");
+            }
+            if (mode == 6)
+            {
+                fprintf(stderr, "Note: for part F, use -mode 4 "
+                                "-L2repl 3\n");
+            }
+            return 2;
+        }
+
+        SIM_MODE = (Mode)mode;
+    }
+
+    else if (strcasecmp(argv[*i], "-linesize") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -linesize\n");
+            return 2;
+        }
+        CACHE_LINESIZE = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-repl") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -repl\n");
+            return 2;
+        }
+
+        int repl = atoi(argv[*i]);
+        if (repl < 0 || repl > 3)
+        {
+            fprintf(stderr, "Error: repl must be between 0 and 3\n");
+            return 2;
+        }
+
+        REPL_POLICY = (ReplacementPolicy)repl;
+    }
+
+    else if (strcasecmp(argv[*i], "-DsizeKB") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -DsizeKB\n");
+            return 2;
+        }
+        DCACHE_SIZE = atoi(argv[*i]) * 1024;
+    }
+
+    else if (strcasecmp(argv[*i], "-Dassoc") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -Dassoc\n");
+            return 2;
+        }
+        DCACHE_ASSOC = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-L2sizeKB") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -L2sizeKB\n");
+            return 2;
+        }
+        L2CACHE_SIZE = atoi(argv[*i]) * 1024;
+    }
+
+    else if (strcasecmp(argv[*i], "-L2assoc") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -L2assoc\n");
+            return 2;
+        }
+        L2CACHE_ASSOC = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-L2repl") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -L2repl\n");
+            return 2;
+        }
+
+        int l2repl = atoi(argv[*i]);
+        if (l2repl < 0 || l2repl > 3)
+        {
+            fprintf(stderr, "Error: L2repl must be between 0 and 3\n");
+            return 2;
+        }
+
+        L2CACHE_REPL = (ReplacementPolicy)l2repl;
+    }
+
+    else if (strcasecmp(argv[*i], "-SWP_core0ways") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-SWP_core0ways\n");
+            return 2;
+        }
+        SWP_CORE0_WAYS = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-core_model") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -core_model\n");
+            return 2;
+        }
+
+        int model = atoi(argv[*i]);
+        if (model < 0 || model > 1)
+        {
+            fprintf(stderr, "Error: core_model must be 0 or 1\n");
+            return 2;
+        }
+
+        CORE_MODEL = (CoreModel)model;
+    }
+
+    else if (strcasecmp(argv[*i], "-core_window") == 0 ||
+             strcasecmp(argv[*i], "-core_lsq") == 0 ||
+             strcasecmp(argv[*i], "-core_mshrs") == 0 ||
+             strcasecmp(argv[*i], "-core_width") == 0)
+    {
+        const char *name = argv[*i];
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to %s\n", name);
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value <= 0)
+        {
+            fprintf(stderr, "Error: %s must be positive\n", name + 1);
+            return 2;
+        }
+
+        if (strcasecmp(name, "-core_window") == 0)
+        {
+            CORE_WINDOW = value;
+        }
+        else if (strcasecmp(name, "-core_lsq") == 0)
+        {
+            CORE_LSQ = value;
+        }
+        else if (strcasecmp(name, "-core_mshrs") == 0)
+        {
+            CORE_MSHRS = value;
+        }
+        else
+        {
+            CORE_WIDTH = value;
+        }
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_policy") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-dram_policy\n");
+            return 2;
+        }
+
+        int dram_policy = atoi(argv[*i]);
+        if (dram_policy < 0 || dram_policy > 4)
+        {
+            fprintf(stderr, "Error: dram_policy must be between 0 and 4\n");
+            return 2;
+        }
+
+        DRAM_PAGE_POLICY = (DRAMPolicy)dram_policy;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_page_timer") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_page_timer\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_page_timer must be positive\n");
+            return 2;
+        }
+
+        DRAM_PAGE_TIMER = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_refresh") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_refresh\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 0 || value > 2)
+        {
+            fprintf(stderr, "Error: dram_refresh must be between 0 and 2\n");
+            return 2;
+        }
+
+        DRAM_REFRESH = (DRAMRefresh)value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_channels") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_channels\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_channels must be positive\n");
+            return 2;
+        }
+
+        DRAM_CHANNELS = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_ranks") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_ranks\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_ranks must be positive\n");
+            return 2;
+        }
+
+        DRAM_RANKS = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_bankgroups") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_bankgroups\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_bankgroups must be positive\n");
+            return 2;
+        }
+
+        DRAM_BANKGROUPS = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_banks") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_banks\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_banks must be positive\n");
+            return 2;
+        }
+
+        DRAM_BANKS = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_rowbuf") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_rowbuf\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: dram_rowbuf must be positive\n");
+            return 2;
+        }
+
+        DRAM_ROW_BUFFER_SIZE = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_mapping") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_mapping\n");
+            return 2;
+        }
+
+        int mapping = atoi(argv[*i]);
+        if (mapping < 0 || mapping > 2)
+        {
+            fprintf(stderr, "Error: dram_mapping must be between 0 and 2\n");
+            return 2;
+        }
+
+        DRAM_MAPPING = (DRAMMapping)mapping;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_stats") == 0)
+    {
+        DRAM_STATS = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_sched") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_sched\n");
+            return 2;
+        }
+
+        int sched = atoi(argv[*i]);
+        if (sched < 0 || sched > 4)
+        {
+            fprintf(stderr, "Error: dram_sched must be between 0 and 4\n");
+            return 2;
+        }
+
+        DRAM_SCHED = (DRAMScheduler)sched;
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_wq_high") == 0 ||
+             strcasecmp(argv[*i], "-dram_wq_low") == 0)
+    {
+        bool high = strcasecmp(argv[*i], "-dram_wq_high") == 0;
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to %s\n", argv[*i - 1]);
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < (high ? 1 : 0))
+        {
+            fprintf(stderr, "Error: %s must be %s\n", argv[*i - 1] + 1,
+                    high ? "positive" : "non-negative");
+            return 2;
+        }
+
+        if (high)
+        {
+            DRAM_WQ_HIGH = value;
+        }
+        else
+        {
+            DRAM_WQ_LOW = value;
+        }
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_timing") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_timing\n");
+            return 2;
+        }
+
+        DRAMTiming timing;
+        if (!dram_timing_load(argv[*i], &timing))
+        {
+            return 2;
+        }
+
+        DRAM_TIMING = argv[*i];
+    }
+
+    else if (strcasecmp(argv[*i], "-cpu_mhz") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -cpu_mhz\n");
+            return 2;
+        }
+
+        int value = atoi(argv[*i]);
+        if (value < 1)
+        {
+            fprintf(stderr, "Error: cpu_mhz must be positive\n");
+            return 2;
+        }
+
+        CPU_MHZ = value;
+    }
+
+    else if (strcasecmp(argv[*i], "-profile") == 0)
+    {
+        PROFILE = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-profile_topn") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-profile_topn\n");
+            return 2;
+        }
+        PROFILE_TOPN = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-profile_lines") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-profile_lines\n");
+            return 2;
+        }
+
+        int profile_lines = atoi(argv[*i]);
+        if (profile_lines < 1)
+        {
+            fprintf(stderr, "Error: profile_lines must be positive\n");
+            return 2;
+        }
+
+        PROFILE_LINES = profile_lines;
+    }
+
+    else if (strcasecmp(argv[*i], "-heatmap") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -heatmap\n");
+            return 2;
+        }
+        HEATMAP_PREFIX = argv[*i];
+    }
+
+    else if (strcasecmp(argv[*i], "-heatmap_interval") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-heatmap_interval\n");
+            return 2;
+        }
+        HEATMAP_INTERVAL = strtoull(argv[*i], NULL, 10);
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_record") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -dram_record\n");
+            return 2;
+        }
+        DRAM_RECORD_PREFIX = argv[*i];
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_record_interval") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to "
+                            "-dram_record_interval\n");
+            return 2;
+        }
+
+        DRAM_RECORD_INTERVAL = strtoull(argv[*i], NULL, 10);
+        if (DRAM_RECORD_INTERVAL == 0)
+        {
+            fprintf(stderr, "Error: dram_record_interval must be positive\n");
+            return 2;
+        }
+    }
+
+    else if (strcasecmp(argv[*i], "-dram_cmd_trace") == 0)
+    {
+        DRAM_CMD_TRACE = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-tlb") == 0)
+    {
+        TLB_ENABLE = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-ITLBentries") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -ITLBentries\n");
+            return 2;
+        }
+        ITLB_ENTRIES = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-ITLBassoc") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -ITLBassoc\n");
+            return 2;
+        }
+        ITLB_ASSOC = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-DTLBentries") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -DTLBentries\n");
+            return 2;
+        }
+        DTLB_ENTRIES = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-DTLBassoc") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -DTLBassoc\n");
+            return 2;
+        }
+        DTLB_ASSOC = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-L2TLBentries") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -L2TLBentries\n");
+            return 2;
+        }
+        L2TLB_ENTRIES = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-L2TLBassoc") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -L2TLBassoc\n");
+            return 2;
+        }
+        L2TLB_ASSOC = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-walk_latency") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -walk_latency\n");
+            return 2;
+        }
+        PAGE_WALK_LATENCY = atoi(argv[*i]);
+    }
+
+    else if (strcasecmp(argv[*i], "-walk_mem") == 0)
+    {
+        PAGE_WALK_MEM = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-hugepages") == 0)
+    {
+        HUGEPAGES = true;
+    }
+
+    else if (strcasecmp(argv[*i], "-page_policy") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -page_policy\n");
+            return 2;
+        }
+
+        int page_policy = atoi(argv[*i]);
+        if (page_policy < 0 || page_policy > 4)
+        {
+            fprintf(stderr, "Error: page_policy must be between 0 and 4\n");
+            return 2;
+        }
+
+        PAGE_POLICY = (PagePolicy)page_policy;
+    }
+
+    else if (strcasecmp(argv[*i], "-phys_memMB") == 0)
+    {
+        if (++*i >= argc)
+        {
+            fprintf(stderr, "Error: missing argument to -phys_memMB\n");
+            return 2;
+        }
+
+        int phys_mem = atoi(argv[*i]);
+        if (phys_mem < 2)
+        {
+            fprintf(stderr, "Error: phys_memMB must be at least 2\n");
+            return 2;
+        }
+
+        PHYS_MEM_MB = phys_mem;
+    }
+    else
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Print the descriptions of the configuration options.
+ */
+void config_print_usage()
+{
+    fprintf(stderr, "    -mode <num>             Set mode of the simulator "
+                    "[1: part A, 2: part B,\n");
+    fprintf(stderr, "                            3: part C, 4: part D/E/F] "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -linesize <num>         Set cache line size in bytes "
+                    "for all caches\n");
+    fprintf(stderr, "                            (default: 64)\n");
+    fprintf(stderr, "    -repl <num>             Set replacement policy for "
+                    "L1 cache [0: LRU,\n");
+    fprintf(stderr, "                            1: random, 2: SWP, 3: DWP] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -DsizeKB <num>          Set capacity in KB of the L1 "
+                    "dcache (default: 32 KB)\n");
+    fprintf(stderr, "    -Dassoc <num>           Set associativity of the L1 "
+                    "dcache, 0 for fully\n");
+    fprintf(stderr, "                            associative (default: 8)\n");
+    fprintf(stderr, "    -L2sizeKB <num>         Set capacity in KB of the "
+                    "unified L2 cache\n");
+    fprintf(stderr, "                            (default: 512 KB)\n");
+    fprintf(stderr, "    -L2assoc <num>          Set associativity of the L2 "
+                    "cache, 0 for fully\n");
+    fprintf(stderr, "                            associative (default: 16)\n");
+    fprintf(stderr, "    -L2repl <num>           Set replacement policy for "
+                    "L2 cache [0: LRU,\n");
+    fprintf(stderr, "                            1: random, 2: SWP, 3: DWP] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -SWP_core0ways <num>    Set static quota for core 0 "
+                    "in SWP (default: 1)\n");
+    fprintf(stderr, "    -core_model <num>       Set core timing model "
+                    "[0: blocking,\n");
+    fprintf(stderr, "                            1: out-of-order] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -core_window <num>      Set instruction window size "
+                    "of the\n");
+    fprintf(stderr, "                            out-of-order core "
+                    "(default: 128)\n");
+    fprintf(stderr, "    -core_lsq <num>         Set load/store queue size of "
+                    "the\n");
+    fprintf(stderr, "                            out-of-order core "
+                    "(default: 48)\n");
+    fprintf(stderr, "    -core_mshrs <num>       Set outstanding load misses "
+                    "of the\n");
+    fprintf(stderr, "                            out-of-order core "
+                    "(default: 16)\n");
+    fprintf(stderr, "    -core_width <num>       Set dispatch and retire width "
+                    "of the\n");
+    fprintf(stderr, "                            out-of-order core "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -dram_policy <num>      Set DRAM page policy "
+                    "[0: open-page, 1: close-page,\n");
+    fprintf(stderr, "                            2: timer, 3: predictor, "
+                    "4: hybrid] (default: 0)\n");
+    fprintf(stderr, "    -dram_page_timer <num>  Set idle cycles before the "
+                    "timer policies close\n");
+    fprintf(stderr, "                            a row (default: 200)\n");
+    fprintf(stderr, "    -dram_refresh <num>     Set DRAM refresh [0: none, "
+                    "1: all-bank,\n");
+    fprintf(stderr, "                            2: per-bank] (default: 0)\n");
+    fprintf(stderr, "    -dram_channels <num>    Set number of DRAM channels "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -dram_ranks <num>       Set ranks per channel "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -dram_bankgroups <num>  Set bank groups per rank "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -dram_banks <num>       Set banks per bank group "
+                    "(default: 16)\n");
+    fprintf(stderr, "    -dram_rowbuf <num>      Set row buffer size in bytes "
+                    "(default: 1024)\n");
+    fprintf(stderr, "    -dram_mapping <num>     Set DRAM address mapping "
+                    "[0: row:bank:col,\n");
+    fprintf(stderr, "                            1: line interleaved, 2: XOR "
+                    "bank hashing] (default: 0)\n");
+    fprintf(stderr, "    -dram_stats             Print per-channel and "
+                    "per-bank DRAM statistics\n");
+    fprintf(stderr, "    -dram_sched <num>       Set DRAM controller scheduler "
+                    "[0: none, unloaded\n");
+    fprintf(stderr, "                            latencies, 1: FR-FCFS, "
+                    "2: PAR-BS, 3: ATLAS,\n");
+    fprintf(stderr, "                            4: TCM] (default: 0)\n");
+    fprintf(stderr, "    -dram_wq_high <num>     Set writes per channel that "
+                    "start a write drain\n");
+    fprintf(stderr, "                            (default: 32)\n");
+    fprintf(stderr, "    -dram_wq_low <num>      Set writes per channel that "
+                    "end a write drain\n");
+    fprintf(stderr, "                            (default: 16)\n");
+    fprintf(stderr, "    -dram_timing <name>     Set DRAM timing preset [LAB, "
+                    "DDR4, DDR5, LPDDR4]\n");
+    fprintf(stderr, "                            or timing file (default: "
+                    "LAB)\n");
+    fprintf(stderr, "    -cpu_mhz <num>          Set CPU clock for DRAM "
+                    "timings in MHz\n");
+    fprintf(stderr, "                            (default: 3200)\n");
+    fprintf(stderr, "    -dram_record <prefix>   Write DRAM time series to "
+                    "<prefix>_dram.csv\n");
+    fprintf(stderr, "                            and <prefix>_banks.csv\n");
+    fprintf(stderr, "    -dram_record_interval <num>\n");
+    fprintf(stderr, "                            Set cycles per time series "
+                    "row (default: 10000)\n");
+    fprintf(stderr, "    -dram_cmd_trace         Also write DRAM command "
+                    "traces per rank (needs\n");
+    fprintf(stderr, "                            -dram_record and "
+                    "-dram_sched)\n");
+    fprintf(stderr, "    -profile                Record reuse distances and "
+                    "per-PC miss statistics\n");
+    fprintf(stderr, "    -profile_topn <num>     Set number of PCs the "
+                    "profiler reports (default: 10)\n");
+    fprintf(stderr, "    -profile_lines <num>    Set number of lines each "
+                    "reuse-distance tracker\n");
+    fprintf(stderr, "                            remembers (default: 65536)\n");
+}
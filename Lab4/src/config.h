@@ -0,0 +1,229 @@
+// config.h
+// Declares the simulator configuration, the per-thread simulation state, and
+// the functions that parse configuration options.
+
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include "types.h"
+#include "cache.h"
+#include "dram.h"
+#include "memctrl.h"
+#include "pagealloc.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              GLOBAL VARIABLES                             //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The current mode under which the simulation is running, corresponding to
+ * which part of the lab is being evaluated.
+ */
+extern thread_local Mode SIM_MODE;
+
+/** The number of bytes in a cache line. */
+extern thread_local uint64_t CACHE_LINESIZE;
+
+/** The replacement policy to use for the L1 data and instruction caches. */
+extern thread_local ReplacementPolicy REPL_POLICY;
+
+/** The size of the data cache in bytes. */
+extern thread_local uint64_t DCACHE_SIZE;
+
+/** The associativity of the data cache. */
+extern thread_local uint64_t DCACHE_ASSOC;
+
+/** The size of the instruction cache in bytes. */
+extern thread_local uint64_t ICACHE_SIZE;
+
+/** The associativity of the instruction cache. */
+extern thread_local uint64_t ICACHE_ASSOC;
+
+/** The size of the L2 cache in bytes. */
+extern thread_local uint64_t L2CACHE_SIZE;
+
+/** The associativity of the L2 cache. */
+extern thread_local uint64_t L2CACHE_ASSOC;
+
+/** The replacement policy to use for the L2 cache. */
+extern thread_local ReplacementPolicy L2CACHE_REPL;
+
+/**
+ * For static way partitioning, the quota of ways in each set that can be
+ * assigned to core 0.
+ * 
+ * The remaining number of ways is the quota for core 1.
+ * 
+ * This is used to implement extra credit part E.
+ */
+extern thread_local unsigned int SWP_CORE0_WAYS;
+
+/** The number of cores being simulated. */
+extern thread_local unsigned int NUM_CORES;
+
+/** The timing model of the cores. */
+extern thread_local CoreModel CORE_MODEL;
+
+/** For the out-of-order core, the number of instructions in the window. */
+extern thread_local unsigned int CORE_WINDOW;
+
+/** For the out-of-order core, the number of loads and stores in the window. */
+extern thread_local unsigned int CORE_LSQ;
+
+/**
+ * For the out-of-order core, the number of load misses that can be
+ * outstanding at once.
+ */
+extern thread_local unsigned int CORE_MSHRS;
+
+/**
+ * For the out-of-order core, the number of instructions dispatched and
+ * retired per cycle.
+ */
+extern thread_local unsigned int CORE_WIDTH;
+
+/** Which page policy the DRAM should use. */
+extern thread_local DRAMPolicy DRAM_PAGE_POLICY;
+
+/** The idle cycles after which the timer page policies close a row. */
+extern thread_local uint64_t DRAM_PAGE_TIMER;
+
+/** How the DRAM is refreshed. */
+extern thread_local DRAMRefresh DRAM_REFRESH;
+
+/** The number of DRAM channels. */
+extern thread_local unsigned int DRAM_CHANNELS;
+
+/** The number of ranks per DRAM channel. */
+extern thread_local unsigned int DRAM_RANKS;
+
+/** The number of bank groups per DRAM rank. */
+extern thread_local unsigned int DRAM_BANKGROUPS;
+
+/** The number of banks per DRAM bank group. */
+extern thread_local unsigned int DRAM_BANKS;
+
+/** The DRAM row buffer size, in bytes. */
+extern thread_local uint64_t DRAM_ROW_BUFFER_SIZE;
+
+/** How physical addresses map to DRAM locations. */
+extern thread_local DRAMMapping DRAM_MAPPING;
+
+/** Whether to print per-channel and per-bank DRAM statistics. */
+extern thread_local bool DRAM_STATS;
+
+/**
+ * The request scheduler of the DRAM memory controller, or SCHED_NONE to give
+ * every DRAM access its unloaded latency (modes 3 and 4 only).
+ */
+extern thread_local DRAMScheduler DRAM_SCHED;
+
+/**
+ * The number of writes queued in a DRAM channel at which the memory
+ * controller starts draining them, and the number at which it stops.
+ */
+extern thread_local unsigned int DRAM_WQ_HIGH;
+extern thread_local unsigned int DRAM_WQ_LOW;
+
+/** The DRAM timing preset or timing file name; see dram_timing_load(). */
+extern thread_local const char *DRAM_TIMING;
+
+/** The CPU clock frequency in MHz, used to convert DRAM clocks to cycles. */
+extern thread_local uint64_t CPU_MHZ;
+
+/** Whether the reuse-distance and per-PC locality profiler is enabled. */
+extern thread_local bool PROFILE;
+
+/** The number of PCs the profiler reports, ordered by miss contribution. */
+extern thread_local unsigned int PROFILE_TOPN;
+
+/** The number of distinct lines each reuse-distance tracker remembers. */
+extern thread_local uint64_t PROFILE_LINES;
+
+/** The prefix of the heatmap output files, or NULL if heatmaps are disabled. */
+extern thread_local const char *HEATMAP_PREFIX;
+
+/** The number of cycles between heatmap dumps, or 0 to dump only at the end. */
+extern thread_local uint64_t HEATMAP_INTERVAL;
+
+/** The prefix of the DRAM time-series files, or NULL if disabled. */
+extern thread_local const char *DRAM_RECORD_PREFIX;
+
+/** The number of cycles per row of the DRAM time series. */
+extern thread_local uint64_t DRAM_RECORD_INTERVAL;
+
+/** Whether to write DRAM command traces along with the time series. */
+extern thread_local bool DRAM_CMD_TRACE;
+
+/** Whether address translation goes through TLBs (mode 4 only). */
+extern thread_local bool TLB_ENABLE;
+
+/** The number of entries in each core's L1 instruction TLB. */
+extern thread_local uint64_t ITLB_ENTRIES;
+
+/** The associativity of the L1 instruction TLBs. */
+extern thread_local uint64_t ITLB_ASSOC;
+
+/** The number of entries in each core's L1 data TLB. */
+extern thread_local uint64_t DTLB_ENTRIES;
+
+/** The associativity of the L1 data TLBs. */
+extern thread_local uint64_t DTLB_ASSOC;
+
+/** The number of entries in the shared L2 TLB. */
+extern thread_local uint64_t L2TLB_ENTRIES;
+
+/** The associativity of the shared L2 TLB. */
+extern thread_local uint64_t L2TLB_ASSOC;
+
+/** The latency of a page walk in cycles, unless walks go through memory. */
+extern thread_local uint64_t PAGE_WALK_LATENCY;
+
+/** Whether page walks read the page tables through the L2 cache and DRAM. */
+extern thread_local bool PAGE_WALK_MEM;
+
+/** Whether memory is mapped with 2MB pages instead of 4KB pages. */
+extern thread_local bool HUGEPAGES;
+
+/** How physical frames are allocated to virtual pages (mode 4 only). */
+extern thread_local PagePolicy PAGE_POLICY;
+
+/** The amount of physical memory available to the page allocator, in MB. */
+extern thread_local uint64_t PHYS_MEM_MB;
+
+/**
+ * The current clock cycle number.
+ * 
+ * This can be used as a timestamp for implementing the LRU replacement policy.
+ */
+extern thread_local uint64_t current_cycle;
+
+/**
+ * The state of the random number generator used by random replacement. Each
+ * thread starts from the same seed, so results do not depend on how the
+ * threads of a sweep interleave.
+ */
+extern thread_local unsigned int rand_seed;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Parse the configuration option at argv[*i], consuming its argument if it
+ * has one.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param i The index of the option; advanced past any consumed argument.
+ * @return 0 on success, 1 if the option is not recognized, or 2 if its
+ *         argument is missing or invalid.
+ */
+int config_parse_option(int argc, char **argv, int *i);
+
+/**
+ * Print the descriptions of the configuration options.
+ */
+void config_print_usage();
+
+#endif // __CONFIG_H__
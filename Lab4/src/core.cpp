@@ -11,11 +11,20 @@
 #include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
 
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
+extern thread_local CoreModel CORE_MODEL;
+extern thread_local unsigned int CORE_WINDOW;
+extern thread_local unsigned int CORE_LSQ;
+extern thread_local unsigned int CORE_MSHRS;
+extern thread_local unsigned int CORE_WIDTH;
 
 int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
 ssize_t trace_read(Core *core, void *buf, size_t size);
+void core_cycle_ooo(Core *core);
+bool core_can_dispatch(Core *core);
+bool core_mshrs_full(Core *core, uint64_t *next_free);
 
 Core *core_new(MemorySystem *memsys, const char *trace_filename,
                unsigned int core_id)
@@ -34,11 +43,76 @@ Core *core_new(MemorySystem *memsys, const char *trace_filename,
     core->pid = pid;
     core->read_buf_offset = 0;
     core->read_buf_left = 0;
+    if (CORE_MODEL == CORE_OOO)
+    {
+        core->window = (WindowEntry *)calloc(CORE_WINDOW, sizeof(WindowEntry));
+    }
+
+    core_read_trace(core);
+    return core;
+}
+
+Core *core_new_from_buffer(MemorySystem *memsys, const uint8_t *trace_buf,
+                           size_t trace_buf_size, unsigned int core_id)
+{
+    Core *core = (Core *)calloc(1, sizeof(Core));
+    core->core_id = core_id;
+    core->memsys = memsys;
+    core->trace_fd = -1;
+    core->trace_buf = trace_buf;
+    core->trace_buf_size = trace_buf_size;
+    core->trace_buf_pos = 0;
+    if (CORE_MODEL == CORE_OOO)
+    {
+        core->window = (WindowEntry *)calloc(CORE_WINDOW, sizeof(WindowEntry));
+    }
 
     core_read_trace(core);
     return core;
 }
 
+uint8_t *trace_load(const char *trace_filename, size_t *size)
+{
+    int trace_fd;
+    pid_t pid;
+    if (open_gunzip_pipe(trace_filename, &trace_fd, &pid) != 0)
+    {
+        return NULL;
+    }
+
+    size_t capacity = 1024 * 1024;
+    uint8_t *buf = (uint8_t *)malloc(capacity);
+    *size = 0;
+
+    // Decode the whole trace, doubling the buffer as needed.
+    while (true)
+    {
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            buf = (uint8_t *)realloc(buf, capacity);
+        }
+
+        ssize_t bytes_read = read(trace_fd, buf + *size, capacity - *size);
+        if (bytes_read < 0)
+        {
+            perror("Couldn't read from trace file");
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        if (bytes_read == 0)
+        {
+            break;
+        }
+        *size += bytes_read;
+    }
+
+    close(trace_fd);
+    waitpid(pid, NULL, 0);
+    return buf;
+}
+
 void core_cycle(Core *core)
 {
     if (core->done)
@@ -46,6 +120,28 @@ void core_cycle(Core *core)
         return;
     }
 
+    if (core->window)
+    {
+        core_cycle_ooo(core);
+        return;
+    }
+
+    // If the memory controller still has our reads, wait for the last one
+    // and snooze until the cycle before its data arrived.
+    if (core->waiting)
+    {
+        if (core->wait.pending)
+        {
+            return;
+        }
+
+        core->waiting = false;
+        if (core->wait.ready_cycle > core->snooze_end_cycle + 1)
+        {
+            core->snooze_end_cycle = core->wait.ready_cycle - 1;
+        }
+    }
+
     // If core is snoozing on DRAM hits, return.
     if (current_cycle <= core->snooze_end_cycle)
     {
@@ -58,8 +154,19 @@ void core_cycle(Core *core)
     uint64_t ld_delay = 0;
     uint64_t bubble_cycles = 0;
 
-    ifetch_delay = memsys_access(core->memsys, core->trace_inst_addr,
-                                 ACCESS_TYPE_IFETCH, core->core_id);
+    // Without a controller, the delays below include the DRAM latency.
+    MemWait *wait = NULL;
+    if (core->memsys->memctrl)
+    {
+        core->wait.pending = 0;
+        core->wait.ready_cycle = 0;
+        wait = &core->wait;
+    }
+
+    core->memsys->access_pc = core->trace_inst_addr;
+    ifetch_delay = memsys_access_async(core->memsys, core->trace_inst_addr,
+                                       ACCESS_TYPE_IFETCH, core->core_id,
+                                       wait);
     if (ifetch_delay > 1)
     {
         bubble_cycles += (ifetch_delay - 1);
@@ -67,8 +174,8 @@ void core_cycle(Core *core)
 
     if (core->trace_inst_type == INST_TYPE_LOAD)
     {
-        ld_delay = memsys_access(core->memsys, core->trace_ldst_addr,
-                                 ACCESS_TYPE_LOAD, core->core_id);
+        ld_delay = memsys_access_async(core->memsys, core->trace_ldst_addr,
+                                       ACCESS_TYPE_LOAD, core->core_id, wait);
     }
     if (ld_delay > 1)
     {
@@ -87,9 +194,295 @@ void core_cycle(Core *core)
         core->snooze_end_cycle = current_cycle + bubble_cycles;
     }
 
+    if (wait && wait->pending)
+    {
+        core->waiting = true;
+    }
+
     core_read_trace(core);
 }
 
+// Out-of-order model: retire up to CORE_WIDTH finished instructions from the
+// head of the window, then dispatch up to CORE_WIDTH new ones. Loads access
+// memory at dispatch, so their misses overlap up to the number of MSHRs, and
+// only hold up the core once they reach the head of the window or it fills
+// up. Instruction fetches still stall dispatch as in the blocking model.
+void core_cycle_ooo(Core *core)
+{
+    for (unsigned int n = 0; n < CORE_WIDTH && core->window_count; n++)
+    {
+        WindowEntry *entry = &core->window[core->window_head];
+        if (entry->waiting)
+        {
+            if (entry->wait.pending)
+            {
+                break;
+            }
+
+            entry->waiting = false;
+            if (entry->wait.ready_cycle > entry->ready_cycle)
+            {
+                entry->ready_cycle = entry->wait.ready_cycle;
+            }
+        }
+        if (current_cycle < entry->ready_cycle)
+        {
+            break;
+        }
+
+        if (entry->is_mem)
+        {
+            core->lsq_count--;
+        }
+        if (entry->is_miss)
+        {
+            core->miss_count--;
+        }
+        core->window_head = (core->window_head + 1) % CORE_WINDOW;
+        core->window_count--;
+    }
+
+    if (core->trace_done)
+    {
+        if (!core->window_count)
+        {
+            core->done = true;
+            core->done_inst_count = core->inst_count;
+            core->done_cycle_count = current_cycle;
+        }
+        return;
+    }
+
+    // If the memory controller still has our instruction fetch, wait for it.
+    if (core->waiting)
+    {
+        if (core->wait.pending)
+        {
+            return;
+        }
+
+        core->waiting = false;
+        if (core->wait.ready_cycle > core->snooze_end_cycle + 1)
+        {
+            core->snooze_end_cycle = core->wait.ready_cycle - 1;
+        }
+    }
+
+    // If the front end is snoozing on an instruction fetch, return.
+    if (current_cycle <= core->snooze_end_cycle)
+    {
+        return;
+    }
+
+    for (unsigned int n = 0; n < CORE_WIDTH; n++)
+    {
+        if (!core_can_dispatch(core))
+        {
+            break;
+        }
+        if (core->window_full)
+        {
+            core->window_full = false;
+            core->stat_window_full += current_cycle - core->window_full_start;
+        }
+
+        core->inst_count++;
+
+        unsigned int tail = (core->window_head + core->window_count) %
+                            CORE_WINDOW;
+        WindowEntry *entry = &core->window[tail];
+        entry->ready_cycle = current_cycle + 1;
+        entry->is_mem = core->trace_inst_type == INST_TYPE_LOAD ||
+                        core->trace_inst_type == INST_TYPE_STORE;
+        entry->is_miss = false;
+        entry->waiting = false;
+        core->window_count++;
+        if (entry->is_mem)
+        {
+            core->lsq_count++;
+        }
+
+        MemWait *fetch_wait = NULL;
+        MemWait *ld_wait = NULL;
+        if (core->memsys->memctrl)
+        {
+            core->wait.pending = 0;
+            core->wait.ready_cycle = 0;
+            fetch_wait = &core->wait;
+            entry->wait.pending = 0;
+            entry->wait.ready_cycle = 0;
+            ld_wait = &entry->wait;
+        }
+
+        core->memsys->access_pc = core->trace_inst_addr;
+        uint64_t ifetch_delay = memsys_access_async(
+            core->memsys, core->trace_inst_addr, ACCESS_TYPE_IFETCH,
+            core->core_id, fetch_wait);
+
+        if (core->trace_inst_type == INST_TYPE_LOAD)
+        {
+            uint64_t ld_delay = memsys_access_async(
+                core->memsys, core->trace_ldst_addr, ACCESS_TYPE_LOAD,
+                core->core_id, ld_wait);
+            if (ld_delay > 1)
+            {
+                entry->ready_cycle = current_cycle + ld_delay;
+            }
+            entry->waiting = ld_wait && ld_wait->pending;
+            entry->is_miss = ld_delay > 1 || entry->waiting;
+            if (entry->is_miss)
+            {
+                core->miss_count++;
+            }
+        }
+
+        if (core->trace_inst_type == INST_TYPE_STORE)
+        {
+            memsys_access(core->memsys, core->trace_ldst_addr,
+                          ACCESS_TYPE_STORE, core->core_id);
+        }
+        // Stores retire without waiting for memory.
+
+        core_read_trace(core);
+
+        // The next instruction can't be dispatched before it is fetched.
+        if (fetch_wait && fetch_wait->pending)
+        {
+            core->waiting = true;
+            break;
+        }
+        if (ifetch_delay > 1)
+        {
+            core->snooze_end_cycle = current_cycle + ifetch_delay - 1;
+            break;
+        }
+        if (core->trace_done)
+        {
+            break;
+        }
+    }
+
+    // Dispatch is held up from the next cycle until an instruction retires.
+    if (!core->trace_done && !core->window_full && !core_can_dispatch(core))
+    {
+        core->window_full = true;
+        core->window_full_start = current_cycle + 1;
+    }
+}
+
+// Return whether the out-of-order core has room in its window, load/store
+// queue, and MSHRs for the next instruction of the trace.
+bool core_can_dispatch(Core *core)
+{
+    if (core->window_count >= CORE_WINDOW)
+    {
+        return false;
+    }
+
+    bool is_mem = core->trace_inst_type == INST_TYPE_LOAD ||
+                  core->trace_inst_type == INST_TYPE_STORE;
+    if (is_mem && core->lsq_count >= CORE_LSQ)
+    {
+        return false;
+    }
+    return !core_mshrs_full(core, NULL);
+}
+
+// Return whether the next instruction of the trace is a load that must wait
+// for an MSHR, and if so, set *next_free (unless NULL) to the cycle the first
+// MSHR frees up. A miss still with the memory controller is checked every
+// cycle, since it can't know when its reads will return.
+bool core_mshrs_full(Core *core, uint64_t *next_free)
+{
+    // Misses whose data has arrived free their MSHRs before they retire, so
+    // the window is only searched once it holds enough misses to fill them.
+    if (core->trace_inst_type != INST_TYPE_LOAD ||
+        core->miss_count < CORE_MSHRS)
+    {
+        return false;
+    }
+
+    unsigned int outstanding = 0;
+    uint64_t first_free = UINT64_MAX;
+    for (unsigned int n = 0; n < core->window_count; n++)
+    {
+        WindowEntry *entry = &core->window[(core->window_head + n) %
+                                           CORE_WINDOW];
+        if (!entry->is_miss)
+        {
+            continue;
+        }
+
+        uint64_t done = entry->ready_cycle;
+        if (entry->waiting && entry->wait.pending)
+        {
+            done = current_cycle + 1;
+        }
+        else if (entry->waiting && entry->wait.ready_cycle > done)
+        {
+            done = entry->wait.ready_cycle;
+        }
+        if (done > current_cycle)
+        {
+            outstanding++;
+            first_free = std::min(first_free, done);
+        }
+    }
+
+    if (next_free)
+    {
+        *next_free = first_free;
+    }
+    return outstanding >= CORE_MSHRS;
+}
+
+// Return the next cycle after the current one in which core_cycle() may do
+// anything, or UINT64_MAX once the core is done. A core stalled on the
+// memory controller is checked every cycle, since it can't know when its
+// reads will return.
+uint64_t core_next_cycle(Core *core)
+{
+    if (core->done)
+    {
+        return UINT64_MAX;
+    }
+    if (!core->window)
+    {
+        if (core->waiting || current_cycle >= core->snooze_end_cycle)
+        {
+            return current_cycle + 1;
+        }
+        return core->snooze_end_cycle + 1;
+    }
+
+    // The out-of-order core wakes up for its next retirement or dispatch.
+    uint64_t next = UINT64_MAX;
+    if (core->window_count)
+    {
+        WindowEntry *head = &core->window[core->window_head];
+        next = head->waiting ? current_cycle + 1 : head->ready_cycle;
+    }
+    if (!core->trace_done && core_can_dispatch(core))
+    {
+        uint64_t fetch = core->waiting ? current_cycle + 1
+                                       : core->snooze_end_cycle + 1;
+        if (fetch < next)
+        {
+            next = fetch;
+        }
+    }
+
+    // A load waiting for an MSHR may dispatch once one frees up.
+    uint64_t mshr_free;
+    if (!core->trace_done && core_mshrs_full(core, &mshr_free) &&
+        mshr_free < next)
+    {
+        next = mshr_free;
+    }
+
+    return next > current_cycle ? next : current_cycle + 1;
+}
+
 void core_read_trace(Core *core)
 {
     uint32_t inst_addr;
@@ -103,9 +496,13 @@ void core_read_trace(Core *core)
         trace_read(core, &ldst_addr, sizeof(ldst_addr)) !=
             sizeof(ldst_addr))
     {
-        core->done = true;
-        core->done_inst_count = core->inst_count;
-        core->done_cycle_count = current_cycle;
+        core->trace_done = true;
+        if (!core->window_count)
+        {
+            core->done = true;
+            core->done_inst_count = core->inst_count;
+            core->done_cycle_count = current_cycle;
+        }
     }
 
     core->trace_inst_addr = inst_addr;
@@ -129,8 +526,31 @@ void core_print_stats(Core *core)
            core->done_cycle_count);
     printf("CORE_%01d_IPC          \t\t : %10.3f\n", core->core_id, ipc);
 
-    close(core->trace_fd);
-    waitpid(core->pid, NULL, 0);
+    if (core->window)
+    {
+        printf("CORE_%01d_WINDOW_FULL  \t\t : %10llu\n", core->core_id,
+               core->stat_window_full);
+    }
+
+    MemController *mc = core->memsys->memctrl;
+    if (mc && mc->num_cores > 1)
+    {
+        printf("CORE_%01d_SLOWDOWN     \t\t : %10.3f\n", core->core_id,
+               memctrl_core_slowdown(mc, core->core_id,
+                                     core->done_cycle_count));
+    }
+
+    if (!core->trace_buf)
+    {
+        close(core->trace_fd);
+        waitpid(core->pid, NULL, 0);
+    }
+}
+
+void core_free(Core *core)
+{
+    free(core->window);
+    free(core);
 }
 
 int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
@@ -178,6 +598,19 @@ ssize_t trace_read(Core *core, void *buf, size_t size)
     size_t bytes_read_total = 0;
     size_t bytes_left = size;
 
+    if (core->trace_buf)
+    {
+        // The trace is already in memory.
+        size_t buf_left = core->trace_buf_size - core->trace_buf_pos;
+        if (bytes_left > buf_left)
+        {
+            bytes_left = buf_left;
+        }
+        memcpy(bytes, core->trace_buf + core->trace_buf_pos, bytes_left);
+        core->trace_buf_pos += bytes_left;
+        return bytes_left;
+    }
+
     // Read a total of size bytes from the file descriptor.
     while (bytes_left > 0)
     {
@@ -12,6 +12,30 @@
 #include "memsys.h"
 #include <sys/types.h>
 
+// An instruction in the window of the out-of-order core.
+//
+// The .mtr traces carry no register dependences, so every load is treated as
+// independent of the loads before it; only the window, the load/store queue,
+// and the MSHRs limit how many misses overlap. A load that takes longer than
+// an L1 hit holds one of CORE_MSHRS MSHRs until its data arrives, and while
+// they are all taken the next load waits to dispatch. Stores take no MSHR,
+// and misses to the same line are not merged.
+typedef struct WindowEntry
+{
+    // The cycle from which it may retire.
+    uint64_t ready_cycle;
+    // Whether it holds a load/store queue entry.
+    bool is_mem;
+    // Whether it is a load that missed in the L1 and holds an MSHR until its
+    // data arrives.
+    bool is_miss;
+
+    // With a memory controller, the DRAM reads of a load, and whether it is
+    // still waiting on them.
+    MemWait wait;
+    bool waiting;
+} WindowEntry;
+
 typedef struct Core
 {
     unsigned int core_id;
@@ -24,6 +48,12 @@ typedef struct Core
     size_t read_buf_offset;
     ssize_t read_buf_left;
 
+    // Set if the trace was decoded into memory beforehand (see trace_load).
+    // The buffer is shared and is not freed by the core.
+    const uint8_t *trace_buf;
+    size_t trace_buf_size;
+    size_t trace_buf_pos;
+
     bool done;
 
     uint64_t trace_inst_addr;
@@ -33,6 +63,31 @@ typedef struct Core
     // Used to stall when waiting for data to return from memory.
     uint64_t snooze_end_cycle;
 
+    // With a memory controller, the DRAM reads of the current instruction,
+    // and whether the core is still stalled on them.
+    MemWait wait;
+    bool waiting;
+
+    // For the out-of-order model, the instruction window as a ring buffer of
+    // CORE_WINDOW entries (NULL for the blocking model), and the number of
+    // its entries that are loads or stores, and of those, the loads that
+    // missed in the L1 (whether or not their data has arrived).
+    WindowEntry *window;
+    unsigned int window_head;
+    unsigned int window_count;
+    unsigned int lsq_count;
+    unsigned int miss_count;
+
+    // Set once the last instruction of the trace has been read; the core is
+    // done when it has also left the window.
+    bool trace_done;
+
+    // The cycles dispatch was held up by a full window, load/store queue, or
+    // set of MSHRs, and since when it is, if it is now.
+    unsigned long long stat_window_full;
+    bool window_full;
+    uint64_t window_full_start;
+
     unsigned long long inst_count;
     unsigned long long done_inst_count;
     unsigned long long done_cycle_count;
@@ -40,8 +95,13 @@ typedef struct Core
 
 Core *core_new(MemorySystem *memsys, const char *trace_filename,
                unsigned int core_id);
+Core *core_new_from_buffer(MemorySystem *memsys, const uint8_t *trace_buf,
+                           size_t trace_buf_size, unsigned int core_id);
+uint8_t *trace_load(const char *trace_filename, size_t *size);
 void core_cycle(Core *core);
+uint64_t core_next_cycle(Core *core);
 void core_print_stats(Core *core);
+void core_free(Core *core);
 void core_read_trace(Core *core);
 
 #endif // __CORE_H__
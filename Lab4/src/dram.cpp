@@ -6,8 +6,11 @@
 // Defines the functions used to implement DRAM.
 
 #include "dram.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
@@ -18,29 +21,69 @@
 /** The fixed latency of a DRAM access assumed in part B, in cycles. */
 #define DELAY_SIM_MODE_B 100
 
-/** The DRAM activation latency (ACT), in cycles. (Also known as RAS.) */
-#define DELAY_ACT 45
+/** The longest line read from a DRAM timing file. */
+#define DRAM_TIMING_LINE_MAX 256
 
-/** The DRAM column selection latency (CAS), in cycles. */
-#define DELAY_CAS 45
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
 
-/** The DRAM precharge latency (PRE), in cycles. */
-#define DELAY_PRE 45
+/** A named set of timing constraints. */
+typedef struct DRAMTimingPreset
+{
+    const char *name;
+    DRAMTiming timing;
+} DRAMTimingPreset;
 
 /**
- * The DRAM bus latency, in cycles.
- * 
- * This is how long it takes for the DRAM to transmit the data via the bus. It
- * is incurred on every DRAM access. (In part B, assume that this is included
- * in the fixed DRAM latency DELAY_SIM_MODE_B.)
+ * The timing presets, in the field order of DRAMTiming:
+ * tCK_ps, tRCD, tRP, tCL, tCWL, tBURST, tRAS, tRC, tWR, tWTR, tRTP, tRTW,
+ * tRRD_S, tRRD_L, tFAW, tCCD_S, tCCD_L, tREFI, tRFC, tRFCpb.
+ *
+ * LAB is the original model, in CPU cycles, with the refresh timing of an 8Gb
+ * DDR4 device at 3.2 GHz (7.8 us, 350 ns, and 130 ns). The others are speed bins from
+ * the JEDEC standards for 8Gb (DDR4, LPDDR4) and 16Gb (DDR5) x8 devices:
+ * DDR4-3200AA, DDR5-4800B, and LPDDR4-3200.
  */
-#define DELAY_BUS 10
-
-/** The row buffer size, in bytes. */
-#define ROW_BUFFER_SIZE 1024
-
-/** The number of banks in the DRAM module. */
-#define NUM_BANKS 16
+static const DRAMTimingPreset dram_timing_presets[] = {
+    {"LAB", {0, DELAY_ACT, DELAY_PRE, DELAY_CAS, DELAY_CAS, DELAY_BUS,
+             DELAY_ACT, DELAY_ACT + DELAY_PRE, 0, 0, DELAY_CAS + DELAY_BUS,
+             0, 0, 0, 0, 0, 0, 24960, 1120, 416}},
+    {"DDR4", {625, 22, 22, 22, 16, 4, 52, 74, 24, 12, 12, 12, 4, 8, 34, 4, 8,
+              12480, 560, 0}},
+    {"DDR5", {416, 39, 39, 40, 38, 8, 77, 116, 72, 24, 18, 12, 8, 12, 32, 8,
+              12, 9375, 709, 313}},
+    {"LPDDR4", {625, 29, 34, 28, 14, 8, 68, 102, 29, 16, 12, 24, 16, 16, 64,
+                8, 8, 6248, 448, 224}},
+};
+
+/** The name of each constraint in a timing file. */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} dram_timing_fields[] = {
+    {"tCK_ps", offsetof(DRAMTiming, tCK_ps)},
+    {"tRCD", offsetof(DRAMTiming, tRCD)},
+    {"tRP", offsetof(DRAMTiming, tRP)},
+    {"tCL", offsetof(DRAMTiming, tCL)},
+    {"tCWL", offsetof(DRAMTiming, tCWL)},
+    {"tBURST", offsetof(DRAMTiming, tBURST)},
+    {"tRAS", offsetof(DRAMTiming, tRAS)},
+    {"tRC", offsetof(DRAMTiming, tRC)},
+    {"tWR", offsetof(DRAMTiming, tWR)},
+    {"tWTR", offsetof(DRAMTiming, tWTR)},
+    {"tRTP", offsetof(DRAMTiming, tRTP)},
+    {"tRTW", offsetof(DRAMTiming, tRTW)},
+    {"tRRD_S", offsetof(DRAMTiming, tRRD_S)},
+    {"tRRD_L", offsetof(DRAMTiming, tRRD_L)},
+    {"tFAW", offsetof(DRAMTiming, tFAW)},
+    {"tCCD_S", offsetof(DRAMTiming, tCCD_S)},
+    {"tCCD_L", offsetof(DRAMTiming, tCCD_L)},
+    {"tREFI", offsetof(DRAMTiming, tREFI)},
+    {"tRFC", offsetof(DRAMTiming, tRFC)},
+    {"tRFCpb", offsetof(DRAMTiming, tRFCpb)},
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 //                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
@@ -50,13 +93,131 @@
  * The current mode under which the simulation is running, corresponding to
  * which part of the lab is being evaluated.
  */
-extern Mode SIM_MODE;
+extern thread_local Mode SIM_MODE;
 
 /** The number of bytes in a cache line. */
-extern uint64_t CACHE_LINESIZE;
+extern thread_local uint64_t CACHE_LINESIZE;
 
 /** Which page policy the DRAM should use. */
-extern DRAMPolicy DRAM_PAGE_POLICY;
+extern thread_local DRAMPolicy DRAM_PAGE_POLICY;
+
+/** The idle cycles after which the timer page policies close a row. */
+extern thread_local uint64_t DRAM_PAGE_TIMER;
+
+/** How the DRAM is refreshed. */
+extern thread_local DRAMRefresh DRAM_REFRESH;
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+/** The DRAM organisation: channels, ranks per channel, bank groups per rank,
+ *  and banks per bank group. */
+extern thread_local unsigned int DRAM_CHANNELS;
+extern thread_local unsigned int DRAM_RANKS;
+extern thread_local unsigned int DRAM_BANKGROUPS;
+extern thread_local unsigned int DRAM_BANKS;
+
+/** The row buffer size, in bytes. */
+extern thread_local uint64_t DRAM_ROW_BUFFER_SIZE;
+
+/** How physical addresses map to DRAM locations. */
+extern thread_local DRAMMapping DRAM_MAPPING;
+
+/** Whether to print per-channel and per-bank DRAM statistics. */
+extern thread_local bool DRAM_STATS;
+
+/** The DRAM timing preset or timing file name. */
+extern thread_local const char *DRAM_TIMING;
+
+/** The CPU clock frequency in MHz, used to convert DRAM clocks to cycles. */
+extern thread_local uint64_t CPU_MHZ;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Find the preset with the given name, or return NULL. */
+static const DRAMTiming *find_timing_preset(const char *name)
+{
+    for (unsigned int i = 0;
+         i < sizeof(dram_timing_presets) / sizeof(dram_timing_presets[0]); i++)
+    {
+        if (strcasecmp(name, dram_timing_presets[i].name) == 0)
+        {
+            return &dram_timing_presets[i].timing;
+        }
+    }
+    return NULL;
+}
+
+/** Convert the constraints from DRAM clocks to CPU cycles, rounding up. */
+static void timing_to_cycles(const DRAMTiming *clocks, DRAMTiming *cycles)
+{
+    *cycles = *clocks;
+    if (clocks->tCK_ps == 0)
+    {
+        return;
+    }
+
+    for (unsigned int i = 1;
+         i < sizeof(dram_timing_fields) / sizeof(dram_timing_fields[0]); i++)
+    {
+        size_t offset = dram_timing_fields[i].offset;
+        uint64_t clk = *(const uint64_t *)((const char *)clocks + offset);
+        *(uint64_t *)((char *)cycles + offset) =
+            (clk * clocks->tCK_ps * CPU_MHZ + 999999) / 1000000;
+    }
+}
+
+/** Return the refresh unit of the bank and the cycle of its first refresh. */
+static unsigned int refresh_unit(DRAM *dram, unsigned int bank,
+                                 uint64_t *first)
+{
+    unsigned int unit = bank / dram->refresh_banks;
+    *first = dram->timing.tREFI + unit * dram->timing.tREFI /
+                                      dram->refresh_units;
+    return unit;
+}
+
+/**
+ * For the flat model, apply the refreshes of the bank since its last access:
+ * wait for one still in progress, and close the row if one happened since.
+ *
+ * @return The cycles the access waits for the refresh.
+ */
+static uint64_t refresh_access(DRAM *dram, unsigned int bank, uint64_t row,
+                               bool is_dram_write)
+{
+    uint64_t start;
+    if (!dram_refresh_last(dram, bank, current_cycle, &start))
+    {
+        return 0;
+    }
+
+    uint64_t blocked = 0;
+    if (current_cycle < start + dram->refresh_cycles)
+    {
+        blocked = start + dram->refresh_cycles - current_cycle;
+    }
+
+    uint64_t lost_hit = 0;
+    RowBufferEntry *entry = &dram->RowBuffer[bank];
+    if (entry->valid && dram->row_pred[bank].last_access < start)
+    {
+        entry->valid = false;
+        if (entry->RowID == row)
+        {
+            lost_hit = dram->timing.tRCD;
+        }
+    }
+
+    dram->stat_refresh_blocked += blocked;
+    if (!is_dram_write)
+    {
+        dram->stat_refresh_read_delay += blocked + lost_hit;
+    }
+    return blocked;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 //                           FUNCTION DEFINITIONS                            //
@@ -88,6 +249,68 @@ DRAM *dram_new()
     dram->stat_write_access=0;
     dram->stat_write_delay = 0;
 
+    // Organisation
+    dram->num_channels = DRAM_CHANNELS;
+    dram->num_ranks = DRAM_RANKS;
+    dram->num_bankgroups = DRAM_BANKGROUPS;
+    dram->num_banks = DRAM_BANKS;
+    dram->row_buffer_size = DRAM_ROW_BUFFER_SIZE;
+    dram->mapping = DRAM_MAPPING;
+    dram->total_banks = DRAM_CHANNELS * DRAM_RANKS * DRAM_BANKGROUPS *
+                        DRAM_BANKS;
+
+    unsigned int banks_per_rank = DRAM_BANKGROUPS * DRAM_BANKS;
+    if (dram->mapping == MAP_XOR && (banks_per_rank & (banks_per_rank - 1)))
+    {
+        fprintf(stderr, "Error: XOR mapping needs a power-of-two number of "
+                        "banks per rank\n");
+        exit(1);
+    }
+
+    dram->RowBuffer = (RowBufferEntry *)calloc(dram->total_banks,
+                                               sizeof(RowBufferEntry));
+    dram->bank_stats = (DRAMBankStats *)calloc(dram->total_banks,
+                                               sizeof(DRAMBankStats));
+    dram->channel_stats = (DRAMChannelStats *)calloc(
+        dram->num_channels, sizeof(DRAMChannelStats));
+    dram->row_pred = (RowPredictor *)calloc(dram->total_banks,
+                                            sizeof(RowPredictor));
+    for (unsigned int i = 0; i < dram->total_banks; i++)
+    {
+        // Start out weakly predicting row hits, i.e. as open-page.
+        dram->row_pred[i].counter = 2;
+    }
+    dram->print_detail = DRAM_STATS;
+
+    DRAMTiming timing;
+    if (!dram_timing_load(DRAM_TIMING, &timing))
+    {
+        exit(1);
+    }
+    timing_to_cycles(&timing, &dram->timing);
+
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        if (dram->timing.tREFI == 0 ||
+            (DRAM_REFRESH == REFRESH_ALL_BANK ? dram->timing.tRFC
+                                              : dram->timing.tRFCpb) == 0)
+        {
+            fprintf(stderr, "Error: the DRAM timing %s has no %s refresh "
+                            "constraints\n", DRAM_TIMING,
+                    DRAM_REFRESH == REFRESH_ALL_BANK ? "all-bank"
+                                                     : "per-bank");
+            exit(1);
+        }
+
+        dram->refresh_banks = DRAM_REFRESH == REFRESH_ALL_BANK
+                                  ? banks_per_rank
+                                  : 1;
+        dram->refresh_units = dram->total_banks / dram->refresh_banks;
+        dram->refresh_cycles = DRAM_REFRESH == REFRESH_ALL_BANK
+                                   ? dram->timing.tRFC
+                                   : dram->timing.tRFCpb;
+    }
+
     return dram;
 }
 
@@ -122,17 +345,27 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write)
     }
 
     // Update stats
+    DRAMChannelStats *ch = &dram->channel_stats[dram->last_channel];
     if(is_dram_write)
     {
         dram->stat_write_access++;
         dram->stat_write_delay+=delay;
+        ch->writes++;
+        ch->write_delay += delay;
     }
     else
     {
         dram->stat_read_access++;
         dram->stat_read_delay+=delay;
+        ch->reads++;
+        ch->read_delay += delay;
     }  
 
+    if (dram->rec)
+    {
+        dramrec_transfer(dram->rec, is_dram_write, delay);
+    }
+
     return delay;
 }
 
@@ -156,37 +389,54 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write)
 uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
                                bool is_dram_write)
 {
-    // Assume a mapping with consecutive lines in the same row and consecutive
-    // row buffers in consecutive rows.
+    // The mapping from line address to bank and row is selected by
+    // DRAM_MAPPING; see dram_decode().
     // TODO: Use this function to track open rows.
     // TODO: Compute the delay based on row buffer hit/miss/empty.
     uint64_t delay = 0;
-    unsigned int bank_index = 0;
-    uint64_t row_id = 0;
-    uint64_t buffAddr = 0;
+    DRAMAddr loc;
+    DRAMTiming *t = &dram->timing;
+    uint64_t cas = is_dram_write ? t->tCWL : t->tCL;
 
-    delay += DELAY_BUS;
+    delay += t->tBURST;
 
     //Find the Dram Addr
-    buffAddr = line_addr * CACHE_LINESIZE;
-    //First / = right shift
-    // Need Number of Banks?
-    bank_index = buffAddr/ROW_BUFFER_SIZE % NUM_BANKS;
-    row_id = buffAddr/ROW_BUFFER_SIZE / NUM_BANKS;
+    dram_decode(dram, line_addr, &loc);
+    unsigned int bank_index = loc.bank_index;
+    uint64_t row_id = loc.row;
 
-    // line_in_row = lineaddr % (ROWBUF_SIZE / CACHE_LINESIZE);
-    // bank_id = (lineaddr / (ROWBUF_SIZE / CACHE_LINESIZE)) % DRAM_BANKS;
-    // row_in_bank = lineaddr / (ROWBUF_SIZE / CACHE_LINESIZE) / DRAM_BANKS;
+    dram->last_channel = loc.channel;
+    DRAMBankStats *bank = &dram->bank_stats[bank_index];
+    if (is_dram_write)
+    {
+        bank->writes++;
+    }
+    else
+    {
+        bank->reads++;
+    }
+
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        delay += refresh_access(dram, bank_index, row_id, is_dram_write);
+    }
+
+    DRAMRowOutcome outcome = ROW_EMPTY;
 
     //For Close Page
-    if (DRAM_PAGE_POLICY)
+    if (DRAM_PAGE_POLICY == CLOSE_PAGE)
     {
-        delay += DELAY_ACT;
-        delay += DELAY_CAS;
+        delay += t->tRCD;
+        delay += cas;
+        bank->row_empty++;
     }
-    //For Open Page
+    //For Open Page and the adaptive policies
     else
     {   
+        // A row the timer closed since the last access was precharged in
+        // the background, so this access finds the bank empty.
+        dram_policy_expire(dram, bank_index, current_cycle, NULL);
+
         //To test hit empty or miss
         //Not empty
         if (dram->RowBuffer[bank_index].valid==true)
@@ -194,14 +444,17 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
             //if hit
             if (dram->RowBuffer[bank_index].RowID == row_id)
             {
-                delay += DELAY_CAS;
-
+                delay += cas;
+                bank->row_hits++;
+                outcome = ROW_HIT;
             }
             else
             {
-                delay += DELAY_ACT;
-                delay += DELAY_CAS;
-                delay += DELAY_PRE;
+                delay += t->tRCD;
+                delay += cas;
+                delay += t->tRP;
+                bank->row_misses++;
+                outcome = ROW_CONFLICT;
 
                 dram->RowBuffer[bank_index].RowID = row_id;
             }
@@ -210,17 +463,325 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
         //Empty Case
         else
         {
-            delay += DELAY_ACT;
-            delay += DELAY_CAS;
+            delay += t->tRCD;
+            delay += cas;
+            bank->row_empty++;
 
             dram->RowBuffer[bank_index].valid = true;
             dram->RowBuffer[bank_index].RowID = row_id;
         }
+
+        // Close the row right away if the predictor expects a miss; as in
+        // close-page, the precharge is then off the critical path.
+        if (!dram_policy_update(dram, bank_index, row_id, current_cycle))
+        {
+            dram->RowBuffer[bank_index].valid = false;
+            dram->stat_policy_closes++;
+        }
+    }
+
+    if (dram->rec)
+    {
+        dramrec_row(dram->rec, bank_index, outcome);
     }
 
     return delay;
 }
 
+/**
+ * Under the timer page policies, close the open row of the bank if it has
+ * been idle for DRAM_PAGE_TIMER cycles by the given cycle. The precharge is
+ * assumed to have happened in the background when the timer ran out.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @param closed_at If not NULL, where to store the cycle the row was closed.
+ * @return Whether the row was closed.
+ */
+bool dram_policy_expire(DRAM *dram, unsigned int bank, uint64_t now,
+                        uint64_t *closed_at)
+{
+    if (DRAM_PAGE_POLICY != TIMER_PAGE && DRAM_PAGE_POLICY != HYBRID_PAGE)
+    {
+        return false;
+    }
+
+    RowPredictor *pred = &dram->row_pred[bank];
+    uint64_t deadline = pred->last_access + DRAM_PAGE_TIMER;
+    if (!dram->RowBuffer[bank].valid || now <= deadline)
+    {
+        return false;
+    }
+
+    dram->RowBuffer[bank].valid = false;
+    dram->stat_policy_closes++;
+    if (closed_at)
+    {
+        *closed_at = deadline;
+    }
+    return true;
+}
+
+/**
+ * Record a column access to the given row of the bank, train the bank's
+ * row-hit predictor, and decide whether the page policy keeps the row open.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param row The row accessed.
+ * @param now The current cycle.
+ * @return Whether the row should stay open after the access.
+ */
+bool dram_policy_update(DRAM *dram, unsigned int bank, uint64_t row,
+                        uint64_t now)
+{
+    RowPredictor *pred = &dram->row_pred[bank];
+
+    // Train on whether an open-page policy would have hit.
+    if (pred->has_last_row)
+    {
+        if (pred->last_row == row)
+        {
+            pred->counter += pred->counter < 3;
+        }
+        else
+        {
+            pred->counter -= pred->counter > 0;
+        }
+    }
+    pred->last_row = row;
+    pred->has_last_row = true;
+    pred->last_access = now;
+
+    switch (DRAM_PAGE_POLICY)
+    {
+    case CLOSE_PAGE:
+        return false;
+
+    case PREDICT_PAGE:
+    case HYBRID_PAGE:
+        return pred->counter >= 2;
+
+    case OPEN_PAGE:
+    case TIMER_PAGE:
+    default:
+        return true;
+    }
+}
+
+/**
+ * Find the last refresh of the bank that started at or before the given
+ * cycle. Refresh must be enabled.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @param start Where to store the cycle the refresh started.
+ * @return Whether the bank has been refreshed by now.
+ */
+bool dram_refresh_last(DRAM *dram, unsigned int bank, uint64_t now,
+                       uint64_t *start)
+{
+    uint64_t first;
+    refresh_unit(dram, bank, &first);
+    if (now < first)
+    {
+        return false;
+    }
+
+    *start = now - (now - first) % dram->timing.tREFI;
+    return true;
+}
+
+/**
+ * Return the cycle the first refresh of the bank after the given cycle
+ * starts. Refresh must be enabled.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @return The start of the next refresh.
+ */
+uint64_t dram_refresh_next(DRAM *dram, unsigned int bank, uint64_t now)
+{
+    uint64_t start;
+    if (!dram_refresh_last(dram, bank, now, &start))
+    {
+        refresh_unit(dram, bank, &start);
+        return start;
+    }
+    return start + dram->timing.tREFI;
+}
+
+/**
+ * Load a set of DRAM timing constraints.
+ *
+ * The spec is either the name of a preset (LAB, DDR4, DDR5, or LPDDR4) or
+ * the name of a file. Each line of the file holds a constraint name and its
+ * value, or "preset" and the name of a preset to start from; "#" starts a
+ * comment. Constraints the file doesn't set keep the LAB values.
+ *
+ * @param spec The preset or file name.
+ * @param timing Where to store the constraints, in DRAM clocks.
+ * @return Whether the constraints were loaded. If not, an error message has
+ *         been printed.
+ */
+bool dram_timing_load(const char *spec, DRAMTiming *timing)
+{
+    const DRAMTiming *preset = find_timing_preset(spec);
+    if (preset)
+    {
+        *timing = *preset;
+        return true;
+    }
+
+    FILE *fp = fopen(spec, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "Error: %s is neither a DRAM timing preset nor a "
+                        "readable file\n", spec);
+        return false;
+    }
+
+    *timing = dram_timing_presets[0].timing;
+
+    char line[DRAM_TIMING_LINE_MAX];
+    unsigned int line_num = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp))
+    {
+        line_num++;
+
+        char key[DRAM_TIMING_LINE_MAX];
+        char value[DRAM_TIMING_LINE_MAX];
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+
+        int fields = sscanf(line, "%s %s", key, value);
+        if (fields <= 0)
+        {
+            continue;
+        }
+        ok = false;
+        if (fields != 2)
+        {
+            break;
+        }
+
+        if (strcasecmp(key, "preset") == 0)
+        {
+            preset = find_timing_preset(value);
+            if (preset)
+            {
+                *timing = *preset;
+                ok = true;
+            }
+            continue;
+        }
+
+        char *end;
+        uint64_t number = strtoull(value, &end, 10);
+        for (unsigned int i = 0;
+             i < sizeof(dram_timing_fields) / sizeof(dram_timing_fields[0]);
+             i++)
+        {
+            if (*end == '\0' &&
+                strcasecmp(key, dram_timing_fields[i].name) == 0)
+            {
+                *(uint64_t *)((char *)timing + dram_timing_fields[i].offset) =
+                    number;
+                ok = true;
+            }
+        }
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "Error: %s:%u: bad DRAM timing line\n", spec,
+                line_num);
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+/**
+ * Find where the given cache line lives in the DRAM organisation.
+ *
+ * @param dram The DRAM module.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param loc Where to store the location.
+ */
+void dram_decode(DRAM *dram, uint64_t line_addr, DRAMAddr *loc)
+{
+    uint64_t x;
+
+    // Peel the fields off from the least significant end.
+    if (dram->mapping == MAP_LINE_INTERLEAVE)
+    {
+        x = line_addr;
+    }
+    else
+    {
+        uint64_t addr = line_addr * CACHE_LINESIZE;
+        loc->column = addr % dram->row_buffer_size;
+        x = addr / dram->row_buffer_size;
+    }
+
+    loc->channel = x % dram->num_channels;
+    x /= dram->num_channels;
+    loc->bankgroup = x % dram->num_bankgroups;
+    x /= dram->num_bankgroups;
+    loc->bank = x % dram->num_banks;
+    x /= dram->num_banks;
+    loc->rank = x % dram->num_ranks;
+    x /= dram->num_ranks;
+
+    if (dram->mapping == MAP_LINE_INTERLEAVE)
+    {
+        uint64_t lines_per_row = dram->row_buffer_size / CACHE_LINESIZE;
+        loc->column = x % lines_per_row * CACHE_LINESIZE;
+        x /= lines_per_row;
+    }
+    loc->row = x;
+
+    if (dram->mapping == MAP_XOR)
+    {
+        unsigned int banks_per_rank = dram->num_bankgroups * dram->num_banks;
+        unsigned int b = loc->bank * dram->num_bankgroups + loc->bankgroup;
+        b ^= loc->row % banks_per_rank;
+        loc->bankgroup = b % dram->num_bankgroups;
+        loc->bank = b / dram->num_bankgroups;
+    }
+
+    loc->bank_index = ((loc->channel * dram->num_ranks + loc->rank) *
+                       dram->num_banks + loc->bank) * dram->num_bankgroups +
+                      loc->bankgroup;
+}
+
+/**
+ * Return the number of page colours of the DRAM: pages whose frame numbers
+ * are equal modulo this number map to the same banks. This only holds under
+ * MAP_ROW_BANK_COL: MAP_LINE_INTERLEAVE spreads every page over the banks
+ * line by line, and under MAP_XOR the bank also depends on the row.
+ *
+ * @param dram The DRAM module.
+ * @param page_size The page size in bytes.
+ * @return The number of page colours, at least 1.
+ */
+uint64_t dram_num_page_colours(DRAM *dram, uint64_t page_size)
+{
+    // The bank of an address repeats every `period` bytes.
+    uint64_t period = (uint64_t)dram->total_banks * dram->row_buffer_size;
+    uint64_t colours = period / page_size;
+    return colours ? colours : 1;
+}
+
 /**
  * Print the statistics of the DRAM module.
  * 
@@ -250,4 +811,108 @@ void dram_print_stats(DRAM *dram)
     printf("DRAM_WRITE_ACCESS    \t\t : %10llu\n", dram->stat_write_access);
     printf("DRAM_READ_DELAY_AVG  \t\t : %10.3f\n", avg_read_delay);
     printf("DRAM_WRITE_DELAY_AVG \t\t : %10.3f\n", avg_write_delay);
+
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        // The refreshes that came due during the run.
+        unsigned long long refreshes = 0;
+        for (unsigned int u = 0; u < dram->refresh_units; u++)
+        {
+            uint64_t first;
+            refresh_unit(dram, u * dram->refresh_banks, &first);
+            if (current_cycle >= first)
+            {
+                refreshes += (current_cycle - first) / dram->timing.tREFI + 1;
+            }
+        }
+
+        double ref_read_delay_avg = 0.0;
+        if (dram->stat_read_access)
+        {
+            ref_read_delay_avg = (double)(dram->stat_refresh_read_delay) /
+                                 (double)(dram->stat_read_access);
+        }
+
+        printf("DRAM_REFRESHES       \t\t : %10llu\n", refreshes);
+        printf("DRAM_REF_BLOCKED     \t\t : %10llu\n",
+               (unsigned long long)dram->stat_refresh_blocked);
+        printf("DRAM_REF_RD_DELAY_AVG\t\t : %10.3f\n", ref_read_delay_avg);
+    }
+
+    if (dram->print_detail)
+    {
+        dram_print_detail_stats(dram);
+    }
+}
+
+/**
+ * Print the per-channel and per-bank statistics of the DRAM module.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+void dram_print_detail_stats(DRAM *dram)
+{
+    for (unsigned int c = 0; c < dram->num_channels; c++)
+    {
+        DRAMChannelStats *ch = &dram->channel_stats[c];
+        double avg_read_delay = 0.0;
+        if (ch->reads)
+        {
+            avg_read_delay = (double)(ch->read_delay) / (double)(ch->reads);
+        }
+
+        printf("\n");
+        printf("DRAM_CH_%u_READ_ACCESS \t\t : %10llu\n", c, ch->reads);
+        printf("DRAM_CH_%u_WRITE_ACCESS\t\t : %10llu\n", c, ch->writes);
+        printf("DRAM_CH_%u_READ_DELAY_AVG\t : %10.3f\n", c, avg_read_delay);
+    }
+
+    if (DRAM_PAGE_POLICY >= TIMER_PAGE)
+    {
+        printf("\n");
+        printf("DRAM_POLICY_CLOSES   \t\t : %10llu\n",
+               dram->stat_policy_closes);
+    }
+
+    printf("\n");
+    for (unsigned int i = 0; i < dram->total_banks; i++)
+    {
+        DRAMBankStats *b = &dram->bank_stats[i];
+        unsigned long long access = b->reads + b->writes;
+        double hit_percent = 0.0;
+        if (access)
+        {
+            hit_percent = 100.0 * (double)(b->row_hits) / (double)access;
+        }
+
+        // bank_index = ((channel * ranks + rank) * banks + bank) * groups + bg
+        unsigned int bg = i % dram->num_bankgroups;
+        unsigned int bank = i / dram->num_bankgroups % dram->num_banks;
+        unsigned int rank = i / dram->num_bankgroups / dram->num_banks %
+                            dram->num_ranks;
+        unsigned int channel = i / dram->num_bankgroups / dram->num_banks /
+                               dram->num_ranks;
+        printf("DRAM_BANK_C%u_R%u_G%u_B%-2u \t : %10llu access %6.2f%% "
+               "row hits (%llu miss, %llu empty)\n",
+               channel, rank, bg, bank, access, hit_percent, b->row_misses,
+               b->row_empty);
+    }
+}
+
+/**
+ * Free a DRAM module, finishing its recorder if it still has one.
+ *
+ * @param dram The DRAM module.
+ */
+void dram_free(DRAM *dram)
+{
+    if (dram->rec)
+    {
+        dramrec_finish(dram->rec);
+    }
+    free(dram->RowBuffer);
+    free(dram->bank_stats);
+    free(dram->channel_stats);
+    free(dram->row_pred);
+    free(dram);
 }
@@ -10,9 +10,34 @@
 #define __DRAM_H__
 
 #include "types.h"
+#include "dramrec.h"
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+// The latencies of the LAB timing preset, which are also the defaults.
+
+/** The DRAM activation latency (ACT), in cycles. (Also known as RAS.) */
+#define DELAY_ACT 45
+
+/** The DRAM column selection latency (CAS), in cycles. */
+#define DELAY_CAS 45
+
+/** The DRAM precharge latency (PRE), in cycles. */
+#define DELAY_PRE 45
+
+/**
+ * The DRAM bus latency, in cycles.
+ * 
+ * This is how long it takes for the DRAM to transmit the data via the bus. It
+ * is incurred on every DRAM access. (In part B, assume that this is included
+ * in the fixed DRAM latency DELAY_SIM_MODE_B.)
+ */
+#define DELAY_BUS 10
+
 ///////////////////////////////////////////////////////////////////////////////
 //                              DATA STRUCTURES                              //
 ///////////////////////////////////////////////////////////////////////////////
@@ -27,6 +52,123 @@ typedef struct RowBufferEntry
 
 }RowBufferEntry;
 
+/** Possible mappings from physical addresses to DRAM locations. */
+typedef enum DRAMMappingEnum
+{
+    /**
+     * row:rank:bank:bankgroup:channel:column. Each row-buffer-sized chunk of
+     * the address space goes to the next channel, then bank group, then bank.
+     */
+    MAP_ROW_BANK_COL = 0,
+
+    /**
+     * row:column:rank:bank:bankgroup:channel:line. Consecutive cache lines go
+     * to different channels and banks.
+     */
+    MAP_LINE_INTERLEAVE = 1,
+
+    /**
+     * As MAP_ROW_BANK_COL, but the bank within the rank is XORed with the low
+     * bits of the row, so rows that would conflict in one bank are spread
+     * over all of them (permutation-based interleaving).
+     */
+    MAP_XOR = 2,
+} DRAMMapping;
+
+/** The location of a cache line in the DRAM organisation. */
+typedef struct DRAMAddr
+{
+    unsigned int channel;
+    unsigned int rank;
+    unsigned int bankgroup;
+    unsigned int bank;
+    uint64_t row;
+    uint64_t column;
+
+    /** The index of the bank across the whole DRAM, for per-bank arrays. */
+    unsigned int bank_index;
+} DRAMAddr;
+
+/** Possible ways of refreshing the DRAM. */
+typedef enum DRAMRefreshEnum
+{
+    /** No refresh. */
+    REFRESH_NONE = 0,
+    /** Every tREFI, each rank refreshes all its banks at once for tRFC. */
+    REFRESH_ALL_BANK = 1,
+    /** Every tREFI, each bank refreshes on its own for tRFCpb, the banks
+     *  taking turns. */
+    REFRESH_PER_BANK = 2,
+} DRAMRefresh;
+
+/** Per-bank statistics. */
+typedef struct DRAMBankStats
+{
+    unsigned long long reads;
+    unsigned long long writes;
+    unsigned long long row_hits;
+    unsigned long long row_misses;
+    unsigned long long row_empty;
+} DRAMBankStats;
+
+/** Per-channel statistics. */
+typedef struct DRAMChannelStats
+{
+    unsigned long long reads;
+    unsigned long long writes;
+    uint64_t read_delay;
+    uint64_t write_delay;
+} DRAMChannelStats;
+
+
+/**
+ * Per-bank state of the adaptive page policies. The predictor learns whether
+ * consecutive accesses to the bank tend to go to the same row, whether or not
+ * the row was actually kept open in between.
+ */
+typedef struct RowPredictor
+{
+    /** The row of the bank's last access, if has_last_row. */
+    uint64_t last_row;
+    bool has_last_row;
+    /** The cycle of the bank's last access. */
+    uint64_t last_access;
+    /** A 2-bit saturating counter; 2 or more predicts a row hit. */
+    unsigned int counter;
+} RowPredictor;
+
+/**
+ * The DRAM timing constraints. As loaded by dram_timing_load(), they are in
+ * DRAM clocks of tCK_ps picoseconds, or in CPU cycles if tCK_ps is 0;
+ * dram_new() converts them to CPU cycles. A constraint of 0 is not enforced.
+ *
+ * The flat model of dram_access_mode_CDEF() only uses tRCD, tRP, tCL, tCWL,
+ * and tBURST, and the refresh constraints if refresh is enabled. The memory
+ * controller enforces the rest.
+ */
+typedef struct DRAMTiming
+{
+    uint64_t tCK_ps;
+    uint64_t tRCD;   // ACT to RD/WR.
+    uint64_t tRP;    // PRE to ACT.
+    uint64_t tCL;    // RD to read data.
+    uint64_t tCWL;   // WR to write data.
+    uint64_t tBURST; // Data transfer of one cache line.
+    uint64_t tRAS;   // ACT to PRE.
+    uint64_t tRC;    // ACT to ACT in the same bank.
+    uint64_t tWR;    // End of write data to PRE.
+    uint64_t tWTR;   // End of write data to RD in the same rank.
+    uint64_t tRTP;   // RD to PRE.
+    uint64_t tRTW;   // RD to WR in the same channel (bus turnaround).
+    uint64_t tRRD_S; // ACT to ACT in another bank group of the rank.
+    uint64_t tRRD_L; // ACT to ACT in the same bank group.
+    uint64_t tFAW;   // Window in which a rank may issue at most four ACTs.
+    uint64_t tCCD_S; // RD/WR to RD/WR in another bank group of the rank.
+    uint64_t tCCD_L; // RD/WR to RD/WR in the same bank group.
+    uint64_t tREFI;  // Interval between refreshes of each bank.
+    uint64_t tRFC;   // Duration of an all-bank refresh.
+    uint64_t tRFCpb; // Duration of a per-bank refresh (0 if unsupported).
+} DRAMTiming;
 
 /** A DRAM module. */
 typedef struct DRAM
@@ -60,18 +202,67 @@ typedef struct DRAM
      */
     uint64_t stat_write_delay;
 
-    //Define the 16 Banks
-    //
-    RowBufferEntry RowBuffer[16];
+    /**
+     * The organisation: channels x ranks x bank groups x banks, with rows of
+     * row_buffer_size bytes.
+     */
+    unsigned int num_channels;
+    unsigned int num_ranks;
+    unsigned int num_bankgroups;
+    unsigned int num_banks;
+    uint64_t row_buffer_size;
+    DRAMMapping mapping;
+
+    /** The total number of banks across all channels and ranks. */
+    unsigned int total_banks;
+
+    /** The open row of each bank, indexed by DRAMAddr::bank_index. */
+    RowBufferEntry *RowBuffer;
+
+    /** Statistics per bank and per channel. */
+    DRAMBankStats *bank_stats;
+    DRAMChannelStats *channel_stats;
+    /** Whether dram_print_stats() also prints the per-bank statistics. */
+    bool print_detail;
+
+    /** The channel of the most recent access, for the channel statistics. */
+    unsigned int last_channel;
+
+    /** The timing constraints, in CPU cycles. */
+    DRAMTiming timing;
+
+    /**
+     * The refresh schedule: the banks are refreshed in units of refresh_banks
+     * consecutive banks (a rank, or a single bank), each taking refresh_cycles.
+     * Unit u is refreshed at u * tREFI / refresh_units + k * tREFI, k >= 1.
+     */
+    unsigned int refresh_banks;
+    unsigned int refresh_units;
+    uint64_t refresh_cycles;
+    /** The cycles accesses were held up by refreshes in progress. */
+    uint64_t stat_refresh_blocked;
+    /** The latency refreshes added to reads, including the activations of
+     *  rows that would have still been open without them. */
+    uint64_t stat_refresh_read_delay;
 
+    /** The time-series recorder, or NULL if recording is disabled. */
+    DRAMRecorder *rec;
 
+    /** The state of the adaptive page policies, indexed like RowBuffer. */
+    RowPredictor *row_pred;
+    /** The number of rows closed early by the adaptive page policies. */
+    unsigned long long stat_policy_closes;
 } DRAM;
 
 /** Possible page policies for DRAM. */
 typedef enum DRAMPolicyEnum
 {
-    OPEN_PAGE = 0,  // The DRAM uses an open-page policy.
-    CLOSE_PAGE = 1, // The DRAM uses a close-page policy.
+    OPEN_PAGE = 0,    // The DRAM uses an open-page policy.
+    CLOSE_PAGE = 1,   // The DRAM uses a close-page policy.
+    TIMER_PAGE = 2,   // Open-page, but rows idle for DRAM_PAGE_TIMER close.
+    PREDICT_PAGE = 3, // Each bank's row-hit predictor picks open or close.
+    HYBRID_PAGE = 4,  // PREDICT_PAGE, with rows kept open closing as in
+                      // TIMER_PAGE.
 } DRAMPolicy;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -137,6 +328,94 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write);
 uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
                                bool is_dram_write);
 
+/**
+ * Under the timer page policies, close the open row of the bank if it has
+ * been idle for DRAM_PAGE_TIMER cycles by the given cycle. The precharge is
+ * assumed to have happened in the background when the timer ran out.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @param closed_at If not NULL, where to store the cycle the row was closed.
+ * @return Whether the row was closed.
+ */
+bool dram_policy_expire(DRAM *dram, unsigned int bank, uint64_t now,
+                        uint64_t *closed_at);
+
+/**
+ * Record a column access to the given row of the bank, train the bank's
+ * row-hit predictor, and decide whether the page policy keeps the row open.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param row The row accessed.
+ * @param now The current cycle.
+ * @return Whether the row should stay open after the access.
+ */
+bool dram_policy_update(DRAM *dram, unsigned int bank, uint64_t row,
+                        uint64_t now);
+
+/**
+ * Find the last refresh of the bank that started at or before the given
+ * cycle. Refresh must be enabled.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @param start Where to store the cycle the refresh started.
+ * @return Whether the bank has been refreshed by now.
+ */
+bool dram_refresh_last(DRAM *dram, unsigned int bank, uint64_t now,
+                       uint64_t *start);
+
+/**
+ * Return the cycle the first refresh of the bank after the given cycle
+ * starts. Refresh must be enabled.
+ *
+ * @param dram The DRAM module.
+ * @param bank The bank index.
+ * @param now The current cycle.
+ * @return The start of the next refresh.
+ */
+uint64_t dram_refresh_next(DRAM *dram, unsigned int bank, uint64_t now);
+
+/**
+ * Load a set of DRAM timing constraints.
+ *
+ * The spec is either the name of a preset (LAB, DDR4, DDR5, or LPDDR4) or
+ * the name of a file. Each line of the file holds a constraint name and its
+ * value, or "preset" and the name of a preset to start from; "#" starts a
+ * comment. Constraints the file doesn't set keep the LAB values.
+ *
+ * @param spec The preset or file name.
+ * @param timing Where to store the constraints, in DRAM clocks.
+ * @return Whether the constraints were loaded. If not, an error message has
+ *         been printed.
+ */
+bool dram_timing_load(const char *spec, DRAMTiming *timing);
+
+/**
+ * Find where the given cache line lives in the DRAM organisation.
+ *
+ * @param dram The DRAM module.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param loc Where to store the location.
+ */
+void dram_decode(DRAM *dram, uint64_t line_addr, DRAMAddr *loc);
+
+/**
+ * Return the number of page colours of the DRAM: pages whose frame numbers
+ * are equal modulo this number map to the same banks. This only holds under
+ * MAP_ROW_BANK_COL: MAP_LINE_INTERLEAVE spreads every page over the banks
+ * line by line, and under MAP_XOR the bank also depends on the row.
+ *
+ * @param dram The DRAM module.
+ * @param page_size The page size in bytes.
+ * @return The number of page colours, at least 1.
+ */
+uint64_t dram_num_page_colours(DRAM *dram, uint64_t page_size);
+
 /**
  * Print the statistics of the DRAM module.
  * 
@@ -146,4 +425,18 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
  */
 void dram_print_stats(DRAM *dram);
 
+/**
+ * Print the per-channel and per-bank statistics of the DRAM module.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+void dram_print_detail_stats(DRAM *dram);
+
+/**
+ * Free a DRAM module, finishing its recorder if it still has one.
+ *
+ * @param dram The DRAM module.
+ */
+void dram_free(DRAM *dram);
+
 #endif // __DRAM_H__
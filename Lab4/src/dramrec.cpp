@@ -0,0 +1,303 @@
+// dramrec.cpp
+// Defines the DRAM time-series and command trace recorder.
+
+#include "dramrec.h"
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+static inline double ratio(double num, double den)
+{
+    return den ? num / den : 0.0;
+}
+
+/** Write the rows of the interval ending at the given cycle and reset it. */
+static void write_interval(DRAMRecorder *rec, uint64_t end)
+{
+    uint64_t cycles = end - rec->interval_start;
+    unsigned long long hits = 0;
+    unsigned long long empty = 0;
+    unsigned long long conflicts = 0;
+
+    for (unsigned int i = 0; i < rec->total_banks; i++)
+    {
+        unsigned long long access = rec->bank_hits[i] + rec->bank_empty[i] +
+                                    rec->bank_conflicts[i];
+        if (!access)
+        {
+            continue;
+        }
+
+        // bank_index = ((channel * ranks + rank) * banks + bank) * groups + bg
+        unsigned int bg = i % rec->num_bankgroups;
+        unsigned int bank = i / rec->num_bankgroups % rec->num_banks;
+        unsigned int rank = i / rec->num_bankgroups / rec->num_banks %
+                            rec->num_ranks;
+        unsigned int channel = i / rec->num_bankgroups / rec->num_banks /
+                               rec->num_ranks;
+        fprintf(rec->bank_fp, "%llu,%u,%u,%u,%u,%llu,%.4f,%.4f,%.4f\n",
+                (unsigned long long)end, channel, rank, bg, bank, access,
+                ratio(rec->bank_hits[i], access),
+                ratio(rec->bank_empty[i], access),
+                ratio(rec->bank_conflicts[i], access));
+
+        hits += rec->bank_hits[i];
+        empty += rec->bank_empty[i];
+        conflicts += rec->bank_conflicts[i];
+        rec->bank_hits[i] = 0;
+        rec->bank_empty[i] = 0;
+        rec->bank_conflicts[i] = 0;
+    }
+
+    // Bytes per cycle times millions of cycles per second, in GB/s.
+    double bytes = (double)((rec->reads + rec->writes) * rec->line_size);
+    double gbps = ratio(bytes, cycles) * rec->cpu_mhz / 1000.0;
+
+    fprintf(rec->fp, "%llu,%llu,%llu,%.3f,%llu,%llu,%llu,%.4f,%.3f,%.3f\n",
+            (unsigned long long)end, rec->reads, rec->writes, gbps, hits,
+            empty, conflicts, ratio(hits, hits + empty + conflicts),
+            ratio(rec->queue_sum, cycles),
+            ratio(rec->read_delay, rec->reads));
+
+    rec->reads = 0;
+    rec->writes = 0;
+    rec->read_delay = 0;
+    rec->queue_sum = 0;
+    rec->interval_start = end;
+}
+
+/** Write the rows of the intervals that ended before the current cycle. */
+static inline void advance(DRAMRecorder *rec)
+{
+    while (current_cycle >= rec->interval_end)
+    {
+        write_interval(rec, rec->interval_end);
+        rec->interval_end += rec->interval;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate a DRAM recorder and create its output files.
+ *
+ * @param prefix The prefix of the output file names.
+ * @param interval The number of cycles per row of the time series.
+ * @param cmd_trace Whether to also write command traces.
+ * @param num_channels The number of DRAM channels.
+ * @param num_ranks The number of ranks per channel.
+ * @param num_bankgroups The number of bank groups per rank.
+ * @param num_banks The number of banks per bank group.
+ * @param line_size The number of bytes per access.
+ * @param cpu_mhz The CPU clock in MHz.
+ * @param tck_ps The DRAM clock period in picoseconds, or 0 to write command
+ *               times in CPU cycles.
+ * @return A pointer to the recorder, or NULL if the files can't be created.
+ */
+DRAMRecorder *dramrec_new(const char *prefix, uint64_t interval,
+                          bool cmd_trace, unsigned int num_channels,
+                          unsigned int num_ranks, unsigned int num_bankgroups,
+                          unsigned int num_banks, uint64_t line_size,
+                          uint64_t cpu_mhz, uint64_t tck_ps)
+{
+    size_t name_len = strlen(prefix) + 48;
+    char *name = (char *)malloc(name_len);
+    unsigned int total_ranks = num_channels * num_ranks;
+
+    snprintf(name, name_len, "%s_dram.csv", prefix);
+    FILE *fp = fopen(name, "w");
+    snprintf(name, name_len, "%s_banks.csv", prefix);
+    FILE *bank_fp = fp ? fopen(name, "w") : NULL;
+    if (!bank_fp)
+    {
+        perror("Couldn't create DRAM recorder file");
+        if (fp)
+        {
+            fclose(fp);
+        }
+        free(name);
+        return NULL;
+    }
+
+    FILE **cmd_fp = NULL;
+    if (cmd_trace)
+    {
+        cmd_fp = (FILE **)calloc(total_ranks, sizeof(FILE *));
+        for (unsigned int r = 0; r < total_ranks; r++)
+        {
+            snprintf(name, name_len, "%s_cmd_%u_%u.trace", prefix,
+                     r / num_ranks, r % num_ranks);
+            cmd_fp[r] = fopen(name, "w");
+            if (!cmd_fp[r])
+            {
+                perror("Couldn't create DRAM command trace");
+                for (unsigned int i = 0; i < r; i++)
+                {
+                    fclose(cmd_fp[i]);
+                }
+                free(cmd_fp);
+                fclose(fp);
+                fclose(bank_fp);
+                free(name);
+                return NULL;
+            }
+        }
+    }
+    free(name);
+
+    fprintf(fp, "cycle,reads,writes,bandwidth_gbps,row_hits,row_empty,"
+                "row_conflicts,row_hit_rate,queue_avg,read_latency_avg\n");
+    fprintf(bank_fp, "cycle,channel,rank,bankgroup,bank,access,hit_rate,"
+                     "empty_rate,conflict_rate\n");
+
+    DRAMRecorder *rec = (DRAMRecorder *)calloc(1, sizeof(DRAMRecorder));
+    rec->fp = fp;
+    rec->bank_fp = bank_fp;
+    rec->cmd_fp = cmd_fp;
+    rec->num_channels = num_channels;
+    rec->num_ranks = num_ranks;
+    rec->num_bankgroups = num_bankgroups;
+    rec->num_banks = num_banks;
+    rec->total_banks = total_ranks * num_bankgroups * num_banks;
+    rec->line_size = line_size;
+    rec->cpu_mhz = cpu_mhz;
+    rec->tck_ps = tck_ps;
+    rec->interval = interval;
+    rec->interval_end = interval;
+    rec->bank_hits = (unsigned long long *)calloc(
+        rec->total_banks, sizeof(unsigned long long));
+    rec->bank_empty = (unsigned long long *)calloc(
+        rec->total_banks, sizeof(unsigned long long));
+    rec->bank_conflicts = (unsigned long long *)calloc(
+        rec->total_banks, sizeof(unsigned long long));
+    return rec;
+}
+
+/**
+ * Record how an access found its bank.
+ *
+ * @param rec The DRAM recorder.
+ * @param bank The bank index (see DRAMAddr::bank_index).
+ * @param outcome Whether the access hit the open row, found the bank empty,
+ *                or had to close another row.
+ */
+void dramrec_row(DRAMRecorder *rec, unsigned int bank,
+                 DRAMRowOutcome outcome)
+{
+    advance(rec);
+
+    if (outcome == ROW_HIT)
+    {
+        rec->bank_hits[bank]++;
+    }
+    else if (outcome == ROW_EMPTY)
+    {
+        rec->bank_empty[bank]++;
+    }
+    else
+    {
+        rec->bank_conflicts[bank]++;
+    }
+}
+
+/**
+ * Record a finished read or write.
+ *
+ * @param rec The DRAM recorder.
+ * @param is_write Whether it was a write.
+ * @param delay Its latency in cycles.
+ */
+void dramrec_transfer(DRAMRecorder *rec, bool is_write, uint64_t delay)
+{
+    advance(rec);
+
+    if (is_write)
+    {
+        rec->writes++;
+    }
+    else
+    {
+        rec->reads++;
+        rec->read_delay += delay;
+    }
+}
+
+/**
+ * Record the number of requests queued in the memory controller this cycle.
+ *
+ * @param rec The DRAM recorder.
+ * @param queued The number of queued requests.
+ */
+void dramrec_queue(DRAMRecorder *rec, unsigned int queued)
+{
+    advance(rec);
+    rec->queue_sum += queued;
+}
+
+/**
+ * Write a command to the trace of its rank, if command traces are enabled.
+ *
+ * @param rec The DRAM recorder.
+ * @param bank The bank index (see DRAMAddr::bank_index).
+ * @param cmd The command: ACT, PRE, PREA, RD, WR, RDA, WRA, REF, or REFB.
+ */
+void dramrec_command(DRAMRecorder *rec, unsigned int bank, const char *cmd)
+{
+    if (!rec->cmd_fp)
+    {
+        return;
+    }
+
+    unsigned int banks_per_rank = rec->num_bankgroups * rec->num_banks;
+    unsigned long long clock = current_cycle;
+    if (rec->tck_ps)
+    {
+        clock = current_cycle * 1000000ULL / (rec->cpu_mhz * rec->tck_ps);
+    }
+
+    fprintf(rec->cmd_fp[bank / banks_per_rank], "%llu,%s,%u\n", clock, cmd,
+            bank % banks_per_rank);
+}
+
+/**
+ * Write the rows of the intervals up to the current cycle, including the
+ * partial last one, and close the output files.
+ *
+ * @param rec The DRAM recorder.
+ */
+void dramrec_finish(DRAMRecorder *rec)
+{
+    advance(rec);
+    if (current_cycle > rec->interval_start)
+    {
+        write_interval(rec, current_cycle);
+    }
+
+    fclose(rec->fp);
+    fclose(rec->bank_fp);
+    if (rec->cmd_fp)
+    {
+        for (unsigned int r = 0; r < rec->num_channels * rec->num_ranks; r++)
+        {
+            fclose(rec->cmd_fp[r]);
+        }
+        free(rec->cmd_fp);
+    }
+
+    free(rec->bank_hits);
+    free(rec->bank_empty);
+    free(rec->bank_conflicts);
+    free(rec);
+}
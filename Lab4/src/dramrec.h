@@ -0,0 +1,142 @@
+// dramrec.h
+// Declares the DRAM time-series and command trace recorder.
+//
+// The recorder keeps a few counters for the current interval and writes one
+// row per interval to <prefix>_dram.csv (bandwidth, row hits, empties, and
+// conflicts, queue occupancy, and read latency) and one row per bank that was
+// accessed to <prefix>_banks.csv. Recording an event is a counter increment;
+// files are only written when an interval ends.
+//
+// Optionally, the commands issued by the memory controller are written to
+// one trace per rank, <prefix>_cmd_<channel>_<rank>.trace, as lines of
+// "<clock>,<command>,<bank>" in DRAM clocks, the format read by DRAMPower.
+
+#ifndef __DRAMREC_H__
+#define __DRAMREC_H__
+
+#include "types.h"
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** How an access found its bank. */
+typedef enum DRAMRowOutcomeEnum
+{
+    ROW_HIT = 0,      // The row was open.
+    ROW_EMPTY = 1,    // No row was open.
+    ROW_CONFLICT = 2, // Another row was open and had to be closed.
+} DRAMRowOutcome;
+
+/** The DRAM recorder. */
+typedef struct DRAMRecorder
+{
+    /** The interval time series and the per-bank time series. */
+    FILE *fp;
+    FILE *bank_fp;
+    /** The command trace of each rank, channel-major, or NULL if disabled. */
+    FILE **cmd_fp;
+
+    /** The DRAM organisation, to label the banks. */
+    unsigned int num_channels;
+    unsigned int num_ranks;
+    unsigned int num_bankgroups;
+    unsigned int num_banks;
+    unsigned int total_banks;
+
+    /** The bytes per access, for the bandwidth. */
+    uint64_t line_size;
+    /** The CPU clock in MHz and the DRAM clock period in picoseconds (0 if
+     *  DRAM timings are in CPU cycles), to convert cycles. */
+    uint64_t cpu_mhz;
+    uint64_t tck_ps;
+
+    /** The length of an interval, and the cycles the current one spans. */
+    uint64_t interval;
+    uint64_t interval_start;
+    uint64_t interval_end;
+
+    /** The counters of the current interval. */
+    unsigned long long reads;
+    unsigned long long writes;
+    uint64_t read_delay;
+    unsigned long long *bank_hits;
+    unsigned long long *bank_empty;
+    unsigned long long *bank_conflicts;
+    /** The sum over cycles of the number of queued requests. */
+    uint64_t queue_sum;
+} DRAMRecorder;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate a DRAM recorder and create its output files.
+ *
+ * @param prefix The prefix of the output file names.
+ * @param interval The number of cycles per row of the time series.
+ * @param cmd_trace Whether to also write command traces.
+ * @param num_channels The number of DRAM channels.
+ * @param num_ranks The number of ranks per channel.
+ * @param num_bankgroups The number of bank groups per rank.
+ * @param num_banks The number of banks per bank group.
+ * @param line_size The number of bytes per access.
+ * @param cpu_mhz The CPU clock in MHz.
+ * @param tck_ps The DRAM clock period in picoseconds, or 0 to write command
+ *               times in CPU cycles.
+ * @return A pointer to the recorder, or NULL if the files can't be created.
+ */
+DRAMRecorder *dramrec_new(const char *prefix, uint64_t interval,
+                          bool cmd_trace, unsigned int num_channels,
+                          unsigned int num_ranks, unsigned int num_bankgroups,
+                          unsigned int num_banks, uint64_t line_size,
+                          uint64_t cpu_mhz, uint64_t tck_ps);
+
+/**
+ * Record how an access found its bank.
+ *
+ * @param rec The DRAM recorder.
+ * @param bank The bank index (see DRAMAddr::bank_index).
+ * @param outcome Whether the access hit the open row, found the bank empty,
+ *                or had to close another row.
+ */
+void dramrec_row(DRAMRecorder *rec, unsigned int bank,
+                 DRAMRowOutcome outcome);
+
+/**
+ * Record a finished read or write.
+ *
+ * @param rec The DRAM recorder.
+ * @param is_write Whether it was a write.
+ * @param delay Its latency in cycles.
+ */
+void dramrec_transfer(DRAMRecorder *rec, bool is_write, uint64_t delay);
+
+/**
+ * Record the number of requests queued in the memory controller this cycle.
+ *
+ * @param rec The DRAM recorder.
+ * @param queued The number of queued requests.
+ */
+void dramrec_queue(DRAMRecorder *rec, unsigned int queued);
+
+/**
+ * Write a command to the trace of its rank, if command traces are enabled.
+ *
+ * @param rec The DRAM recorder.
+ * @param bank The bank index (see DRAMAddr::bank_index).
+ * @param cmd The command: ACT, PRE, PREA, RD, WR, RDA, WRA, REF, or REFB.
+ */
+void dramrec_command(DRAMRecorder *rec, unsigned int bank, const char *cmd);
+
+/**
+ * Write the rows of the intervals up to the current cycle, including the
+ * partial last one, and close the output files.
+ *
+ * @param rec The DRAM recorder.
+ */
+void dramrec_finish(DRAMRecorder *rec);
+
+#endif // __DRAMREC_H__
@@ -0,0 +1,121 @@
+// eventq.cpp
+// Defines the queue of core wake-up events used by the simulation loop.
+
+#include "eventq.h"
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Whether event a comes before event b. */
+static inline bool event_before(const Event *a, const Event *b)
+{
+    return a->cycle < b->cycle || (a->cycle == b->cycle && a->id < b->id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate an empty event queue.
+ *
+ * @param capacity The largest number of events queued at once.
+ * @return A pointer to the event queue.
+ */
+EventQueue *eventq_new(unsigned int capacity)
+{
+    EventQueue *q = (EventQueue *)calloc(1, sizeof(EventQueue));
+    q->heap = (Event *)calloc(capacity ? capacity : 1, sizeof(Event));
+    q->capacity = capacity;
+    return q;
+}
+
+/**
+ * Queue an event.
+ *
+ * @param q The event queue. Must not be full.
+ * @param cycle The cycle of the event.
+ * @param id The ID of what the event wakes up, e.g., the core ID.
+ */
+void eventq_push(EventQueue *q, uint64_t cycle, unsigned int id)
+{
+    Event ev = {cycle, id};
+    unsigned int i = q->size++;
+
+    // Sift the new event up from the bottom.
+    while (i > 0)
+    {
+        unsigned int parent = (i - 1) / 2;
+        if (!event_before(&ev, &q->heap[parent]))
+        {
+            break;
+        }
+        q->heap[i] = q->heap[parent];
+        i = parent;
+    }
+    q->heap[i] = ev;
+}
+
+/**
+ * Return the cycle of the earliest event.
+ *
+ * @param q The event queue.
+ * @return The cycle of the earliest event, or UINT64_MAX if there is none.
+ */
+uint64_t eventq_next_cycle(EventQueue *q)
+{
+    return q->size ? q->heap[0].cycle : UINT64_MAX;
+}
+
+/**
+ * Remove the earliest event.
+ *
+ * @param q The event queue. Must not be empty.
+ * @return The ID of the event.
+ */
+unsigned int eventq_pop(EventQueue *q)
+{
+    unsigned int id = q->heap[0].id;
+    Event last = q->heap[--q->size];
+    unsigned int i = 0;
+
+    // Sift the last event down from the top.
+    while (true)
+    {
+        unsigned int child = 2 * i + 1;
+        if (child >= q->size)
+        {
+            break;
+        }
+        if (child + 1 < q->size &&
+            event_before(&q->heap[child + 1], &q->heap[child]))
+        {
+            child++;
+        }
+        if (!event_before(&q->heap[child], &last))
+        {
+            break;
+        }
+        q->heap[i] = q->heap[child];
+        i = child;
+    }
+    if (q->size)
+    {
+        q->heap[i] = last;
+    }
+
+    return id;
+}
+
+/**
+ * Free an event queue.
+ *
+ * @param q The event queue.
+ */
+void eventq_free(EventQueue *q)
+{
+    free(q->heap);
+    free(q);
+}
@@ -0,0 +1,79 @@
+// eventq.h
+// Declares the queue of core wake-up events used by the simulation loop.
+//
+// Each core that isn't done has one event: the next cycle at which
+// core_cycle() may do anything. The events are kept in a binary min-heap
+// ordered by cycle and then by core ID, so that the cores waking up in the
+// same cycle still run in the order of their IDs and the loop can jump
+// straight over the cycles in which every core is snoozing.
+
+#ifndef __EVENTQ_H__
+#define __EVENTQ_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A core wake-up. */
+typedef struct Event
+{
+    uint64_t cycle;
+    unsigned int id;
+} Event;
+
+/** The event queue. */
+typedef struct EventQueue
+{
+    /** The heap of events, earliest at index 0. */
+    Event *heap;
+    unsigned int size;
+    unsigned int capacity;
+} EventQueue;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate an empty event queue.
+ *
+ * @param capacity The largest number of events queued at once.
+ * @return A pointer to the event queue.
+ */
+EventQueue *eventq_new(unsigned int capacity);
+
+/**
+ * Queue an event.
+ *
+ * @param q The event queue. Must not be full.
+ * @param cycle The cycle of the event.
+ * @param id The ID of what the event wakes up, e.g., the core ID.
+ */
+void eventq_push(EventQueue *q, uint64_t cycle, unsigned int id);
+
+/**
+ * Return the cycle of the earliest event.
+ *
+ * @param q The event queue.
+ * @return The cycle of the earliest event, or UINT64_MAX if there is none.
+ */
+uint64_t eventq_next_cycle(EventQueue *q);
+
+/**
+ * Remove the earliest event.
+ *
+ * @param q The event queue. Must not be empty.
+ * @return The ID of the event.
+ */
+unsigned int eventq_pop(EventQueue *q);
+
+/**
+ * Free an event queue.
+ *
+ * @param q The event queue.
+ */
+void eventq_free(EventQueue *q);
+
+#endif // __EVENTQ_H__
@@ -0,0 +1,166 @@
+// heatmap.cpp
+// Defines the per-set and per-page miss heatmap recorder.
+
+#include "heatmap.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate a heatmap recorder and create its output files,
+ * <prefix>_sets.csv and <prefix>_pages.csv.
+ *
+ * @param prefix The prefix of the output file names.
+ * @param interval The number of cycles between dumps, or 0 to dump only at
+ *                 the end of the run.
+ * @return A pointer to the recorder. Exits with an error if the files can't
+ *         be created.
+ */
+Heatmap *heatmap_new(const char *prefix, uint64_t interval)
+{
+    size_t name_len = strlen(prefix) + 16;
+    char *name = (char *)malloc(name_len);
+
+    snprintf(name, name_len, "%s_sets.csv", prefix);
+    FILE *set_fp = fopen(name, "w");
+    if (!set_fp)
+    {
+        fprintf(stderr, "Error: couldn't create heatmap file %s: %s\n", name,
+                strerror(errno));
+        exit(1);
+    }
+
+    snprintf(name, name_len, "%s_pages.csv", prefix);
+    FILE *page_fp = fopen(name, "w");
+    if (!page_fp)
+    {
+        fprintf(stderr, "Error: couldn't create heatmap file %s: %s\n", name,
+                strerror(errno));
+        exit(1);
+    }
+    free(name);
+
+    fprintf(set_fp, "cycle,cache,set,access,miss,evict\n");
+    fprintf(page_fp, "cycle,page,miss\n");
+
+    Heatmap *hm = (Heatmap *)calloc(1, sizeof(Heatmap));
+    hm->page_miss = (uint32_t **)calloc(
+        HEATMAP_MAX_PAGES / HEATMAP_CHUNK_PAGES, sizeof(uint32_t *));
+    hm->set_fp = set_fp;
+    hm->page_fp = page_fp;
+    hm->interval = interval;
+    hm->next_dump_cycle = interval;
+    return hm;
+}
+
+/**
+ * Record a miss to the given byte address.
+ *
+ * @param hm The heatmap recorder.
+ * @param addr The byte address that missed.
+ */
+void heatmap_record_miss(Heatmap *hm, uint64_t addr)
+{
+    uint64_t page = addr / HEATMAP_PAGE_SIZE;
+    if (page >= HEATMAP_MAX_PAGES)
+    {
+        hm->other_miss++;
+        return;
+    }
+
+    uint32_t **chunk = &hm->page_miss[page / HEATMAP_CHUNK_PAGES];
+    if (!*chunk)
+    {
+        *chunk = (uint32_t *)calloc(HEATMAP_CHUNK_PAGES, sizeof(uint32_t));
+    }
+    (*chunk)[page % HEATMAP_CHUNK_PAGES]++;
+}
+
+/**
+ * Append the current counters of the given caches and of every page that has
+ * missed to the output files. Counts are cumulative since the start of the
+ * run, and each row is tagged with the current cycle.
+ *
+ * @param hm The heatmap recorder.
+ * @param caches The caches whose per-set counters are dumped.
+ * @param labels A label for each cache, printed in the cache column.
+ * @param num_caches The number of caches.
+ */
+void heatmap_dump(Heatmap *hm, Cache **caches, const char **labels,
+                  unsigned int num_caches)
+{
+    unsigned long long cycle = current_cycle;
+
+    for (unsigned int i = 0; i < num_caches; i++)
+    {
+        Cache *c = caches[i];
+        if (!c || !c->stat_set_access)
+        {
+            continue;
+        }
+
+        for (uint64_t set = 0; set < c->num_sets; set++)
+        {
+            fprintf(hm->set_fp, "%llu,%s,%llu,%llu,%llu,%llu\n", cycle,
+                    labels[i], (unsigned long long)set,
+                    c->stat_set_access[set], c->stat_set_miss[set],
+                    c->stat_set_evict[set]);
+        }
+    }
+
+    for (uint64_t chunk = 0; chunk < HEATMAP_MAX_PAGES / HEATMAP_CHUNK_PAGES;
+         chunk++)
+    {
+        if (!hm->page_miss[chunk])
+        {
+            continue;
+        }
+
+        for (uint64_t i = 0; i < HEATMAP_CHUNK_PAGES; i++)
+        {
+            if (hm->page_miss[chunk][i])
+            {
+                fprintf(hm->page_fp, "%llu,%llu,%u\n", cycle,
+                        (unsigned long long)(chunk * HEATMAP_CHUNK_PAGES + i),
+                        hm->page_miss[chunk][i]);
+            }
+        }
+    }
+
+    if (hm->other_miss)
+    {
+        fprintf(hm->page_fp, "%llu,other,%llu\n", cycle, hm->other_miss);
+    }
+
+    fflush(hm->set_fp);
+    fflush(hm->page_fp);
+}
+
+/**
+ * Close the output files of a heatmap recorder and free it.
+ *
+ * @param hm The heatmap recorder.
+ */
+void heatmap_free(Heatmap *hm)
+{
+    for (uint64_t chunk = 0; chunk < HEATMAP_MAX_PAGES / HEATMAP_CHUNK_PAGES;
+         chunk++)
+    {
+        free(hm->page_miss[chunk]);
+    }
+    free(hm->page_miss);
+    fclose(hm->set_fp);
+    fclose(hm->page_fp);
+    free(hm);
+}
@@ -0,0 +1,100 @@
+// heatmap.h
+// Declares the per-set and per-page miss heatmap recorder.
+//
+// The per-set counters live in each Cache (see cache_enable_set_stats()) and
+// are indexed directly by set. The per-page miss counters are kept here in a
+// two-level table indexed by page number, whose second-level chunks are only
+// allocated for pages that actually miss. Nothing is hashed, so recording an
+// access is a couple of array increments.
+
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include "types.h"
+#include "cache.h"
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of bytes in a page tracked by the page heatmap. */
+#define HEATMAP_PAGE_SIZE 4096
+
+/** The number of pages in each second-level chunk of the page table. */
+#define HEATMAP_CHUNK_PAGES 1024
+
+/**
+ * The number of page numbers tracked individually. This covers the physical
+ * addresses produced in mode 4; misses to pages beyond it are lumped together.
+ */
+#define HEATMAP_MAX_PAGES (1 << 22)
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The heatmap recorder. */
+typedef struct Heatmap
+{
+    /** Miss counts per page, in chunks of HEATMAP_CHUNK_PAGES (NULL if none). */
+    uint32_t **page_miss;
+    /** Misses to pages at or beyond HEATMAP_MAX_PAGES. */
+    unsigned long long other_miss;
+
+    /** The output file for the per-set counters. */
+    FILE *set_fp;
+    /** The output file for the per-page counters. */
+    FILE *page_fp;
+
+    /** The number of cycles between dumps, or 0 to dump only at the end. */
+    uint64_t interval;
+    /** The cycle at or after which the next interval dump is due. */
+    uint64_t next_dump_cycle;
+} Heatmap;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate a heatmap recorder and create its output files,
+ * <prefix>_sets.csv and <prefix>_pages.csv.
+ *
+ * @param prefix The prefix of the output file names.
+ * @param interval The number of cycles between dumps, or 0 to dump only at
+ *                 the end of the run.
+ * @return A pointer to the recorder. Exits with an error if the files can't
+ *         be created.
+ */
+Heatmap *heatmap_new(const char *prefix, uint64_t interval);
+
+/**
+ * Record a miss to the given byte address.
+ *
+ * @param hm The heatmap recorder.
+ * @param addr The byte address that missed.
+ */
+void heatmap_record_miss(Heatmap *hm, uint64_t addr);
+
+/**
+ * Append the current counters of the given caches and of every page that has
+ * missed to the output files. Counts are cumulative since the start of the
+ * run, and each row is tagged with the current cycle.
+ *
+ * @param hm The heatmap recorder.
+ * @param caches The caches whose per-set counters are dumped.
+ * @param labels A label for each cache, printed in the cache column.
+ * @param num_caches The number of caches.
+ */
+void heatmap_dump(Heatmap *hm, Cache **caches, const char **labels,
+                  unsigned int num_caches);
+
+/**
+ * Close the output files of a heatmap recorder and free it.
+ *
+ * @param hm The heatmap recorder.
+ */
+void heatmap_free(Heatmap *hm);
+
+#endif // __HEATMAP_H__
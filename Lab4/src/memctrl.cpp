@@ -0,0 +1,1328 @@
+// memctrl.cpp
+// Defines the queue-based DRAM memory controller.
+
+#include "memctrl.h"
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The initial number of requests in the pool. It grows as needed. */
+#define MEMCTRL_INITIAL_REQS 64
+
+/** For PAR-BS, the most reads of one core in one bank that join a batch. */
+#define PARBS_MARKING_CAP 5
+
+/** For ATLAS and TCM, the length of a quantum, in cycles. */
+#define SCHED_QUANTUM 100000
+
+/** For ATLAS, the weight of past quanta in the attained service. */
+#define ATLAS_HISTORY_WEIGHT 0.875
+
+/** For ATLAS, the age in cycles past which a request goes before others. */
+#define ATLAS_AGE_THRESHOLD 100000
+
+/** For TCM, the share of the total service the latency-sensitive cluster
+ *  may use. */
+#define TCM_CLUSTER_THRESH 0.2
+
+/** For TCM, the cycles between rotations of the other cluster's order. */
+#define TCM_SHUFFLE_INTERVAL 800
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The DRAM commands the controller issues. */
+typedef enum DRAMCommandEnum
+{
+    CMD_NONE = 0,
+    CMD_ACT = 1,
+    CMD_PRE = 2,
+    CMD_COL = 3, // RD or WR, depending on the request.
+} DRAMCommand;
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Which page policy the DRAM should use. */
+extern thread_local DRAMPolicy DRAM_PAGE_POLICY;
+
+/** How the DRAM is refreshed. */
+extern thread_local DRAMRefresh DRAM_REFRESH;
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t later(uint64_t a, uint64_t b)
+{
+    return a > b ? a : b;
+}
+
+static inline RankState *rank_of(MemController *mc, DRAMAddr *loc)
+{
+    return &mc->ranks[loc->channel * mc->dram->num_ranks + loc->rank];
+}
+
+static inline void record_command(MemController *mc, unsigned int bank,
+                                  const char *cmd)
+{
+    if (mc->dram->rec)
+    {
+        dramrec_command(mc->dram->rec, bank, cmd);
+    }
+}
+
+/** Take a request from the pool, growing it if it is empty. */
+static int alloc_request(MemController *mc)
+{
+    if (mc->free_head < 0)
+    {
+        unsigned int old = mc->num_reqs;
+        mc->num_reqs *= 2;
+        mc->reqs = (DRAMRequest *)realloc(mc->reqs,
+                                          mc->num_reqs * sizeof(DRAMRequest));
+        for (unsigned int i = old; i < mc->num_reqs; i++)
+        {
+            mc->reqs[i].next = (i + 1 < mc->num_reqs) ? (int)(i + 1) : -1;
+        }
+        mc->free_head = old;
+    }
+
+    int r = mc->free_head;
+    mc->free_head = mc->reqs[r].next;
+    return r;
+}
+
+static void free_request(MemController *mc, int r)
+{
+    mc->reqs[r].next = mc->free_head;
+    mc->free_head = r;
+}
+
+/**
+ * Whether a request of the bank in the given queues (indices of their
+ * heads, or -1 to skip one) hits its open row.
+ */
+static bool bank_has_row_hit(MemController *mc, unsigned int bank,
+                             const int heads[2])
+{
+    RowBufferEntry *row = &mc->dram->RowBuffer[bank];
+
+    for (int q = 0; q < 2; q++)
+    {
+        for (int r = heads[q]; r >= 0; r = mc->reqs[r].next)
+        {
+            if (mc->reqs[r].arrival_cycle <= current_cycle &&
+                mc->reqs[r].loc.row == row->RowID)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Return the command the request needs next, or CMD_NONE if that command
+ * can't be issued this cycle.
+ */
+static DRAMCommand ready_command(MemController *mc, DRAMRequest *req,
+                                 bool bank_hit)
+{
+    DRAMTiming *t = &mc->dram->timing;
+    unsigned int bank = req->loc.bank_index;
+    BankState *bs = &mc->banks[bank];
+    RankState *rk = rank_of(mc, &req->loc);
+    RowBufferEntry *row = &mc->dram->RowBuffer[bank];
+    unsigned int bg = req->loc.bankgroup;
+
+    if (!row->valid)
+    {
+        uint64_t ready = later(later(bs->next_act, rk->next_act),
+                               later(rk->bg_next_act[bg],
+                                     rk->act_window[rk->act_window_pos]));
+        return current_cycle >= ready ? CMD_ACT : CMD_NONE;
+    }
+
+    if (row->RowID == req->loc.row)
+    {
+        ChannelState *ch = &mc->channels[req->loc.channel];
+        uint64_t ready = req->is_write
+                             ? later(later(bs->next_wr, rk->next_wr),
+                                     ch->next_wr)
+                             : later(bs->next_rd, rk->next_rd);
+        ready = later(ready, rk->bg_next_col[bg]);
+
+        // The data transfer must not overlap the previous one on the bus.
+        uint64_t latency = req->is_write ? t->tCWL : t->tCL;
+        bool bus_ready = ch->bus_free <= current_cycle + latency;
+        return (current_cycle >= ready && bus_ready) ? CMD_COL : CMD_NONE;
+    }
+
+    // Don't close a row that queued requests still hit.
+    return (current_cycle >= bs->next_pre && !bank_hit) ? CMD_PRE : CMD_NONE;
+}
+
+/**
+ * Whether request a should be served before request b under FR-FCFS: column
+ * commands (row hits) first, then reads before writes, then the oldest.
+ */
+static bool frfcfs_before(DRAMRequest *a, DRAMCommand a_cmd, DRAMRequest *b,
+                          DRAMCommand b_cmd)
+{
+    if ((a_cmd == CMD_COL) != (b_cmd == CMD_COL))
+    {
+        return a_cmd == CMD_COL;
+    }
+    if (a->is_write != b->is_write)
+    {
+        return !a->is_write;
+    }
+    return a->arrival_cycle < b->arrival_cycle;
+}
+
+/**
+ * Whether request a should be served before request b under the
+ * application-aware schedulers, or FR-FCFS otherwise.
+ */
+static bool sched_before(MemController *mc, DRAMRequest *a, DRAMCommand a_cmd,
+                         DRAMRequest *b, DRAMCommand b_cmd)
+{
+    bool a_hit = a_cmd == CMD_COL;
+    bool b_hit = b_cmd == CMD_COL;
+    unsigned int a_rank = mc->cores[a->core_id].rank;
+    unsigned int b_rank = mc->cores[b->core_id].rank;
+
+    switch (mc->sched)
+    {
+    case SCHED_PARBS:
+        // The batch first, then row hits, then the shortest job.
+        if (a->marked != b->marked)
+        {
+            return a->marked;
+        }
+        if (a_hit != b_hit)
+        {
+            return a_hit;
+        }
+        if (a_rank != b_rank)
+        {
+            return a_rank < b_rank;
+        }
+        break;
+
+    case SCHED_ATLAS:
+    {
+        // Requests that have waited too long first, then the least attained
+        // service, then row hits.
+        bool a_old = current_cycle - a->arrival_cycle > ATLAS_AGE_THRESHOLD;
+        bool b_old = current_cycle - b->arrival_cycle > ATLAS_AGE_THRESHOLD;
+        if (a_old != b_old)
+        {
+            return a_old;
+        }
+        if (a_rank != b_rank)
+        {
+            return a_rank < b_rank;
+        }
+        if (a_hit != b_hit)
+        {
+            return a_hit;
+        }
+        break;
+    }
+
+    case SCHED_TCM:
+        if (a_rank != b_rank)
+        {
+            return a_rank < b_rank;
+        }
+        if (a_hit != b_hit)
+        {
+            return a_hit;
+        }
+        break;
+
+    default:
+        return frfcfs_before(a, a_cmd, b, b_cmd);
+    }
+
+    return a->arrival_cycle < b->arrival_cycle;
+}
+
+/**
+ * Charge the given cycles of interference to each core, other than core_id,
+ * that has a core waiting on an arrived read in banks [first, first + count).
+ */
+static void charge_interference(MemController *mc, unsigned int first,
+                                unsigned int count, unsigned int core_id,
+                                uint64_t cycles)
+{
+    if (mc->num_cores < 2)
+    {
+        return;
+    }
+
+    for (unsigned int c = 0; c < mc->num_cores; c++)
+    {
+        mc->cores[c].seen = false;
+    }
+
+    for (unsigned int bank = first; bank < first + count; bank++)
+    {
+        for (int r = mc->banks[bank].read_head; r >= 0; r = mc->reqs[r].next)
+        {
+            DRAMRequest *req = &mc->reqs[r];
+            CoreSchedState *cs = &mc->cores[req->core_id];
+            if (req->core_id != core_id && req->wait && !cs->seen &&
+                req->arrival_cycle <= current_cycle)
+            {
+                cs->seen = true;
+                cs->interference += cycles;
+            }
+        }
+    }
+}
+
+/** Give each core its position in the TCM order as its rank. */
+static void tcm_assign_ranks(MemController *mc)
+{
+    for (unsigned int i = 0; i < mc->num_cores; i++)
+    {
+        mc->cores[mc->tcm_order[i]].rank = i;
+    }
+}
+
+/**
+ * For TCM, split the cores into clusters by their use of the DRAM in the
+ * quantum that ended: the least intensive cores whose service together stays
+ * under TCM_CLUSTER_THRESH of the total go first, least intensive first.
+ */
+static void tcm_cluster(MemController *mc)
+{
+    unsigned int n = mc->num_cores;
+    uint64_t total = 0;
+
+    for (unsigned int a = 0; a < n; a++)
+    {
+        CoreSchedState *ca = &mc->cores[a];
+        unsigned int pos = 0;
+        for (unsigned int b = 0; b < n; b++)
+        {
+            CoreSchedState *cb = &mc->cores[b];
+            pos += cb->reads < ca->reads || (cb->reads == ca->reads && b < a);
+        }
+        mc->tcm_order[pos] = a;
+        total += ca->service;
+    }
+
+    uint64_t used = 0;
+    mc->tcm_num_lat = 0;
+    while (mc->tcm_num_lat < n)
+    {
+        used += mc->cores[mc->tcm_order[mc->tcm_num_lat]].service;
+        if ((double)used > TCM_CLUSTER_THRESH * (double)total)
+        {
+            break;
+        }
+        mc->tcm_num_lat++;
+    }
+
+    tcm_assign_ranks(mc);
+}
+
+/** For TCM, rotate the order of the cores outside the latency cluster. */
+static void tcm_shuffle(MemController *mc)
+{
+    unsigned int first = mc->tcm_num_lat;
+    unsigned int n = mc->num_cores;
+    if (n - first < 2)
+    {
+        return;
+    }
+
+    unsigned int head = mc->tcm_order[first];
+    for (unsigned int i = first; i + 1 < n; i++)
+    {
+        mc->tcm_order[i] = mc->tcm_order[i + 1];
+    }
+    mc->tcm_order[n - 1] = head;
+
+    tcm_assign_ranks(mc);
+}
+
+/** For ATLAS and TCM, re-rank the cores at the end of a quantum. */
+static void end_quantum(MemController *mc)
+{
+    unsigned int n = mc->num_cores;
+
+    if (mc->sched == SCHED_ATLAS)
+    {
+        for (unsigned int c = 0; c < n; c++)
+        {
+            CoreSchedState *cs = &mc->cores[c];
+            cs->attained = ATLAS_HISTORY_WEIGHT * cs->attained +
+                           (1.0 - ATLAS_HISTORY_WEIGHT) * (double)cs->service;
+        }
+
+        // The least attained service goes first.
+        for (unsigned int a = 0; a < n; a++)
+        {
+            CoreSchedState *ca = &mc->cores[a];
+            ca->rank = 0;
+            for (unsigned int b = 0; b < n; b++)
+            {
+                CoreSchedState *cb = &mc->cores[b];
+                ca->rank += cb->attained < ca->attained ||
+                            (cb->attained == ca->attained && b < a);
+            }
+        }
+    }
+    else
+    {
+        tcm_cluster(mc);
+    }
+
+    for (unsigned int c = 0; c < n; c++)
+    {
+        mc->cores[c].service = 0;
+        mc->cores[c].reads = 0;
+    }
+}
+
+/**
+ * For PAR-BS, mark the oldest arrived reads of each core in each bank, up to
+ * PARBS_MARKING_CAP, as a new batch. Within the batch, the cores with the
+ * fewest marked reads in any one bank, then in total, go first.
+ */
+static void form_batch(MemController *mc)
+{
+    unsigned int n = mc->num_cores;
+
+    for (unsigned int c = 0; c < n; c++)
+    {
+        mc->cores[c].batch_max = 0;
+        mc->cores[c].batch_total = 0;
+    }
+
+    for (unsigned int bank = 0; bank < mc->dram->total_banks; bank++)
+    {
+        if (mc->banks[bank].read_head < 0)
+        {
+            continue;
+        }
+
+        for (unsigned int c = 0; c < n; c++)
+        {
+            mc->cores[c].batch_bank = 0;
+        }
+
+        for (int r = mc->banks[bank].read_head; r >= 0; r = mc->reqs[r].next)
+        {
+            DRAMRequest *req = &mc->reqs[r];
+            CoreSchedState *cs = &mc->cores[req->core_id];
+            if (req->arrival_cycle <= current_cycle &&
+                cs->batch_bank < PARBS_MARKING_CAP)
+            {
+                req->marked = true;
+                cs->batch_bank++;
+                cs->batch_total++;
+                mc->num_marked++;
+            }
+        }
+
+        for (unsigned int c = 0; c < n; c++)
+        {
+            CoreSchedState *cs = &mc->cores[c];
+            if (cs->batch_bank > cs->batch_max)
+            {
+                cs->batch_max = cs->batch_bank;
+            }
+        }
+    }
+
+    if (mc->num_marked == 0)
+    {
+        return;
+    }
+    mc->stat_batches++;
+
+    for (unsigned int a = 0; a < n; a++)
+    {
+        CoreSchedState *ca = &mc->cores[a];
+        ca->rank = 0;
+        for (unsigned int b = 0; b < n; b++)
+        {
+            CoreSchedState *cb = &mc->cores[b];
+            ca->rank += cb->batch_max < ca->batch_max ||
+                        (cb->batch_max == ca->batch_max &&
+                         (cb->batch_total < ca->batch_total ||
+                          (cb->batch_total == ca->batch_total && b < a)));
+        }
+    }
+}
+
+/**
+ * Refresh the banks of the given refresh unit: close their rows as soon as
+ * they allow it, then keep them from being activated for the refresh.
+ */
+static void refresh_banks(MemController *mc, unsigned int unit)
+{
+    DRAM *dram = mc->dram;
+    unsigned int first = unit * dram->refresh_banks;
+    uint64_t start = current_cycle;
+
+    for (unsigned int bank = first; bank < first + dram->refresh_banks;
+         bank++)
+    {
+        BankState *bs = &mc->banks[bank];
+        if (dram->RowBuffer[bank].valid)
+        {
+            start = later(start, bs->next_pre + dram->timing.tRP);
+        }
+        else
+        {
+            start = later(start, bs->next_act);
+        }
+    }
+
+    uint64_t end = start + dram->refresh_cycles;
+    bool any_open = false;
+    for (unsigned int bank = first; bank < first + dram->refresh_banks;
+         bank++)
+    {
+        BankState *bs = &mc->banks[bank];
+        RowBufferEntry *row = &dram->RowBuffer[bank];
+        if (row->valid)
+        {
+            any_open = true;
+            row->valid = false;
+            bs->refresh_closed = true;
+            bs->refresh_closed_row = row->RowID;
+        }
+        bs->next_act = later(bs->next_act, end);
+        bs->refresh_start = current_cycle;
+        bs->refresh_end = end;
+    }
+
+    if (dram->refresh_banks > 1)
+    {
+        if (any_open)
+        {
+            record_command(mc, first, "PREA");
+        }
+        record_command(mc, first, "REF");
+    }
+    else
+    {
+        if (any_open)
+        {
+            record_command(mc, first, "PRE");
+        }
+        record_command(mc, first, "REFB");
+    }
+}
+
+/** Issue the refreshes that are due. */
+static void refresh_due_units(MemController *mc)
+{
+    DRAM *dram = mc->dram;
+    mc->refresh_next = UINT64_MAX;
+
+    for (unsigned int u = 0; u < dram->refresh_units; u++)
+    {
+        if (current_cycle >= mc->refresh_due[u])
+        {
+            refresh_banks(mc, u);
+            mc->refresh_due[u] += dram->timing.tREFI;
+        }
+        mc->refresh_next = std::min(mc->refresh_next, mc->refresh_due[u]);
+    }
+}
+
+/**
+ * Charge the time the request spent waiting for a refresh of its bank, and
+ * for reads, the activation of a row the refresh closed, to the DRAM's
+ * refresh statistics.
+ */
+static void charge_refresh(MemController *mc, DRAMRequest *req,
+                           DRAMCommand cmd)
+{
+    BankState *bs = &mc->banks[req->loc.bank_index];
+    DRAM *dram = mc->dram;
+    uint64_t delay = 0;
+
+    if (!req->started)
+    {
+        uint64_t from = later(req->arrival_cycle, bs->refresh_start);
+        uint64_t to = std::min(current_cycle, bs->refresh_end);
+        if (to > from)
+        {
+            delay = to - from;
+            dram->stat_refresh_blocked += delay;
+        }
+    }
+
+    if (cmd == CMD_ACT)
+    {
+        if (bs->refresh_closed && bs->refresh_closed_row == req->loc.row)
+        {
+            delay += dram->timing.tRCD;
+        }
+        bs->refresh_closed = false;
+    }
+
+    if (!req->is_write)
+    {
+        dram->stat_refresh_read_delay += delay;
+    }
+}
+
+/** Remove request r, which follows prev (-1 if none), from its bank queue. */
+static void unlink_request(MemController *mc, int r, int prev)
+{
+    DRAMRequest *req = &mc->reqs[r];
+    BankState *bs = &mc->banks[req->loc.bank_index];
+    int *head = req->is_write ? &bs->write_head : &bs->read_head;
+    int *tail = req->is_write ? &bs->write_tail : &bs->read_tail;
+
+    if (prev < 0)
+    {
+        *head = req->next;
+    }
+    else
+    {
+        mc->reqs[prev].next = req->next;
+    }
+    if (*tail == r)
+    {
+        *tail = prev;
+    }
+
+    ChannelState *ch = &mc->channels[req->loc.channel];
+    ch->num_queued--;
+    mc->total_queued--;
+
+    if (req->marked)
+    {
+        req->marked = false;
+        mc->num_marked--;
+    }
+
+    if (req->is_write)
+    {
+        ch->num_writes--;
+        if (ch->draining && ch->num_writes <= mc->wq_low)
+        {
+            ch->draining = false;
+            mc->stat_drain_cycles += current_cycle - ch->drain_start;
+        }
+    }
+}
+
+/** Issue the given command for request r, which follows prev in its queue. */
+static void issue_command(MemController *mc, int r, int prev, DRAMCommand cmd)
+{
+    DRAMTiming *t = &mc->dram->timing;
+    DRAMRequest *req = &mc->reqs[r];
+    unsigned int bank = req->loc.bank_index;
+    BankState *bs = &mc->banks[bank];
+    RankState *rk = rank_of(mc, &req->loc);
+    RowBufferEntry *row = &mc->dram->RowBuffer[bank];
+    unsigned int bg = req->loc.bankgroup;
+    uint64_t now = current_cycle;
+
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        charge_refresh(mc, req, cmd);
+    }
+
+    if (!req->started)
+    {
+        mc->stat_queue_delay += now - req->arrival_cycle;
+        req->started = true;
+        req->start_cycle = now;
+    }
+
+    if (cmd == CMD_ACT)
+    {
+        row->valid = true;
+        row->RowID = req->loc.row;
+        bs->next_rd = now + t->tRCD;
+        bs->next_wr = now + t->tRCD;
+        bs->next_pre = later(bs->next_pre, now + t->tRAS);
+        bs->next_act = later(bs->next_act, now + t->tRC);
+        rk->next_act = later(rk->next_act, now + t->tRRD_S);
+        rk->bg_next_act[bg] = later(rk->bg_next_act[bg], now + t->tRRD_L);
+        rk->act_window[rk->act_window_pos] = now + t->tFAW;
+        rk->act_window_pos = (rk->act_window_pos + 1) % 4;
+        bs->row_core = req->core_id;
+        req->needed_act = true;
+        mc->stat_act++;
+        record_command(mc, bank, "ACT");
+        charge_interference(mc, bank, 1, req->core_id, t->tRCD);
+        return;
+    }
+
+    if (cmd == CMD_PRE)
+    {
+        row->valid = false;
+        bs->next_act = later(bs->next_act, now + t->tRP);
+        req->needed_pre = true;
+        mc->stat_pre++;
+        record_command(mc, bank, "PRE");
+        if (bs->row_core != req->core_id)
+        {
+            // Alone, the core would not have found another core's row here.
+            mc->cores[req->core_id].interference += t->tRP;
+        }
+        charge_interference(mc, bank, 1, req->core_id, t->tRP);
+        return;
+    }
+
+    // RD or WR: the data is on the bus tCL or tCWL cycles from now.
+    ChannelState *ch = &mc->channels[req->loc.channel];
+    if (ch->bus_free && ch->bus_write != req->is_write)
+    {
+        mc->stat_turnarounds++;
+    }
+    ch->bus_write = req->is_write;
+
+    if (req->is_write)
+    {
+        req->done_cycle = now + t->tCWL + t->tBURST;
+        bs->next_pre = later(bs->next_pre, req->done_cycle + t->tWR);
+        rk->next_rd = later(rk->next_rd, req->done_cycle + t->tWTR);
+    }
+    else
+    {
+        req->done_cycle = now + t->tCL + t->tBURST;
+        bs->next_pre = later(bs->next_pre, now + t->tRTP);
+        rk->next_rd = later(rk->next_rd, now + t->tCCD_S);
+        ch->next_wr = later(ch->next_wr, now + t->tRTW);
+    }
+    rk->next_wr = later(rk->next_wr, now + t->tCCD_S);
+    rk->bg_next_col[bg] = later(rk->bg_next_col[bg], now + t->tCCD_L);
+    ch->bus_free = req->done_cycle;
+
+    CoreSchedState *cs = &mc->cores[req->core_id];
+    cs->service += req->done_cycle - req->start_cycle;
+    cs->reads += !req->is_write;
+    charge_interference(mc, req->loc.channel * mc->banks_per_channel,
+                        mc->banks_per_channel, req->core_id, t->tBURST);
+
+    DRAMBankStats *stats = &mc->dram->bank_stats[bank];
+    if (req->is_write)
+    {
+        stats->writes++;
+        mc->stat_wr++;
+    }
+    else
+    {
+        stats->reads++;
+        mc->stat_rd++;
+    }
+    DRAMRowOutcome outcome = ROW_HIT;
+    if (req->needed_pre)
+    {
+        stats->row_misses++;
+        outcome = ROW_CONFLICT;
+    }
+    else if (req->needed_act)
+    {
+        stats->row_empty++;
+        outcome = ROW_EMPTY;
+    }
+    else
+    {
+        stats->row_hits++;
+    }
+    if (mc->dram->rec)
+    {
+        dramrec_row(mc->dram->rec, bank, outcome);
+    }
+
+    unlink_request(mc, r, prev);
+    req->next = mc->inflight_head;
+    mc->inflight_head = r;
+
+    // Under the adaptive policies, a row predicted to miss still stays open
+    // for queued requests that hit it.
+    bool keep_open = dram_policy_update(mc->dram, bank, req->loc.row, now);
+    if (!keep_open && DRAM_PAGE_POLICY != CLOSE_PAGE)
+    {
+        int heads[] = {bs->read_head, bs->write_head};
+        keep_open = bank_has_row_hit(mc, bank, heads);
+        mc->dram->stat_policy_closes += !keep_open;
+    }
+
+    if (!keep_open)
+    {
+        // Auto-precharge as soon as the bank allows it.
+        row->valid = false;
+        bs->next_act = later(bs->next_act, bs->next_pre + t->tRP);
+    }
+
+    if (req->is_write)
+    {
+        record_command(mc, bank, keep_open ? "WR" : "WRA");
+    }
+    else
+    {
+        record_command(mc, bank, keep_open ? "RD" : "RDA");
+    }
+}
+
+/** Charge a finished request to the statistics and wake its waiter. */
+static void complete_request(MemController *mc, DRAMRequest *req)
+{
+    uint64_t delay = req->done_cycle - req->arrival_cycle;
+    DRAM *dram = mc->dram;
+    DRAMChannelStats *ch = &dram->channel_stats[req->loc.channel];
+
+    if (req->is_write)
+    {
+        dram->stat_write_access++;
+        dram->stat_write_delay += delay;
+        ch->writes++;
+        ch->write_delay += delay;
+    }
+    else
+    {
+        dram->stat_read_access++;
+        dram->stat_read_delay += delay;
+        ch->reads++;
+        ch->read_delay += delay;
+    }
+
+    if (dram->rec)
+    {
+        dramrec_transfer(dram->rec, req->is_write, delay);
+    }
+
+    if (req->stat_delay)
+    {
+        *req->stat_delay += delay;
+    }
+
+    if (req->wait)
+    {
+        req->wait->pending--;
+        if (req->wait->ready_cycle < req->done_cycle + req->wait_tail)
+        {
+            req->wait->ready_cycle = req->done_cycle + req->wait_tail;
+        }
+    }
+}
+
+/** Pick and issue the best ready command of the given channel, if any. */
+static void schedule_channel(MemController *mc, unsigned int channel)
+{
+    int best = -1;
+    int best_prev = -1;
+    DRAMCommand best_cmd = CMD_NONE;
+
+    // Reads go first unless the channel is draining its writes. Otherwise
+    // writes only go when there are no reads.
+    ChannelState *ch = &mc->channels[channel];
+    bool serve_reads = !ch->draining;
+    bool serve_writes = ch->draining || ch->num_writes == ch->num_queued;
+
+    unsigned int first = channel * mc->banks_per_channel;
+    for (unsigned int bank = first; bank < first + mc->banks_per_channel;
+         bank++)
+    {
+        BankState *bs = &mc->banks[bank];
+        if (bs->read_head < 0 && bs->write_head < 0)
+        {
+            continue;
+        }
+
+        int heads[] = {serve_reads ? bs->read_head : -1,
+                       serve_writes ? bs->write_head : -1};
+        bool bank_hit = mc->dram->RowBuffer[bank].valid &&
+                        bank_has_row_hit(mc, bank, heads);
+
+        // Close the row if the page timer ran out while the bank was idle.
+        uint64_t closed_at;
+        if (!bank_hit &&
+            dram_policy_expire(mc->dram, bank, current_cycle, &closed_at))
+        {
+            bs->next_act = later(bs->next_act,
+                                 later(closed_at, bs->next_pre) +
+                                     mc->dram->timing.tRP);
+            record_command(mc, bank, "PRE");
+        }
+
+        for (int q = 0; q < 2; q++)
+        {
+            int prev = -1;
+            for (int r = heads[q]; r >= 0; prev = r, r = mc->reqs[r].next)
+            {
+                DRAMRequest *req = &mc->reqs[r];
+                if (req->arrival_cycle > current_cycle)
+                {
+                    continue;
+                }
+
+                DRAMCommand cmd = ready_command(mc, req, bank_hit);
+                if (cmd != CMD_NONE &&
+                    (best < 0 ||
+                     sched_before(mc, req, cmd, &mc->reqs[best], best_cmd)))
+                {
+                    best = r;
+                    best_prev = prev;
+                    best_cmd = cmd;
+                }
+            }
+        }
+    }
+
+    if (best >= 0)
+    {
+        issue_command(mc, best, best_prev, best_cmd);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a memory controller in front of the given DRAM.
+ *
+ * @param dram The DRAM module. Its organisation, page policy, and statistics
+ *             are used by the controller.
+ * @param sched The request scheduler. Must not be SCHED_NONE.
+ * @param wq_high The number of writes queued in a channel that starts
+ *                write-drain mode.
+ * @param wq_low The number of writes at which write-drain mode ends. Must be
+ *               less than wq_high.
+ * @param num_cores The number of CPU cores sharing the DRAM.
+ * @return A pointer to the memory controller.
+ */
+MemController *memctrl_new(DRAM *dram, DRAMScheduler sched,
+                           unsigned int wq_high, unsigned int wq_low,
+                           unsigned int num_cores)
+{
+    if (wq_low >= wq_high)
+    {
+        fprintf(stderr, "Error: the write queue low watermark (%u) must be "
+                        "below the high watermark (%u)\n", wq_low, wq_high);
+        exit(1);
+    }
+
+    MemController *mc = (MemController *)calloc(1, sizeof(MemController));
+    mc->dram = dram;
+    mc->sched = sched;
+    mc->wq_high = wq_high;
+    mc->wq_low = wq_low;
+
+    mc->num_reqs = MEMCTRL_INITIAL_REQS;
+    mc->reqs = (DRAMRequest *)calloc(mc->num_reqs, sizeof(DRAMRequest));
+    for (unsigned int i = 0; i < mc->num_reqs; i++)
+    {
+        mc->reqs[i].next = (i + 1 < mc->num_reqs) ? (int)(i + 1) : -1;
+    }
+    mc->free_head = 0;
+    mc->inflight_head = -1;
+
+    mc->banks = (BankState *)calloc(dram->total_banks, sizeof(BankState));
+    for (unsigned int i = 0; i < dram->total_banks; i++)
+    {
+        mc->banks[i].read_head = mc->banks[i].read_tail = -1;
+        mc->banks[i].write_head = mc->banks[i].write_tail = -1;
+    }
+    mc->banks_per_channel = dram->total_banks / dram->num_channels;
+
+    unsigned int num_ranks = dram->num_channels * dram->num_ranks;
+    mc->ranks = (RankState *)calloc(num_ranks, sizeof(RankState));
+    for (unsigned int i = 0; i < num_ranks; i++)
+    {
+        mc->ranks[i].bg_next_act = (uint64_t *)calloc(dram->num_bankgroups,
+                                                      sizeof(uint64_t));
+        mc->ranks[i].bg_next_col = (uint64_t *)calloc(dram->num_bankgroups,
+                                                      sizeof(uint64_t));
+    }
+
+    mc->channels = (ChannelState *)calloc(dram->num_channels,
+                                          sizeof(ChannelState));
+
+    mc->num_cores = num_cores;
+    mc->cores = (CoreSchedState *)calloc(num_cores, sizeof(CoreSchedState));
+    mc->quantum_end = SCHED_QUANTUM;
+    mc->tcm_order = (unsigned int *)calloc(num_cores, sizeof(unsigned int));
+    for (unsigned int i = 0; i < num_cores; i++)
+    {
+        mc->tcm_order[i] = i;
+    }
+    mc->tcm_num_lat = num_cores;
+    mc->tcm_next_shuffle = TCM_SHUFFLE_INTERVAL;
+
+    mc->refresh_next = UINT64_MAX;
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        mc->refresh_due = (uint64_t *)calloc(dram->refresh_units,
+                                             sizeof(uint64_t));
+        for (unsigned int u = 0; u < dram->refresh_units; u++)
+        {
+            mc->refresh_due[u] = dram_refresh_next(
+                dram, u * dram->refresh_banks, 0);
+            mc->refresh_next = std::min(mc->refresh_next, mc->refresh_due[u]);
+        }
+    }
+    return mc;
+}
+
+/** Fill in a request taken from the pool, without queueing it yet. */
+static int new_request(MemController *mc, uint64_t line_addr, bool is_write,
+                       unsigned int core_id, MemWait *wait,
+                       uint64_t *stat_delay)
+{
+    int r = alloc_request(mc);
+    DRAMRequest *req = &mc->reqs[r];
+
+    req->line_addr = line_addr;
+    dram_decode(mc->dram, line_addr, &req->loc);
+    req->is_write = is_write;
+    req->core_id = core_id;
+    req->arrival_cycle = 0;
+    req->done_cycle = 0;
+    req->started = false;
+    req->marked = false;
+    req->needed_act = false;
+    req->needed_pre = false;
+    req->wait = wait;
+    req->stat_delay = stat_delay;
+    req->wait_tail = 0;
+    req->dependent = -1;
+    req->dependent_gap = 0;
+    req->next = -1;
+
+    if (wait)
+    {
+        wait->pending++;
+    }
+    return r;
+}
+
+/** Append a request to its bank queue; it reaches the controller then. */
+static void queue_request(MemController *mc, int r, uint64_t arrival_cycle)
+{
+    DRAMRequest *req = &mc->reqs[r];
+    bool is_write = req->is_write;
+    req->arrival_cycle = arrival_cycle;
+
+    BankState *bs = &mc->banks[req->loc.bank_index];
+    int *head = is_write ? &bs->write_head : &bs->read_head;
+    int *tail = is_write ? &bs->write_tail : &bs->read_tail;
+    if (*tail < 0)
+    {
+        *head = r;
+    }
+    else
+    {
+        mc->reqs[*tail].next = r;
+    }
+    *tail = r;
+
+    ChannelState *ch = &mc->channels[req->loc.channel];
+    ch->num_queued++;
+    mc->total_queued++;
+
+    if (is_write)
+    {
+        ch->num_writes++;
+        if (!ch->draining && ch->num_writes >= mc->wq_high)
+        {
+            // Every read queued now waits for the drain.
+            ch->draining = true;
+            ch->drain_start = current_cycle;
+            mc->stat_drains++;
+            mc->stat_drain_blocked_reads += ch->num_queued - ch->num_writes;
+        }
+    }
+    else if (ch->draining)
+    {
+        mc->stat_drain_blocked_reads++;
+    }
+
+    if (mc->total_queued > mc->stat_max_queued)
+    {
+        mc->stat_max_queued = mc->total_queued;
+    }
+}
+
+/**
+ * Queue a DRAM read or write.
+ *
+ * @param mc The memory controller.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param is_write Whether this is a write.
+ * @param core_id The CPU core ID the request comes from.
+ * @param arrival_cycle The cycle at which the request reaches the controller.
+ * @param wait If not NULL, the access waiting on this request. Its pending
+ *             count is incremented now and decremented when the data returns.
+ * @param stat_delay If not NULL, a delay statistic that the time spent in
+ *                   the controller is added to when the request completes.
+ * @return The request, which stays valid until it completes.
+ */
+int memctrl_enqueue(MemController *mc, uint64_t line_addr, bool is_write,
+                    unsigned int core_id, uint64_t arrival_cycle,
+                    MemWait *wait, uint64_t *stat_delay)
+{
+    int r = new_request(mc, line_addr, is_write, core_id, wait, stat_delay);
+    queue_request(mc, r, arrival_cycle);
+    return r;
+}
+
+/**
+ * Queue a DRAM read that can only be issued once an earlier read has
+ * returned its data, e.g. the next level of a page walk.
+ *
+ * @param mc The memory controller.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param core_id The CPU core ID the request comes from.
+ * @param after The read this one depends on, which must not have completed
+ *              yet or have another dependent.
+ * @param gap The cycles between the data of after returning and this read
+ *            reaching the controller.
+ * @param wait As for memctrl_enqueue().
+ * @param stat_delay As for memctrl_enqueue().
+ * @return The request, which stays valid until it completes.
+ */
+int memctrl_enqueue_after(MemController *mc, uint64_t line_addr,
+                          unsigned int core_id, int after, uint64_t gap,
+                          MemWait *wait, uint64_t *stat_delay)
+{
+    // The pool may move when it grows, so take the request before looking
+    // at the one it follows.
+    int r = new_request(mc, line_addr, false, core_id, wait, stat_delay);
+
+    assert(mc->reqs[after].dependent < 0);
+    mc->reqs[after].dependent = r;
+    mc->reqs[after].dependent_gap = gap;
+    return r;
+}
+
+/**
+ * Make the access waiting on a request finish the given number of cycles
+ * after the request's data returns, for lookups it does after the read.
+ *
+ * @param mc The memory controller.
+ * @param r The request, which must not have completed yet.
+ * @param cycles The cycles to add.
+ */
+void memctrl_set_wait_tail(MemController *mc, int r, uint64_t cycles)
+{
+    mc->reqs[r].wait_tail = cycles;
+}
+
+/**
+ * Simulate one cycle of the memory controller: complete the requests whose
+ * data has arrived, then issue at most one command per channel.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_cycle(MemController *mc)
+{
+    if (mc->dram->rec)
+    {
+        dramrec_queue(mc->dram->rec, mc->total_queued);
+    }
+
+    int prev = -1;
+    int r = mc->inflight_head;
+    while (r >= 0)
+    {
+        int next = mc->reqs[r].next;
+        if (mc->reqs[r].done_cycle <= current_cycle)
+        {
+            DRAMRequest *req = &mc->reqs[r];
+            complete_request(mc, req);
+            if (prev < 0)
+            {
+                mc->inflight_head = next;
+            }
+            else
+            {
+                mc->reqs[prev].next = next;
+            }
+
+            // A read that was waiting for this one's data can go now.
+            if (req->dependent >= 0)
+            {
+                queue_request(mc, req->dependent,
+                              req->done_cycle + req->dependent_gap);
+            }
+            free_request(mc, r);
+        }
+        else
+        {
+            prev = r;
+        }
+        r = next;
+    }
+
+    if (DRAM_REFRESH != REFRESH_NONE && current_cycle >= mc->refresh_next)
+    {
+        refresh_due_units(mc);
+    }
+
+    if ((mc->sched == SCHED_ATLAS || mc->sched == SCHED_TCM) &&
+        current_cycle >= mc->quantum_end)
+    {
+        end_quantum(mc);
+        mc->quantum_end = current_cycle + SCHED_QUANTUM;
+    }
+    if (mc->sched == SCHED_TCM && current_cycle >= mc->tcm_next_shuffle)
+    {
+        tcm_shuffle(mc);
+        mc->tcm_next_shuffle = current_cycle + TCM_SHUFFLE_INTERVAL;
+    }
+
+    if (mc->total_queued == 0)
+    {
+        return;
+    }
+
+    if (mc->sched == SCHED_PARBS && mc->num_marked == 0)
+    {
+        form_batch(mc);
+    }
+
+    for (unsigned int c = 0; c < mc->dram->num_channels; c++)
+    {
+        if (mc->channels[c].num_queued)
+        {
+            schedule_channel(mc, c);
+        }
+    }
+}
+
+/**
+ * Return the next cycle after the current one in which memctrl_cycle() has
+ * anything to do: every cycle while requests are queued, otherwise the first
+ * data arrival, refresh, or end of a scheduling quantum.
+ *
+ * @param mc The memory controller.
+ * @return The cycle, or UINT64_MAX if the controller has nothing left to do.
+ */
+uint64_t memctrl_next_cycle(MemController *mc)
+{
+    if (mc->total_queued)
+    {
+        return current_cycle + 1;
+    }
+
+    uint64_t next = UINT64_MAX;
+    for (int r = mc->inflight_head; r >= 0; r = mc->reqs[r].next)
+    {
+        next = std::min(next, mc->reqs[r].done_cycle);
+    }
+    if (DRAM_REFRESH != REFRESH_NONE)
+    {
+        next = std::min(next, mc->refresh_next);
+    }
+    if (mc->sched == SCHED_ATLAS || mc->sched == SCHED_TCM)
+    {
+        next = std::min(next, mc->quantum_end);
+    }
+    if (mc->sched == SCHED_TCM)
+    {
+        next = std::min(next, mc->tcm_next_shuffle);
+    }
+
+    return later(next, current_cycle + 1);
+}
+
+/**
+ * Estimate how much a core was slowed down by sharing the DRAM with the
+ * other cores: its run time over its run time minus the cycles its reads were
+ * delayed by other cores' requests.
+ *
+ * @param mc The memory controller.
+ * @param core_id The CPU core ID.
+ * @param cycles The number of cycles the core ran for.
+ * @return The estimated slowdown, at least 1.
+ */
+double memctrl_core_slowdown(MemController *mc, unsigned int core_id,
+                             uint64_t cycles)
+{
+    uint64_t interference = mc->cores[core_id].interference;
+    if (cycles == 0)
+    {
+        return 1.0;
+    }
+
+    uint64_t alone = interference < cycles ? cycles - interference : 1;
+    return (double)cycles / (double)alone;
+}
+
+/**
+ * Print the statistics of the memory controller.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_print_stats(MemController *mc)
+{
+    double queue_delay_avg = 0.0;
+    if (mc->stat_rd + mc->stat_wr)
+    {
+        queue_delay_avg = (double)(mc->stat_queue_delay) /
+                          (double)(mc->stat_rd + mc->stat_wr);
+    }
+
+    printf("\n");
+    printf("MEMCTRL_ACT          \t\t : %10llu\n", mc->stat_act);
+    printf("MEMCTRL_PRE          \t\t : %10llu\n", mc->stat_pre);
+    printf("MEMCTRL_RD           \t\t : %10llu\n", mc->stat_rd);
+    printf("MEMCTRL_WR           \t\t : %10llu\n", mc->stat_wr);
+    printf("MEMCTRL_QUEUE_AVG    \t\t : %10.3f\n", queue_delay_avg);
+    printf("MEMCTRL_MAX_QUEUED   \t\t : %10u\n", mc->stat_max_queued);
+    printf("MEMCTRL_DRAINS       \t\t : %10llu\n", mc->stat_drains);
+    printf("MEMCTRL_DRAIN_CYCLES \t\t : %10llu\n",
+           (unsigned long long)mc->stat_drain_cycles);
+    printf("MEMCTRL_DRAIN_BLK_RD \t\t : %10llu\n",
+           mc->stat_drain_blocked_reads);
+    printf("MEMCTRL_TURNAROUNDS  \t\t : %10llu\n", mc->stat_turnarounds);
+    if (mc->sched == SCHED_PARBS)
+    {
+        printf("MEMCTRL_BATCHES      \t\t : %10llu\n", mc->stat_batches);
+    }
+}
+
+/**
+ * Free a memory controller. Requests still queued are dropped.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_free(MemController *mc)
+{
+    unsigned int num_ranks = mc->dram->num_channels * mc->dram->num_ranks;
+    for (unsigned int i = 0; i < num_ranks; i++)
+    {
+        free(mc->ranks[i].bg_next_act);
+        free(mc->ranks[i].bg_next_col);
+    }
+    free(mc->reqs);
+    free(mc->banks);
+    free(mc->ranks);
+    free(mc->channels);
+    free(mc->cores);
+    free(mc->tcm_order);
+    free(mc->refresh_due);
+    free(mc);
+}
@@ -0,0 +1,377 @@
+// memctrl.h
+// Declares the queue-based DRAM memory controller.
+//
+// Without the controller, dram_access() returns the latency of each access
+// at once, as if the DRAM were idle. With it, L2 misses and writebacks are
+// queued per bank and the controller issues ACT, RD, WR, and PRE commands
+// over time, one per channel per cycle, with the banks of a channel working
+// in parallel and sharing its data bus. A read completes at a future cycle,
+// which is reported through the MemWait of the access that caused it, so
+// the latency seen by the cores includes the time spent queuing.
+// Reads that depend on each other, like the levels of a page walk, are
+// chained: each one only reaches the controller after the one before it has
+// returned its data.
+//
+// Writes are posted: they wait in the queues while reads go first, and are
+// only issued when a channel has no reads, or in bursts once the channel's
+// writes reach a high watermark (write-drain mode, which lasts until they
+// fall to a low watermark and blocks reads meanwhile). Batching writes this
+// way saves bus turnarounds.
+//
+// Commands obey the timing constraints of DRAM::timing per bank (tRCD, tRAS,
+// tRC, tRP, tRTP, tWR), per rank (tRRD, tFAW, tCCD, tWTR), and per channel
+// (tRTW). With no other traffic, a request takes exactly as long as in
+// dram_access_mode_CDEF(): tCL + tBURST on a row hit, plus tRCD on an empty
+// bank, plus tRP on a row conflict.
+//
+// When refresh is enabled, each refresh closes the rows of the banks it
+// covers as soon as they allow it and keeps them from being activated for
+// tRFC (or tRFCpb).
+//
+// Besides FR-FCFS, the controller offers schedulers that are aware of which
+// core each request comes from (PAR-BS, ATLAS, and TCM), so that a core that
+// streams through memory can't starve one that is sensitive to latency. For
+// every scheduler it estimates how much each core is slowed down by sharing
+// the DRAM, from the cycles its reads spend waiting behind other cores'
+// commands.
+
+#ifndef __MEMCTRL_H__
+#define __MEMCTRL_H__
+
+#include "types.h"
+#include "dram.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Possible request schedulers of the memory controller. */
+typedef enum DRAMSchedulerEnum
+{
+    /** No controller: every access gets the latency of dram_access(). */
+    SCHED_NONE = 0,
+    /** First-ready, first-come first-served: row hits first, then oldest. */
+    SCHED_FRFCFS = 1,
+    /** Parallelism-aware batch scheduling: the oldest reads of each core in
+     *  each bank form a batch that goes before any newer read, and within
+     *  the batch the cores with the fewest marked reads go first. */
+    SCHED_PARBS = 2,
+    /** Adaptive per-thread least-attained-service: the cores that received
+     *  the least DRAM service over past quanta go first. */
+    SCHED_ATLAS = 3,
+    /** Thread cluster memory scheduling: cores that use little bandwidth go
+     *  first, least intensive first; the others take turns behind them. */
+    SCHED_TCM = 4,
+} DRAMScheduler;
+
+/** A read or write waiting in, or in flight from, the controller. */
+typedef struct DRAMRequest
+{
+    uint64_t line_addr;
+    DRAMAddr loc;
+    bool is_write;
+    unsigned int core_id;
+
+    /** The cycle the request reaches the controller. */
+    uint64_t arrival_cycle;
+    /** The cycle its data transfer ends, once its RD or WR is issued. */
+    uint64_t done_cycle;
+
+    /** Whether a command has been issued for this request yet, and when the
+     *  first one was. */
+    bool started;
+    uint64_t start_cycle;
+    /** For PAR-BS, whether the request is part of the current batch. */
+    bool marked;
+    /** Whether its row had to be opened, and whether another had to be
+     *  closed first; used to classify it as a row hit, empty, or miss. */
+    bool needed_act;
+    bool needed_pre;
+
+    /** The access waiting on this read, or NULL. */
+    MemWait *wait;
+    /** The memory system delay statistic to charge the latency to, or NULL. */
+    uint64_t *stat_delay;
+    /** The cycles the waiter still spends after the data returns. */
+    uint64_t wait_tail;
+
+    /** A read that depends on this one, and so only reaches the controller
+     *  dependent_gap cycles after this one's data returns (-1 if none). */
+    int dependent;
+    uint64_t dependent_gap;
+
+    /** The next request in the same bank queue or in the in-flight list. */
+    int next;
+} DRAMRequest;
+
+/** The timing state and request queues of one bank. */
+typedef struct BankState
+{
+    /** The earliest cycles at which each kind of command may be issued. */
+    uint64_t next_act;
+    uint64_t next_pre;
+    uint64_t next_rd;
+    uint64_t next_wr;
+
+    /** The core whose request opened the current row. */
+    unsigned int row_core;
+
+    /** The last refresh of the bank, and the row it closed, if any. */
+    uint64_t refresh_start;
+    uint64_t refresh_end;
+    bool refresh_closed;
+    uint64_t refresh_closed_row;
+
+    /** FIFO queues of reads and writes, as indices into the request pool
+     *  (-1 if empty). */
+    int read_head;
+    int read_tail;
+    int write_head;
+    int write_tail;
+} BankState;
+
+/** The timing state shared by the banks of one rank. */
+typedef struct RankState
+{
+    /** The earliest cycles at which each kind of command may be issued to
+     *  any bank of the rank. */
+    uint64_t next_act;
+    uint64_t next_rd;
+    uint64_t next_wr;
+
+    /** The cycles at which the last four ACTs leave the tFAW window, oldest
+     *  at act_window_pos. */
+    uint64_t act_window[4];
+    unsigned int act_window_pos;
+
+    /** Per bank group, the earliest ACT and RD/WR cycles. */
+    uint64_t *bg_next_act;
+    uint64_t *bg_next_col;
+} RankState;
+
+/** The state of one channel. */
+typedef struct ChannelState
+{
+    /** The cycle the data bus becomes free, and whether it last carried
+     *  write data. */
+    uint64_t bus_free;
+    bool bus_write;
+    /** The earliest cycle a WR may be issued (tRTW after the last RD). */
+    uint64_t next_wr;
+
+    /** The number of queued requests, and how many of them are writes. */
+    unsigned int num_queued;
+    unsigned int num_writes;
+    /** Whether the channel is in write-drain mode, and since when. */
+    bool draining;
+    uint64_t drain_start;
+} ChannelState;
+
+/** The per-core state of the schedulers. */
+typedef struct CoreSchedState
+{
+    /** The priority of the core's requests; lower goes first. */
+    unsigned int rank;
+
+    /** The DRAM service the core received this quantum: the cycles from the
+     *  first command of each request to the end of its data transfer. */
+    uint64_t service;
+    /** For ATLAS, the service attained over past quanta, decayed. */
+    double attained;
+    /** For TCM, the reads of the core this quantum, as its intensity. */
+    unsigned long long reads;
+
+    /** For PAR-BS, the core's marked reads in the current batch: in the bank
+     *  being marked, in its busiest bank, and in total. */
+    unsigned int batch_bank;
+    unsigned int batch_max;
+    unsigned int batch_total;
+
+    /** The estimated cycles the core's reads were delayed by other cores. */
+    uint64_t interference;
+    /** Scratch flag for counting each core once per command. */
+    bool seen;
+} CoreSchedState;
+
+/** The memory controller. */
+typedef struct MemController
+{
+    DRAM *dram;
+    DRAMScheduler sched;
+
+    /** The pool of requests, and the head of its free list. */
+    DRAMRequest *reqs;
+    unsigned int num_reqs;
+    int free_head;
+
+    /** One entry per bank, indexed by DRAMAddr::bank_index. The open rows
+     *  are kept in the DRAM's RowBuffer array. */
+    BankState *banks;
+    unsigned int banks_per_channel;
+    /** One entry per rank, channel-major. */
+    RankState *ranks;
+
+    ChannelState *channels;
+    /** The per-channel write counts that start and end write-drain mode. */
+    unsigned int wq_high;
+    unsigned int wq_low;
+
+    unsigned int num_cores;
+    CoreSchedState *cores;
+    /** For PAR-BS, the number of marked requests not yet served. */
+    unsigned int num_marked;
+    /** For ATLAS and TCM, the cycle the current quantum ends. */
+    uint64_t quantum_end;
+    /** For TCM, the cores in priority order: first the tcm_num_lat cores of
+     *  the latency-sensitive cluster, then the others, which rotate every
+     *  shuffle interval. */
+    unsigned int *tcm_order;
+    unsigned int tcm_num_lat;
+    uint64_t tcm_next_shuffle;
+
+    /** The cycle each refresh unit (see DRAM::refresh_banks) is next due,
+     *  and the earliest of them. */
+    uint64_t *refresh_due;
+    uint64_t refresh_next;
+
+    /** The requests whose data is on its way, in no particular order. */
+    int inflight_head;
+    unsigned int total_queued;
+
+    unsigned long long stat_act;
+    unsigned long long stat_pre;
+    unsigned long long stat_rd;
+    unsigned long long stat_wr;
+    /** The total cycles requests waited between arriving and their first
+     *  command. */
+    uint64_t stat_queue_delay;
+    /** The largest number of requests queued at once. */
+    unsigned int stat_max_queued;
+    /** The number of write-drain episodes and the cycles spent in them. */
+    unsigned long long stat_drains;
+    uint64_t stat_drain_cycles;
+    /** The number of reads that were queued during a write drain. */
+    unsigned long long stat_drain_blocked_reads;
+    /** The number of times a channel's bus switched between reads and
+     *  writes. */
+    unsigned long long stat_turnarounds;
+    /** For PAR-BS, the number of batches formed. */
+    unsigned long long stat_batches;
+} MemController;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a memory controller in front of the given DRAM.
+ *
+ * @param dram The DRAM module. Its organisation, page policy, and statistics
+ *             are used by the controller.
+ * @param sched The request scheduler. Must not be SCHED_NONE.
+ * @param wq_high The number of writes queued in a channel that starts
+ *                write-drain mode.
+ * @param wq_low The number of writes at which write-drain mode ends. Must be
+ *               less than wq_high.
+ * @param num_cores The number of CPU cores sharing the DRAM.
+ * @return A pointer to the memory controller.
+ */
+MemController *memctrl_new(DRAM *dram, DRAMScheduler sched,
+                           unsigned int wq_high, unsigned int wq_low,
+                           unsigned int num_cores);
+
+/**
+ * Queue a DRAM read or write.
+ *
+ * @param mc The memory controller.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param is_write Whether this is a write.
+ * @param core_id The CPU core ID the request comes from.
+ * @param arrival_cycle The cycle at which the request reaches the controller.
+ * @param wait If not NULL, the access waiting on this request. Its pending
+ *             count is incremented now and decremented when the data returns.
+ * @param stat_delay If not NULL, a delay statistic that the time spent in
+ *                   the controller is added to when the request completes.
+ * @return The request, which stays valid until it completes.
+ */
+int memctrl_enqueue(MemController *mc, uint64_t line_addr, bool is_write,
+                    unsigned int core_id, uint64_t arrival_cycle,
+                    MemWait *wait, uint64_t *stat_delay);
+
+/**
+ * Queue a DRAM read that can only be issued once an earlier read has
+ * returned its data, e.g. the next level of a page walk.
+ *
+ * @param mc The memory controller.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param core_id The CPU core ID the request comes from.
+ * @param after The read this one depends on, which must not have completed
+ *              yet or have another dependent.
+ * @param gap The cycles between the data of after returning and this read
+ *            reaching the controller.
+ * @param wait As for memctrl_enqueue().
+ * @param stat_delay As for memctrl_enqueue().
+ * @return The request, which stays valid until it completes.
+ */
+int memctrl_enqueue_after(MemController *mc, uint64_t line_addr,
+                          unsigned int core_id, int after, uint64_t gap,
+                          MemWait *wait, uint64_t *stat_delay);
+
+/**
+ * Make the access waiting on a request finish the given number of cycles
+ * after the request's data returns, for lookups it does after the read.
+ *
+ * @param mc The memory controller.
+ * @param r The request, which must not have completed yet.
+ * @param cycles The cycles to add.
+ */
+void memctrl_set_wait_tail(MemController *mc, int r, uint64_t cycles);
+
+/**
+ * Simulate one cycle of the memory controller: complete the requests whose
+ * data has arrived, then issue at most one command per channel.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_cycle(MemController *mc);
+
+/**
+ * Return the next cycle after the current one in which memctrl_cycle() has
+ * anything to do: every cycle while requests are queued, otherwise the first
+ * data arrival, refresh, or end of a scheduling quantum.
+ *
+ * @param mc The memory controller.
+ * @return The cycle, or UINT64_MAX if the controller has nothing left to do.
+ */
+uint64_t memctrl_next_cycle(MemController *mc);
+
+/**
+ * Estimate how much a core was slowed down by sharing the DRAM with the
+ * other cores: its run time over its run time minus the cycles its reads were
+ * delayed by other cores' requests.
+ *
+ * @param mc The memory controller.
+ * @param core_id The CPU core ID.
+ * @param cycles The number of cycles the core ran for.
+ * @return The estimated slowdown, at least 1.
+ */
+double memctrl_core_slowdown(MemController *mc, unsigned int core_id,
+                             uint64_t cycles);
+
+/**
+ * Print the statistics of the memory controller.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_print_stats(MemController *mc);
+
+/**
+ * Free a memory controller. Requests still queued are dropped.
+ *
+ * @param mc The memory controller.
+ */
+void memctrl_free(MemController *mc);
+
+#endif // __MEMCTRL_H__
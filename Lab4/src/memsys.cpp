@@ -37,6 +37,24 @@
 /** The hit time of the L2 cache in cycles. */
 #define L2CACHE_HIT_LATENCY 10
 
+/** The hit time of the L2 TLB in cycles. L1 TLB hits are free. */
+#define L2TLB_HIT_LATENCY 7
+
+/** The number of bytes in a huge page. */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * The number of levels in the radix page table, each indexed by 9 bits of the
+ * VPN. A huge page is mapped one level up.
+ */
+#define PAGE_TABLE_LEVELS 4
+
+/**
+ * The physical address the page tables are placed at, above any address a
+ * data access can reach.
+ */
+#define PAGE_TABLE_BASE (1ULL << 40)
+
 ///////////////////////////////////////////////////////////////////////////////
 //                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
 ///////////////////////////////////////////////////////////////////////////////
@@ -45,44 +63,105 @@
  * The current mode under which the simulation is running, corresponding to
  * which part of the lab is being evaluated.
  */
-extern Mode SIM_MODE;
+extern thread_local Mode SIM_MODE;
 
 /** The number of bytes in a cache line. */
-extern uint64_t CACHE_LINESIZE;
+extern thread_local uint64_t CACHE_LINESIZE;
 
 /** The replacement policy to use for the L1 data and instruction caches. */
-extern ReplacementPolicy REPL_POLICY;
+extern thread_local ReplacementPolicy REPL_POLICY;
 
 /** The size of the data cache in bytes. */
-extern uint64_t DCACHE_SIZE;
+extern thread_local uint64_t DCACHE_SIZE;
 
 /** The associativity of the data cache. */
-extern uint64_t DCACHE_ASSOC;
+extern thread_local uint64_t DCACHE_ASSOC;
 
 /** The size of the instruction cache in bytes. */
-extern uint64_t ICACHE_SIZE;
+extern thread_local uint64_t ICACHE_SIZE;
 
 /** The associativity of the instruction cache. */
-extern uint64_t ICACHE_ASSOC;
+extern thread_local uint64_t ICACHE_ASSOC;
 
 /** The size of the L2 cache in bytes. */
-extern uint64_t L2CACHE_SIZE;
+extern thread_local uint64_t L2CACHE_SIZE;
 
 /** The associativity of the L2 cache. */
-extern uint64_t L2CACHE_ASSOC;
+extern thread_local uint64_t L2CACHE_ASSOC;
 
 /** The replacement policy to use for the L2 cache. */
-extern ReplacementPolicy L2CACHE_REPL;
+extern thread_local ReplacementPolicy L2CACHE_REPL;
 
 /** The number of cores being simulated. */
-extern unsigned int NUM_CORES;
+extern thread_local unsigned int NUM_CORES;
+
+/** Whether the locality profiler is enabled. */
+extern thread_local bool PROFILE;
+
+/** The number of distinct lines each reuse-distance tracker remembers. */
+extern thread_local uint64_t PROFILE_LINES;
+
+/** The prefix of the heatmap output files, or NULL if heatmaps are disabled. */
+extern thread_local const char *HEATMAP_PREFIX;
+
+/** The number of cycles between heatmap dumps, or 0 to dump only at the end. */
+extern thread_local uint64_t HEATMAP_INTERVAL;
+
+/** The prefix of the DRAM time-series files, or NULL if disabled. */
+extern thread_local const char *DRAM_RECORD_PREFIX;
+
+/** The number of cycles per row of the DRAM time series. */
+extern thread_local uint64_t DRAM_RECORD_INTERVAL;
+
+/** Whether to write DRAM command traces along with the time series. */
+extern thread_local bool DRAM_CMD_TRACE;
+
+/** The CPU clock frequency in MHz. */
+extern thread_local uint64_t CPU_MHZ;
+
+/** Whether address translation goes through TLBs (mode 4 only). */
+extern thread_local bool TLB_ENABLE;
+
+/** The number of entries and associativity of the L1 instruction TLBs. */
+extern thread_local uint64_t ITLB_ENTRIES;
+extern thread_local uint64_t ITLB_ASSOC;
+
+/** The number of entries and associativity of the L1 data TLBs. */
+extern thread_local uint64_t DTLB_ENTRIES;
+extern thread_local uint64_t DTLB_ASSOC;
+
+/** The number of entries and associativity of the shared L2 TLB. */
+extern thread_local uint64_t L2TLB_ENTRIES;
+extern thread_local uint64_t L2TLB_ASSOC;
+
+/** The latency of a page walk in cycles, unless walks go through memory. */
+extern thread_local uint64_t PAGE_WALK_LATENCY;
+
+/** Whether page walks read the page tables through the L2 cache and DRAM. */
+extern thread_local bool PAGE_WALK_MEM;
+
+/** Whether memory is mapped with 2MB pages instead of 4KB pages. */
+extern thread_local bool HUGEPAGES;
+
+/** How physical frames are allocated to virtual pages (mode 4 only). */
+extern thread_local PagePolicy PAGE_POLICY;
+
+/** The amount of physical memory available to the page allocator, in MB. */
+extern thread_local uint64_t PHYS_MEM_MB;
+
+/** The request scheduler of the DRAM memory controller. */
+extern thread_local DRAMScheduler DRAM_SCHED;
+
+/** The write counts that start and end a write drain in each DRAM channel. */
+extern thread_local unsigned int DRAM_WQ_HIGH;
+extern thread_local unsigned int DRAM_WQ_LOW;
 
 /**
  * The current clock cycle number.
  * 
  * This can be used as a timestamp for implementing the LRU replacement policy.
  */
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
 
 ///////////////////////////////////////////////////////////////////////////////
 //                           FUNCTION DEFINITIONS                            //
@@ -97,6 +176,13 @@ extern uint64_t current_cycle;
  */
 MemorySystem *memsys_new()
 {
+    // Only the multicore memory system translates addresses.
+    if (TLB_ENABLE && SIM_MODE != SIM_MODE_DEF)
+    {
+        fprintf(stderr, "Error: -tlb can only be used with -mode 4\n");
+        exit(1);
+    }
+
     MemorySystem *sys = (MemorySystem *)calloc(1, sizeof(MemorySystem));
 
     if (SIM_MODE == SIM_MODE_A)
@@ -128,11 +214,158 @@ MemorySystem *memsys_new()
             sys->icache_coreid[i] = cache_new(ICACHE_SIZE, ICACHE_ASSOC,
                                               CACHE_LINESIZE, REPL_POLICY);
         }
+
+        if (TLB_ENABLE)
+        {
+            for (unsigned int i = 0; i < NUM_CORES; i++)
+            {
+                sys->itlb_coreid[i] = tlb_new(ITLB_ENTRIES, ITLB_ASSOC);
+                sys->dtlb_coreid[i] = tlb_new(DTLB_ENTRIES, DTLB_ASSOC);
+            }
+            sys->l2tlb = tlb_new(L2TLB_ENTRIES, L2TLB_ASSOC);
+        }
+
+        if (PAGE_POLICY != PAGE_FIXED)
+        {
+            // The allocator works in units of the mapping page size.
+            uint64_t page_size = HUGEPAGES ? HUGE_PAGE_SIZE : PAGE_SIZE;
+            uint64_t num_colours = 1;
+            if (PAGE_POLICY == PAGE_BANK_AWARE)
+            {
+                // XOR hashing mixes row bits into the bank, so frames no
+                // longer share banks by their frame number modulo anything.
+                if (sys->dram->mapping == MAP_XOR)
+                {
+                    fprintf(stderr, "Error: bank-aware page allocation "
+                                    "can't be used with XOR bank hashing\n");
+                    exit(1);
+                }
+                // Line interleaving spreads every page over the banks.
+                if (sys->dram->mapping == MAP_LINE_INTERLEAVE)
+                {
+                    fprintf(stderr, "Error: bank-aware page allocation "
+                                    "can't be used with line interleaving\n");
+                    exit(1);
+                }
+                num_colours = dram_num_page_colours(sys->dram, page_size);
+                if (num_colours < 2)
+                {
+                    fprintf(stderr, "Error: bank-aware page allocation has "
+                                    "only one bank colour at this page size\n");
+                    exit(1);
+                }
+            }
+            if (PAGE_POLICY == PAGE_COLOUR)
+            {
+                num_colours = sys->l2cache->num_sets * CACHE_LINESIZE /
+                              page_size;
+            }
+            sys->palloc = palloc_new(PAGE_POLICY,
+                                     PHYS_MEM_MB * 1024 * 1024 / page_size,
+                                     num_colours, NUM_CORES);
+        }
+    }
+
+    if (DRAM_SCHED != SCHED_NONE &&
+        (SIM_MODE == SIM_MODE_C || SIM_MODE == SIM_MODE_DEF))
+    {
+        sys->memctrl = memctrl_new(sys->dram, DRAM_SCHED, DRAM_WQ_HIGH,
+                                   DRAM_WQ_LOW, NUM_CORES);
+    }
+
+    if (DRAM_CMD_TRACE && (!DRAM_RECORD_PREFIX || !sys->memctrl))
+    {
+        fprintf(stderr, "Error: -dram_cmd_trace needs -dram_record and the "
+                        "memory controller (-dram_sched)\n");
+        exit(1);
+    }
+
+    if (DRAM_RECORD_PREFIX && sys->dram)
+    {
+        DRAM *dram = sys->dram;
+        dram->rec = dramrec_new(DRAM_RECORD_PREFIX, DRAM_RECORD_INTERVAL,
+                                DRAM_CMD_TRACE, dram->num_channels,
+                                dram->num_ranks, dram->num_bankgroups,
+                                dram->num_banks, CACHE_LINESIZE, CPU_MHZ,
+                                dram->timing.tCK_ps);
+    }
+
+    if (PROFILE)
+    {
+        sys->prof = prof_new(CACHE_LINESIZE, PROFILE_LINES);
+    }
+
+    if (HEATMAP_PREFIX)
+    {
+        sys->heatmap = heatmap_new(HEATMAP_PREFIX, HEATMAP_INTERVAL);
+
+        Cache *caches[] = {sys->dcache, sys->icache, sys->dcache_coreid[0],
+                           sys->dcache_coreid[1], sys->icache_coreid[0],
+                           sys->icache_coreid[1], sys->l2cache};
+        for (unsigned int i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+        {
+            if (caches[i])
+            {
+                cache_enable_set_stats(caches[i]);
+            }
+        }
     }
 
     return sys;
 }
 
+/**
+ * Free the memory system and everything it owns.
+ *
+ * @param sys The memory system.
+ */
+void memsys_free(MemorySystem *sys)
+{
+    Cache *caches[] = {sys->dcache, sys->icache, sys->dcache_coreid[0],
+                       sys->dcache_coreid[1], sys->icache_coreid[0],
+                       sys->icache_coreid[1], sys->l2cache};
+    for (unsigned int i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+    {
+        if (caches[i])
+        {
+            cache_free(caches[i]);
+        }
+    }
+
+    TLB *tlbs[] = {sys->itlb_coreid[0], sys->itlb_coreid[1],
+                   sys->dtlb_coreid[0], sys->dtlb_coreid[1], sys->l2tlb};
+    for (unsigned int i = 0; i < sizeof(tlbs) / sizeof(tlbs[0]); i++)
+    {
+        if (tlbs[i])
+        {
+            tlb_free(tlbs[i]);
+        }
+    }
+
+    if (sys->palloc)
+    {
+        palloc_free(sys->palloc);
+    }
+    if (sys->memctrl)
+    {
+        memctrl_free(sys->memctrl);
+    }
+    if (sys->dram)
+    {
+        dram_free(sys->dram);
+    }
+    if (sys->prof)
+    {
+        prof_free(sys->prof);
+    }
+    if (sys->heatmap)
+    {
+        heatmap_free(sys->heatmap);
+    }
+
+    free(sys);
+}
+
 /**
  * Access the given memory address from an instruction fetch or load/store.
  * 
@@ -155,6 +388,30 @@ uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
     // All cache transactions happen at line granularity, so we convert the
     // byte address to a cache line address.
     uint64_t line_addr = addr / CACHE_LINESIZE;
+    sys->access_type = type;
+
+    if (type == ACCESS_TYPE_IFETCH)
+    {
+        sys->access_stat_delay = &sys->stat_ifetch_delay;
+    }
+    else if (type == ACCESS_TYPE_LOAD)
+    {
+        sys->access_stat_delay = &sys->stat_load_delay;
+    }
+    else
+    {
+        sys->access_stat_delay = &sys->stat_store_delay;
+    }
+
+    if (sys->heatmap && sys->heatmap->interval &&
+        current_cycle >= sys->heatmap->next_dump_cycle)
+    {
+        memsys_dump_heatmap(sys);
+        sys->heatmap->next_dump_cycle = current_cycle + sys->heatmap->interval;
+    }
+
+    sys->access_chain = -1;
+    sys->access_chain_gap = 0;
 
     if (SIM_MODE == SIM_MODE_A)
     {
@@ -172,6 +429,14 @@ uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
 
     }
 
+    // Lookups after the last DRAM read still delay the access once its data
+    // returns.
+    if (sys->memctrl && sys->access_chain >= 0 && sys->access_chain_gap)
+    {
+        memctrl_set_wait_tail(sys->memctrl, sys->access_chain,
+                              sys->access_chain_gap);
+    }
+
     // Update the statistics.
     if (type == ACCESS_TYPE_IFETCH)
     {
@@ -194,6 +459,61 @@ uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
     return delay;
 }
 
+/**
+ * Access the given memory address as memsys_access() does, but with the DRAM
+ * reads it causes queued at the memory controller, if there is one.
+ *
+ * The returned delay then excludes the time spent in DRAM. Instead, wait is
+ * told how many reads are outstanding and when the last of them returned.
+ *
+ * @param sys The memory system to use for the access.
+ * @param addr The address to access (in bytes).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param wait Where to track the outstanding reads, or NULL if the requester
+ *             does not wait for them.
+ * @return The delay in cycles incurred by this memory access outside DRAM.
+ */
+uint64_t memsys_access_async(MemorySystem *sys, uint64_t addr,
+                             AccessType type, unsigned int core_id,
+                             MemWait *wait)
+{
+    sys->access_wait = wait;
+    uint64_t delay = memsys_access(sys, addr, type, core_id);
+    sys->access_wait = NULL;
+    return delay;
+}
+
+/**
+ * Simulate one cycle of the parts of the memory system that work in the
+ * background, i.e., the memory controller.
+ *
+ * @param sys The memory system.
+ */
+void memsys_cycle(MemorySystem *sys)
+{
+    if (sys->memctrl)
+    {
+        memctrl_cycle(sys->memctrl);
+    }
+}
+
+/**
+ * Return the next cycle after the current one in which memsys_cycle() has
+ * anything to do.
+ *
+ * @param sys The memory system.
+ * @return The cycle, or UINT64_MAX if there is nothing left to do.
+ */
+uint64_t memsys_next_cycle(MemorySystem *sys)
+{
+    if (sys->memctrl)
+    {
+        return memctrl_next_cycle(sys->memctrl);
+    }
+    return UINT64_MAX;
+}
+
 /**
  * In mode A, access the given memory address from a load or store.
  * 
@@ -237,8 +557,17 @@ uint64_t memsys_access_modeA(MemorySystem *sys, uint64_t line_addr,
     {
         CacheResult outcome = cache_access(sys->dcache, line_addr, is_write,
                                            core_id);
+        if (sys->prof)
+        {
+            prof_record(sys->prof, PROF_LEVEL_L1, core_id, sys->access_pc,
+                        line_addr * CACHE_LINESIZE, outcome == MISS);
+        }
         if (outcome == MISS)
         {
+            if (sys->heatmap)
+            {
+                heatmap_record_miss(sys->heatmap, line_addr * CACHE_LINESIZE);
+            }
             cache_install(sys->dcache, line_addr, is_write, core_id);
         }
     }
@@ -270,6 +599,7 @@ uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
     //Initialize the Signal
     uint64_t delay = DCACHE_HIT_LATENCY;
     uint64_t delay2 = 0;
+    sys->access_chain_gap += delay;
     bool is_write = false; // whether write or not
     bool is_dcache = true; // Need use dcache
     //bool is_L2 = true;
@@ -303,6 +633,11 @@ uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
 
         /* Check hit or not */
         bool is_hit = cache_access(sys->dcache, line_addr, is_write, core_id);
+        if (sys->prof)
+        {
+            prof_record(sys->prof, PROF_LEVEL_L1, core_id, sys->access_pc,
+                        line_addr * CACHE_LINESIZE, !is_hit);
+        }
 
         //If hit, 
         if (is_hit)
@@ -416,6 +751,15 @@ uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
 
     // Figure out whether L2 hit 
     bool is_L2_hit = cache_access(sys->l2cache, line_addr, is_writeback, core_id);
+    if (!is_writeback)
+    {
+        sys->access_chain_gap += delay;
+    }
+    if (sys->prof && !is_writeback && sys->access_type != ACCESS_TYPE_IFETCH)
+    {
+        prof_record(sys->prof, PROF_LEVEL_L2, core_id, sys->access_pc,
+                    line_addr * CACHE_LINESIZE, !is_L2_hit);
+    }
 
     //IF hit
     if (is_L2_hit)
@@ -425,8 +769,46 @@ uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
     //IF MISS 
     else
     {
+        if (sys->heatmap)
+        {
+            heatmap_record_miss(sys->heatmap, line_addr * CACHE_LINESIZE);
+        }
+
         //Read from Dram
-        delay += dram_access(sys->dram,line_addr,false);
+        if (sys->memctrl && is_writeback)
+        {
+            // Writebacks are off the critical path.
+            memctrl_enqueue(sys->memctrl, line_addr, false, core_id,
+                            current_cycle + DCACHE_HIT_LATENCY + delay,
+                            NULL, NULL);
+        }
+        else if (sys->memctrl)
+        {
+            // The read reaches the controller after the lookups before it,
+            // which for a later read of the same access (the next level of
+            // a page walk, or the data after the walk) only start once the
+            // previous read has returned. Its DRAM latency gets back to the
+            // requester through access_wait.
+            if (sys->access_chain >= 0)
+            {
+                sys->access_chain = memctrl_enqueue_after(
+                    sys->memctrl, line_addr, core_id, sys->access_chain,
+                    sys->access_chain_gap, sys->access_wait,
+                    sys->access_stat_delay);
+            }
+            else
+            {
+                sys->access_chain = memctrl_enqueue(
+                    sys->memctrl, line_addr, false, core_id,
+                    current_cycle + sys->access_chain_gap, sys->access_wait,
+                    sys->access_stat_delay);
+            }
+            sys->access_chain_gap = 0;
+        }
+        else
+        {
+            delay += dram_access(sys->dram,line_addr,false);
+        }
         // Install to L2
         cache_install(sys->l2cache, line_addr, is_writeback, core_id);
         // Evicted line of L2
@@ -438,7 +820,17 @@ uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
             uint64_t evicted_Line_Addr = tag * (sys->l2cache->num_sets)+index;
             
             // Increase Delete
-            delay2 += dram_access(sys->dram, evicted_Line_Addr, true);
+            if (sys->memctrl)
+            {
+                memctrl_enqueue(sys->memctrl, evicted_Line_Addr, true,
+                                core_id,
+                                current_cycle + DCACHE_HIT_LATENCY + delay,
+                                NULL, NULL);
+            }
+            else
+            {
+                delay2 += dram_access(sys->dram, evicted_Line_Addr, true);
+            }
 
             // Empty 
             sys->l2cache->lastEvictedLine.valid = false;
@@ -498,6 +890,13 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
     
     p_line_addr = p_addr/CACHE_LINESIZE;   
 
+    if (sys->l2tlb)
+    {
+        delay += memsys_tlb_access(sys, vpn, type, core_id);
+    }
+    sys->access_chain_gap += type == ACCESS_TYPE_IFETCH ? ICACHE_HIT_LATENCY
+                                                        : DCACHE_HIT_LATENCY;
+
     if (type == ACCESS_TYPE_IFETCH)
     {
         // TODO: Simulate the instruction fetch and update delay accordingly.
@@ -533,6 +932,11 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
     {
         // TODO: Simulate the data load and update delay accordingly.
         is_access = cache_access(sys->dcache_coreid[core_id], p_line_addr, false, core_id);
+        if (sys->prof)
+        {
+            prof_record(sys->prof, PROF_LEVEL_L1, core_id, sys->access_pc,
+                        p_line_addr * CACHE_LINESIZE, is_access == MISS);
+        }
 
         // Hit or not?
         delay += DCACHE_HIT_LATENCY;
@@ -569,6 +973,11 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
     {
         // TODO: Simulate the data store and update delay accordingly.
         is_access = cache_access(sys->dcache_coreid[core_id], p_line_addr, true, core_id);
+        if (sys->prof)
+        {
+            prof_record(sys->prof, PROF_LEVEL_L1, core_id, sys->access_pc,
+                        p_line_addr * CACHE_LINESIZE, is_access == MISS);
+        }
 
         // Hit or not?
         delay += DCACHE_HIT_LATENCY;
@@ -620,12 +1029,116 @@ uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
                                    unsigned int core_id)
 {
     assert(NUM_CORES == 2);
+
+    if (sys->palloc)
+    {
+        if (HUGEPAGES)
+        {
+            uint64_t pages_per_huge = HUGE_PAGE_SIZE / PAGE_SIZE;
+            return palloc_translate(sys->palloc, vpn / pages_per_huge,
+                                    core_id) * pages_per_huge +
+                   vpn % pages_per_huge;
+        }
+        return palloc_translate(sys->palloc, vpn, core_id);
+    }
+
     uint64_t tail = vpn & 0x000fffff;
     uint64_t head = vpn >> 20;
     uint64_t pfn = tail + (core_id << 21) + (head << 21);
     return pfn;
 }
 
+/**
+ * Look up the translation of the given virtual page in the TLBs, walking the
+ * page table on an L2 TLB miss.
+ *
+ * Return the delay in cycles added to the access by the translation.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number to translate (in 4KB pages).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by the translation.
+ */
+uint64_t memsys_tlb_access(MemorySystem *sys, uint64_t vpn, AccessType type,
+                           unsigned int core_id)
+{
+    // With huge pages, one translation covers a whole 2MB region.
+    uint64_t page = vpn;
+    if (HUGEPAGES)
+    {
+        page = vpn / (HUGE_PAGE_SIZE / PAGE_SIZE);
+    }
+
+    TLB *l1tlb = sys->dtlb_coreid[core_id];
+    if (type == ACCESS_TYPE_IFETCH)
+    {
+        l1tlb = sys->itlb_coreid[core_id];
+    }
+
+    if (tlb_lookup(l1tlb, page, HUGEPAGES, core_id))
+    {
+        return 0;
+    }
+
+    uint64_t delay = L2TLB_HIT_LATENCY;
+    sys->access_chain_gap += delay;
+    if (!tlb_lookup(sys->l2tlb, page, HUGEPAGES, core_id))
+    {
+        uint64_t walk_delay = memsys_page_walk(sys, vpn, core_id);
+        sys->stat_tlb_walks++;
+        sys->stat_tlb_walk_delay += walk_delay;
+        delay += walk_delay;
+
+        tlb_install(sys->l2tlb, page, HUGEPAGES, core_id);
+    }
+    tlb_install(l1tlb, page, HUGEPAGES, core_id);
+
+    return delay;
+}
+
+/**
+ * Walk the page table for the given virtual page.
+ *
+ * Without -walk_mem the walk takes a fixed PAGE_WALK_LATENCY. Otherwise the
+ * walker reads one entry per level through the L2 cache, one after another.
+ * Each level's entries are laid out contiguously, 8 bytes apiece, so
+ * neighbouring pages share page table lines just as they would in a real
+ * radix table.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number to translate (in 4KB pages).
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by the walk.
+ */
+uint64_t memsys_page_walk(MemorySystem *sys, uint64_t vpn,
+                          unsigned int core_id)
+{
+    if (!PAGE_WALK_MEM)
+    {
+        sys->access_chain_gap += PAGE_WALK_LATENCY;
+        return PAGE_WALK_LATENCY;
+    }
+
+    unsigned int levels = PAGE_TABLE_LEVELS;
+    if (HUGEPAGES)
+    {
+        levels--;
+    }
+
+    uint64_t delay = 0;
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        uint64_t entry = vpn >> (9 * (PAGE_TABLE_LEVELS - 1 - level));
+        uint64_t pte_addr = PAGE_TABLE_BASE + ((uint64_t)core_id << 36) +
+                            ((uint64_t)level << 32) + entry * 8;
+        delay += memsys_l2_access(sys, pte_addr / CACHE_LINESIZE, false,
+                                  core_id);
+    }
+
+    return delay;
+}
+
 /**
  * Print the statistics of the memory system.
  * 
@@ -673,6 +1186,11 @@ void memsys_print_stats(MemorySystem *sys)
         cache_print_stats(sys->dcache, "DCACHE");
         cache_print_stats(sys->l2cache, "L2CACHE");
         dram_print_stats(sys->dram);
+
+        if (sys->memctrl)
+        {
+            memctrl_print_stats(sys->memctrl);
+        }
     }
 
     if (SIM_MODE == SIM_MODE_DEF)
@@ -684,5 +1202,51 @@ void memsys_print_stats(MemorySystem *sys)
         cache_print_stats(sys->dcache_coreid[1], "DCACHE_1");
         cache_print_stats(sys->l2cache, "L2CACHE");
         dram_print_stats(sys->dram);
+
+        if (sys->memctrl)
+        {
+            memctrl_print_stats(sys->memctrl);
+        }
+
+        if (sys->l2tlb)
+        {
+            double walk_delay_avg = 0.0;
+            if (sys->stat_tlb_walks)
+            {
+                walk_delay_avg = (double)(sys->stat_tlb_walk_delay) /
+                                 (double)(sys->stat_tlb_walks);
+            }
+
+            tlb_print_stats(sys->itlb_coreid[0], "ITLB_0");
+            tlb_print_stats(sys->dtlb_coreid[0], "DTLB_0");
+            tlb_print_stats(sys->itlb_coreid[1], "ITLB_1");
+            tlb_print_stats(sys->dtlb_coreid[1], "DTLB_1");
+            tlb_print_stats(sys->l2tlb, "L2TLB");
+            printf("\n");
+            printf("TLB_WALKS            \t\t : %10llu\n", sys->stat_tlb_walks);
+            printf("TLB_WALK_AVGDELAY    \t\t : %10.3f\n", walk_delay_avg);
+        }
+
+        if (sys->palloc)
+        {
+            palloc_print_stats(sys->palloc);
+        }
     }
 }
+
+/**
+ * Append the per-set and per-page miss counters to the heatmap files.
+ *
+ * @param sys The memory system.
+ */
+void memsys_dump_heatmap(MemorySystem *sys)
+{
+    Cache *caches[] = {sys->dcache, sys->icache, sys->icache_coreid[0],
+                       sys->dcache_coreid[0], sys->icache_coreid[1],
+                       sys->dcache_coreid[1], sys->l2cache};
+    const char *labels[] = {"DCACHE", "ICACHE", "ICACHE_0", "DCACHE_0",
+                            "ICACHE_1", "DCACHE_1", "L2CACHE"};
+
+    heatmap_dump(sys->heatmap, caches, labels,
+                 sizeof(caches) / sizeof(caches[0]));
+}
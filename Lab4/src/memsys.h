@@ -11,6 +11,11 @@
 #include "types.h"
 #include "cache.h"
 #include "dram.h"
+#include "profiler.h"
+#include "heatmap.h"
+#include "tlb.h"
+#include "pagealloc.h"
+#include "memctrl.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //                              DATA STRUCTURES                              //
@@ -69,6 +74,60 @@ typedef struct MemorySystem
      * in memsys_access().
      */
     uint64_t stat_store_delay;
+
+    /** The locality profiler, or NULL if profiling is disabled. */
+    Profiler *prof;
+    /**
+     * The PC of the instruction currently accessing the memory system. This
+     * is set by the core and used to attribute accesses in the profiler.
+     */
+    uint64_t access_pc;
+    /** The type of the access currently being simulated. */
+    AccessType access_type;
+
+    /** The miss heatmap recorder, or NULL if heatmaps are disabled. */
+    Heatmap *heatmap;
+
+    /**
+     * The per-core L1 instruction and data TLBs and the shared L2 TLB. Used
+     * in parts D, E, and F when TLBs are enabled, and NULL otherwise.
+     */
+    TLB *itlb_coreid[2];
+    TLB *dtlb_coreid[2];
+    TLB *l2tlb;
+
+    /**
+     * The physical page allocator. Used in parts D, E, and F unless the
+     * fixed mapping is selected, and NULL otherwise.
+     */
+    PageAllocator *palloc;
+
+    /**
+     * The DRAM memory controller. Used in parts C through F when a scheduler
+     * is selected, and NULL otherwise.
+     */
+    MemController *memctrl;
+    /**
+     * For the access currently being simulated, where the controller reports
+     * the DRAM reads it waits on (NULL if nothing waits), and the delay
+     * statistic their latency is charged to.
+     */
+    MemWait *access_wait;
+    uint64_t *access_stat_delay;
+    /**
+     * For the access currently being simulated, the last DRAM read queued at
+     * the controller on its critical path (-1 if none yet), and the cycles of
+     * lookups since that read's data returned (or since the access started).
+     * A later read of the same access, such as the next level of a page
+     * walk, is only issued once these have passed.
+     */
+    int access_chain;
+    uint64_t access_chain_gap;
+
+    /** The number of L2 TLB misses that required a page walk. */
+    unsigned long long stat_tlb_walks;
+    /** The total number of cycles spent on page walks. */
+    uint64_t stat_tlb_walk_delay;
 } MemorySystem;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -84,6 +143,13 @@ typedef struct MemorySystem
  */
 MemorySystem *memsys_new();
 
+/**
+ * Free the memory system and everything it owns.
+ *
+ * @param sys The memory system.
+ */
+void memsys_free(MemorySystem *sys);
+
 /**
  * Access the given memory address from an instruction fetch or load/store.
  * 
@@ -101,6 +167,42 @@ MemorySystem *memsys_new();
 uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
                        unsigned int core_id);
 
+/**
+ * Access the given memory address as memsys_access() does, but with the DRAM
+ * reads it causes queued at the memory controller, if there is one.
+ *
+ * The returned delay then excludes the time spent in DRAM. Instead, wait is
+ * told how many reads are outstanding and when the last of them returned.
+ *
+ * @param sys The memory system to use for the access.
+ * @param addr The address to access (in bytes).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param wait Where to track the outstanding reads, or NULL if the requester
+ *             does not wait for them.
+ * @return The delay in cycles incurred by this memory access outside DRAM.
+ */
+uint64_t memsys_access_async(MemorySystem *sys, uint64_t addr,
+                             AccessType type, unsigned int core_id,
+                             MemWait *wait);
+
+/**
+ * Simulate one cycle of the parts of the memory system that work in the
+ * background, i.e., the memory controller.
+ *
+ * @param sys The memory system.
+ */
+void memsys_cycle(MemorySystem *sys);
+
+/**
+ * Return the next cycle after the current one in which memsys_cycle() has
+ * anything to do.
+ *
+ * @param sys The memory system.
+ * @return The cycle, or UINT64_MAX if there is nothing left to do.
+ */
+uint64_t memsys_next_cycle(MemorySystem *sys);
+
 /**
  * In mode A, access the given memory address from a load or store.
  * 
@@ -199,6 +301,32 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
 uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
                                    unsigned int core_id);
 
+/**
+ * Look up the translation of the given virtual page in the TLBs, walking the
+ * page table on an L2 TLB miss.
+ *
+ * Return the delay in cycles added to the access by the translation.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number to translate (in 4KB pages).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by the translation.
+ */
+uint64_t memsys_tlb_access(MemorySystem *sys, uint64_t vpn, AccessType type,
+                           unsigned int core_id);
+
+/**
+ * Walk the page table for the given virtual page.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number to translate (in 4KB pages).
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by the walk.
+ */
+uint64_t memsys_page_walk(MemorySystem *sys, uint64_t vpn,
+                          unsigned int core_id);
+
 /**
  * Print the statistics of the memory system.
  * 
@@ -208,4 +336,11 @@ uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
  */
 void memsys_print_stats(MemorySystem *sys);
 
+/**
+ * Append the per-set and per-page miss counters to the heatmap files.
+ *
+ * @param sys The memory system.
+ */
+void memsys_dump_heatmap(MemorySystem *sys);
+
 #endif // __MEMSYS_H__
@@ -0,0 +1,286 @@
+// pagealloc.cpp
+// Defines the physical page allocator and the per-core page tables.
+
+#include "pagealloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The initial number of slots in each page table. */
+#define PALLOC_INITIAL_TABLE_SIZE 1024
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t palloc_hash(uint64_t key, uint64_t size)
+{
+    return (key * 0x9E3779B97F4A7C15ULL) >> 17 & (size - 1);
+}
+
+static inline bool frame_used(PageAllocator *pa, uint64_t frame)
+{
+    return (pa->used[frame / 64] >> (frame % 64)) & 1;
+}
+
+static inline void mark_used(PageAllocator *pa, uint64_t frame)
+{
+    pa->used[frame / 64] |= 1ULL << (frame % 64);
+    pa->num_used++;
+}
+
+/** Return the slot holding vpn, or the empty slot where it belongs. */
+static uint64_t table_find_slot(PageTable *pt, uint64_t vpn)
+{
+    uint64_t slot = palloc_hash(vpn + 1, pt->size);
+    while (pt->vpn[slot] != 0 && pt->vpn[slot] != vpn + 1)
+    {
+        slot = (slot + 1) & (pt->size - 1);
+    }
+    return slot;
+}
+
+static void table_init(PageTable *pt, uint64_t size)
+{
+    pt->vpn = (uint64_t *)calloc(size, sizeof(uint64_t));
+    pt->pfn = (uint64_t *)calloc(size, sizeof(uint64_t));
+    pt->size = size;
+    pt->count = 0;
+}
+
+/** Double the size of the page table, rehashing every mapping. */
+static void table_grow(PageTable *pt)
+{
+    PageTable old = *pt;
+    table_init(pt, old.size * 2);
+
+    for (uint64_t i = 0; i < old.size; i++)
+    {
+        if (old.vpn[i])
+        {
+            uint64_t slot = table_find_slot(pt, old.vpn[i] - 1);
+            pt->vpn[slot] = old.vpn[i];
+            pt->pfn[slot] = old.pfn[i];
+            pt->count++;
+        }
+    }
+
+    free(old.vpn);
+    free(old.pfn);
+}
+
+/** Return the first free frame at or after frame, wrapping around. */
+static uint64_t find_free_frame(PageAllocator *pa, uint64_t frame)
+{
+    for (uint64_t i = 0; i < pa->num_frames; i++)
+    {
+        if (!frame_used(pa, frame))
+        {
+            return frame;
+        }
+        frame = (frame + 1) % pa->num_frames;
+    }
+
+    fprintf(stderr, "Error: out of physical memory (%llu frames)\n",
+            (unsigned long long)pa->num_frames);
+    exit(1);
+}
+
+/**
+ * Take the next free frame of the given colour.
+ *
+ * @return Whether the colour still had a free frame.
+ */
+static bool alloc_in_colour(PageAllocator *pa, uint64_t colour,
+                            uint64_t *frame)
+{
+    while (true)
+    {
+        uint64_t f = colour + pa->next_in_colour[colour] * pa->num_colours;
+        if (f >= pa->num_frames)
+        {
+            return false;
+        }
+
+        pa->next_in_colour[colour]++;
+        if (!frame_used(pa, f))
+        {
+            *frame = f;
+            return true;
+        }
+    }
+}
+
+/** Choose a frame for a new page of the given core. */
+static uint64_t alloc_frame(PageAllocator *pa, unsigned int core_id)
+{
+    uint64_t frame = 0;
+
+    switch (pa->policy)
+    {
+    case PAGE_RANDOM:
+    {
+        // xorshift64
+        pa->rng_state ^= pa->rng_state << 13;
+        pa->rng_state ^= pa->rng_state >> 7;
+        pa->rng_state ^= pa->rng_state << 17;
+        frame = find_free_frame(pa, pa->rng_state % pa->num_frames);
+        break;
+    }
+
+    case PAGE_BANK_AWARE:
+    case PAGE_COLOUR:
+    {
+        // Deal pages round-robin over the core's own colours. If they are
+        // all full, borrow from any colour.
+        uint64_t first = pa->first_colour[core_id];
+        uint64_t count = pa->last_colour[core_id] - first;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint64_t colour = pa->next_colour[core_id];
+            pa->next_colour[core_id] = first + (colour - first + 1) % count;
+            if (alloc_in_colour(pa, colour, &frame))
+            {
+                return frame;
+            }
+        }
+        frame = find_free_frame(pa, 0);
+        break;
+    }
+
+    case PAGE_FIRST_TOUCH:
+    default:
+        frame = find_free_frame(pa, pa->next_frame);
+        pa->next_frame = (frame + 1) % pa->num_frames;
+        break;
+    }
+
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a page allocator.
+ *
+ * @param policy The allocation policy. Must not be PAGE_FIXED.
+ * @param num_frames The number of physical frames.
+ * @param num_colours For the colour policies, the number of colours.
+ * @param num_cores The number of cores. For the colour policies, each core
+ *                  gets an equal share of the colours.
+ * @return A pointer to the allocator.
+ */
+PageAllocator *palloc_new(PagePolicy policy, uint64_t num_frames,
+                          uint64_t num_colours, unsigned int num_cores)
+{
+    PageAllocator *pa = (PageAllocator *)calloc(1, sizeof(PageAllocator));
+    pa->policy = policy;
+    pa->num_frames = num_frames;
+    pa->used = (uint64_t *)calloc((num_frames + 63) / 64, sizeof(uint64_t));
+    pa->rng_state = 0x2545F4914F6CDD1DULL;
+
+    pa->num_colours = num_colours ? num_colours : 1;
+    pa->next_in_colour = (uint64_t *)calloc(pa->num_colours,
+                                            sizeof(uint64_t));
+
+    for (unsigned int i = 0; i < PALLOC_MAX_CORES; i++)
+    {
+        if (pa->num_colours >= num_cores && i < num_cores)
+        {
+            // Partition the colours between the cores.
+            pa->first_colour[i] = pa->num_colours * i / num_cores;
+            pa->last_colour[i] = pa->num_colours * (i + 1) / num_cores;
+        }
+        else
+        {
+            // Too few colours to partition; every core shares all of them.
+            pa->first_colour[i] = 0;
+            pa->last_colour[i] = pa->num_colours;
+        }
+        pa->next_colour[i] = pa->first_colour[i];
+
+        table_init(&pa->table[i], PALLOC_INITIAL_TABLE_SIZE);
+    }
+
+    return pa;
+}
+
+/**
+ * Translate a virtual page number to a physical frame number, allocating a
+ * frame if the page has not been touched before.
+ *
+ * @param pa The page allocator.
+ * @param vpn The virtual page number.
+ * @param core_id The CPU core ID whose address space the page is in.
+ * @return The physical frame number.
+ */
+uint64_t palloc_translate(PageAllocator *pa, uint64_t vpn,
+                          unsigned int core_id)
+{
+    PageTable *pt = &pa->table[core_id];
+
+    uint64_t slot = table_find_slot(pt, vpn);
+    if (pt->vpn[slot])
+    {
+        return pt->pfn[slot];
+    }
+
+    // First touch: allocate a frame and map it.
+    uint64_t frame = alloc_frame(pa, core_id);
+    mark_used(pa, frame);
+
+    if (2 * (pt->count + 1) > pt->size)
+    {
+        table_grow(pt);
+        slot = table_find_slot(pt, vpn);
+    }
+    pt->vpn[slot] = vpn + 1;
+    pt->pfn[slot] = frame;
+    pt->count++;
+
+    return frame;
+}
+
+/**
+ * Print the statistics of the page allocator.
+ *
+ * @param pa The page allocator.
+ */
+void palloc_print_stats(PageAllocator *pa)
+{
+    printf("\n");
+    printf("PAGE_ALLOC_FRAMES    \t\t : %10llu\n",
+           (unsigned long long)pa->num_frames);
+    printf("PAGE_ALLOC_USED      \t\t : %10llu\n",
+           (unsigned long long)pa->num_used);
+    for (unsigned int i = 0; i < PALLOC_MAX_CORES; i++)
+    {
+        if (pa->table[i].count)
+        {
+            printf("PAGE_ALLOC_CORE_%01u_PAGES \t : %10llu\n", i,
+                   (unsigned long long)pa->table[i].count);
+        }
+    }
+}
+
+/**
+ * Free a page allocator and its page tables.
+ *
+ * @param pa The page allocator.
+ */
+void palloc_free(PageAllocator *pa)
+{
+    for (unsigned int i = 0; i < PALLOC_MAX_CORES; i++)
+    {
+        free(pa->table[i].vpn);
+        free(pa->table[i].pfn);
+    }
+    free(pa->used);
+    free(pa->next_in_colour);
+    free(pa);
+}
@@ -0,0 +1,130 @@
+// pagealloc.h
+// Declares the physical page allocator and the per-core page tables.
+//
+// The allocator hands out physical frames on the first touch of each virtual
+// page and remembers the mapping in a page table per core. How a free frame
+// is chosen depends on the policy. The colour-based policies rely on the
+// frame's colour being its frame number modulo the number of colours, which
+// holds for both L2 set colours and DRAM bank colours because both are
+// selected by the address bits just above the page offset. XOR bank hashing
+// and line interleaving break this for bank colours, so the bank-aware policy
+// rejects them.
+
+#ifndef __PAGEALLOC_H__
+#define __PAGEALLOC_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The maximum number of cores with a page table. */
+#define PALLOC_MAX_CORES 2
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Possible physical page allocation policies. */
+typedef enum PagePolicyEnum
+{
+    /** The fixed mapping of memsys_convert_vpn_to_pfn(); no allocator. */
+    PAGE_FIXED = 0,
+    /** Hand out frames in order, shared by all cores. */
+    PAGE_FIRST_TOUCH = 1,
+    /** Hand out a uniformly random free frame. */
+    PAGE_RANDOM = 2,
+    /** Give each core its own DRAM bank colours, spreading pages over them. */
+    PAGE_BANK_AWARE = 3,
+    /** Give each core its own L2 cache colours, spreading pages over them. */
+    PAGE_COLOUR = 4,
+} PagePolicy;
+
+/** A per-core page table: an open-addressed hash table from VPN to PFN. */
+typedef struct PageTable
+{
+    /** VPN + 1 of the mapping in each slot (slot empty if 0). */
+    uint64_t *vpn;
+    uint64_t *pfn;
+    /** The number of slots (a power of two). */
+    uint64_t size;
+    /** The number of mappings. */
+    uint64_t count;
+} PageTable;
+
+/** The physical page allocator. */
+typedef struct PageAllocator
+{
+    PagePolicy policy;
+
+    /** The number of physical frames. */
+    uint64_t num_frames;
+    /** One bit per frame, set if the frame is allocated. */
+    uint64_t *used;
+    /** The number of allocated frames. */
+    uint64_t num_used;
+
+    /** For PAGE_FIRST_TOUCH, the next frame to try. */
+    uint64_t next_frame;
+
+    /** For the colour policies, the number of colours. */
+    uint64_t num_colours;
+    /** For the colour policies, the next frame index to try in each colour. */
+    uint64_t *next_in_colour;
+    /** For the colour policies, the colours [first, last) of each core. */
+    uint64_t first_colour[PALLOC_MAX_CORES];
+    uint64_t last_colour[PALLOC_MAX_CORES];
+    /** For the colour policies, the colour of each core's next page. */
+    uint64_t next_colour[PALLOC_MAX_CORES];
+
+    /** For PAGE_RANDOM, the state of the xorshift generator. */
+    uint64_t rng_state;
+
+    PageTable table[PALLOC_MAX_CORES];
+} PageAllocator;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a page allocator.
+ *
+ * @param policy The allocation policy. Must not be PAGE_FIXED.
+ * @param num_frames The number of physical frames.
+ * @param num_colours For the colour policies, the number of colours.
+ * @param num_cores The number of cores. For the colour policies, each core
+ *                  gets an equal share of the colours.
+ * @return A pointer to the allocator.
+ */
+PageAllocator *palloc_new(PagePolicy policy, uint64_t num_frames,
+                          uint64_t num_colours, unsigned int num_cores);
+
+/**
+ * Translate a virtual page number to a physical frame number, allocating a
+ * frame if the page has not been touched before.
+ *
+ * @param pa The page allocator.
+ * @param vpn The virtual page number.
+ * @param core_id The CPU core ID whose address space the page is in.
+ * @return The physical frame number.
+ */
+uint64_t palloc_translate(PageAllocator *pa, uint64_t vpn,
+                          unsigned int core_id);
+
+/**
+ * Print the statistics of the page allocator.
+ *
+ * @param pa The page allocator.
+ */
+void palloc_print_stats(PageAllocator *pa);
+
+/**
+ * Free a page allocator and its page tables.
+ *
+ * @param pa The page allocator.
+ */
+void palloc_free(PageAllocator *pa);
+
+#endif // __PAGEALLOC_H__
@@ -0,0 +1,420 @@
+// profiler.cpp
+// Defines the reuse-distance and per-PC locality profiler.
+
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of slots in the per-PC hash table. */
+#define PROF_PC_TABLE_SIZE (2 * PROF_MAX_PCS)
+
+/**
+ * The fraction of a PC's accesses that must repeat the previous stride for
+ * the PC to be classified as streaming or strided.
+ */
+#define PROF_REGULAR_THRESHOLD 0.5
+
+///////////////////////////////////////////////////////////////////////////////
+//                              HELPER FUNCTIONS                             //
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t prof_hash(uint64_t key, uint64_t size)
+{
+    return (key * 0x9E3779B97F4A7C15ULL) >> 17 & (size - 1);
+}
+
+static inline unsigned int prof_bucket(uint64_t distance)
+{
+    if (distance == 0)
+    {
+        return 0;
+    }
+
+    unsigned int bucket = 64 - __builtin_clzll(distance);
+    if (bucket > PROF_NUM_BUCKETS - 2)
+    {
+        bucket = PROF_NUM_BUCKETS - 2;
+    }
+    return bucket;
+}
+
+static void fenwick_add(ReuseTracker *rt, uint64_t t, int32_t value)
+{
+    for (; t <= rt->max_time; t += t & (~t + 1))
+    {
+        rt->fenwick[t] += value;
+    }
+}
+
+static uint64_t fenwick_sum(ReuseTracker *rt, uint64_t t)
+{
+    uint64_t sum = 0;
+    for (; t > 0; t -= t & (~t + 1))
+    {
+        sum += rt->fenwick[t];
+    }
+    return sum;
+}
+
+/** Return the hash slot holding key, or the empty slot where it belongs. */
+static uint64_t rt_find_slot(ReuseTracker *rt, uint64_t key)
+{
+    uint64_t slot = prof_hash(key, rt->hash_size);
+    while (rt->hash_line[slot] != 0 && rt->hash_line[slot] != key)
+    {
+        slot = (slot + 1) & (rt->hash_size - 1);
+    }
+    return slot;
+}
+
+/** Remove the key in the given slot, shifting back later probes. */
+static void rt_erase_slot(ReuseTracker *rt, uint64_t slot)
+{
+    uint64_t mask = rt->hash_size - 1;
+    uint64_t hole = slot;
+    uint64_t next = (slot + 1) & mask;
+
+    while (rt->hash_line[next] != 0)
+    {
+        uint64_t home = prof_hash(rt->hash_line[next], rt->hash_size);
+        // Move the entry into the hole unless its home lies cyclically in
+        // (hole, next].
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            rt->hash_line[hole] = rt->hash_line[next];
+            rt->hash_time[hole] = rt->hash_time[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    rt->hash_line[hole] = 0;
+    rt->num_lines--;
+}
+
+/** Renumber the live timestamps to 1..num_lines and rebuild the tree. */
+static void rt_compact(ReuseTracker *rt)
+{
+    uint64_t t_new = 0;
+    for (uint64_t t = rt->oldest; t <= rt->now; t++)
+    {
+        uint64_t key = rt->time_line[t];
+        if (key == 0)
+        {
+            continue;
+        }
+
+        rt->time_line[t] = 0;
+        rt->time_line[++t_new] = key;
+        rt->hash_time[rt_find_slot(rt, key)] = t_new;
+    }
+
+    memset(rt->fenwick, 0, (rt->max_time + 1) * sizeof(uint32_t));
+    for (uint64_t t = 1; t <= t_new; t++)
+    {
+        fenwick_add(rt, t, 1);
+    }
+
+    rt->now = t_new;
+    rt->oldest = 1;
+}
+
+static ReuseTracker *rt_new(uint64_t max_lines)
+{
+    ReuseTracker *rt = (ReuseTracker *)calloc(1, sizeof(ReuseTracker));
+
+    rt->max_lines = max_lines;
+    rt->hash_size = 1;
+    while (rt->hash_size < 2 * max_lines)
+    {
+        rt->hash_size <<= 1;
+    }
+    rt->hash_line = (uint64_t *)calloc(rt->hash_size, sizeof(uint64_t));
+    rt->hash_time = (uint64_t *)calloc(rt->hash_size, sizeof(uint64_t));
+
+    rt->max_time = 4 * max_lines;
+    rt->fenwick = (uint32_t *)calloc(rt->max_time + 1, sizeof(uint32_t));
+    rt->time_line = (uint64_t *)calloc(rt->max_time + 1, sizeof(uint64_t));
+    rt->oldest = 1;
+
+    return rt;
+}
+
+/** Record an access to the given line and return its histogram bucket. */
+static unsigned int rt_access(ReuseTracker *rt, uint64_t line_addr)
+{
+    // Keys are offset by one so that 0 can mark an empty slot.
+    uint64_t key = line_addr + 1;
+    uint64_t slot = rt_find_slot(rt, key);
+    unsigned int bucket;
+
+    if (rt->hash_line[slot] == key)
+    {
+        uint64_t t = rt->hash_time[slot];
+        bucket = prof_bucket(fenwick_sum(rt, rt->now) - fenwick_sum(rt, t));
+        fenwick_add(rt, t, -1);
+        rt->time_line[t] = 0;
+    }
+    else
+    {
+        bucket = PROF_NUM_BUCKETS - 1;
+
+        if (rt->num_lines == rt->max_lines)
+        {
+            // Forget the least recently used line.
+            while (rt->time_line[rt->oldest] == 0)
+            {
+                rt->oldest++;
+            }
+            uint64_t victim = rt->time_line[rt->oldest];
+            fenwick_add(rt, rt->oldest, -1);
+            rt->time_line[rt->oldest] = 0;
+            rt_erase_slot(rt, rt_find_slot(rt, victim));
+            slot = rt_find_slot(rt, key);
+        }
+
+        rt->hash_line[slot] = key;
+        rt->num_lines++;
+    }
+
+    if (rt->now == rt->max_time)
+    {
+        rt_compact(rt);
+    }
+
+    rt->now++;
+    fenwick_add(rt, rt->now, 1);
+    rt->time_line[rt->now] = key;
+    rt->hash_time[slot] = rt->now;
+    rt->hist[bucket]++;
+
+    return bucket;
+}
+
+/** Find or allocate the entry for pc, falling back to the overflow entry. */
+static ProfPCEntry *prof_pc_entry(Profiler *prof, uint64_t pc)
+{
+    uint64_t slot = prof_hash(pc + 1, PROF_PC_TABLE_SIZE);
+    while (prof->pcs[slot].valid && prof->pcs[slot].pc != pc)
+    {
+        slot = (slot + 1) & (PROF_PC_TABLE_SIZE - 1);
+    }
+
+    if (!prof->pcs[slot].valid)
+    {
+        if (prof->num_pcs == PROF_MAX_PCS)
+        {
+            return &prof->other;
+        }
+        prof->pcs[slot].valid = true;
+        prof->pcs[slot].pc = pc;
+        prof->num_pcs++;
+    }
+
+    return &prof->pcs[slot];
+}
+
+static ProfPattern prof_classify(Profiler *prof, ProfPCEntry *e)
+{
+    if (e->access > 1 && (double)e->stride_repeat >=
+                             PROF_REGULAR_THRESHOLD * (double)(e->access - 1))
+    {
+        uint64_t stride = e->last_stride < 0 ? -e->last_stride
+                                             : e->last_stride;
+        return (stride <= prof->line_size) ? PROF_PATTERN_STREAM
+                                           : PROF_PATTERN_STRIDE;
+    }
+    return PROF_PATTERN_PTRCHASE;
+}
+
+static bool prof_cmp_miss(const ProfPCEntry *a, const ProfPCEntry *b)
+{
+    if (a->miss[PROF_LEVEL_L2] != b->miss[PROF_LEVEL_L2])
+    {
+        return a->miss[PROF_LEVEL_L2] > b->miss[PROF_LEVEL_L2];
+    }
+    return a->miss[PROF_LEVEL_L1] > b->miss[PROF_LEVEL_L1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a profiler.
+ *
+ * @param line_size The cache line size in bytes.
+ * @param max_lines The number of distinct lines each reuse-distance tracker
+ *                  remembers; this bounds the largest distance measured.
+ * @return A pointer to the profiler.
+ */
+Profiler *prof_new(uint64_t line_size, uint64_t max_lines)
+{
+    Profiler *prof = (Profiler *)calloc(1, sizeof(Profiler));
+    prof->line_size = line_size;
+    prof->pcs = (ProfPCEntry *)calloc(PROF_PC_TABLE_SIZE,
+                                      sizeof(ProfPCEntry));
+
+    for (unsigned int level = 0; level < PROF_NUM_LEVELS; level++)
+    {
+        for (unsigned int i = 0; i < PROF_MAX_CORES; i++)
+        {
+            prof->tracker[level][i] = rt_new(max_lines);
+        }
+    }
+
+    return prof;
+}
+
+/**
+ * Record a data access at the given cache level.
+ *
+ * @param prof The profiler.
+ * @param level The cache level that was accessed.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the load or store instruction.
+ * @param addr The byte address accessed. For L2 accesses only the line
+ *             address matters.
+ * @param is_miss Whether the access missed at this level.
+ */
+void prof_record(Profiler *prof, ProfLevel level, unsigned int core_id,
+                 uint64_t pc, uint64_t addr, bool is_miss)
+{
+    unsigned int bucket = rt_access(prof->tracker[level][core_id],
+                                    addr / prof->line_size);
+    ProfPCEntry *e = prof_pc_entry(prof, pc);
+
+    if (is_miss)
+    {
+        e->miss[level]++;
+    }
+
+    if (level != PROF_LEVEL_L1)
+    {
+        return;
+    }
+
+    if (e->access > 0)
+    {
+        int64_t stride = (int64_t)(addr - e->last_addr);
+        if (e->access > 1 && stride == e->last_stride)
+        {
+            e->stride_repeat++;
+        }
+        e->last_stride = stride;
+    }
+    e->last_addr = addr;
+    e->access++;
+    e->hist[bucket]++;
+}
+
+/**
+ * Print the reuse-distance histograms and the top PCs by miss contribution.
+ *
+ * @param prof The profiler.
+ * @param top_n The number of PCs to print.
+ */
+void prof_print_stats(Profiler *prof, unsigned int top_n)
+{
+    static const char *level_names[PROF_NUM_LEVELS] = {"L1D", "L2"};
+    static const char *pattern_names[] = {"STREAM", "STRIDE", "PTRCHASE"};
+
+    printf("\n");
+    printf("PROF_REUSE_BUCKETS   \t\t :          0");
+    for (unsigned int b = 1; b < PROF_NUM_BUCKETS - 1; b++)
+    {
+        printf(" %llu", 1ULL << (b - 1));
+    }
+    printf(" COLD\n");
+
+    for (unsigned int level = 0; level < PROF_NUM_LEVELS; level++)
+    {
+        for (unsigned int i = 0; i < PROF_MAX_CORES; i++)
+        {
+            ReuseTracker *rt = prof->tracker[level][i];
+            if (rt->now == 0)
+            {
+                continue;
+            }
+
+            printf("PROF_%s_%01u_REUSE    \t\t :", level_names[level], i);
+            for (unsigned int b = 0; b < PROF_NUM_BUCKETS; b++)
+            {
+                printf(" %llu", rt->hist[b]);
+            }
+            printf("\n");
+        }
+    }
+
+    ProfPCEntry **order = (ProfPCEntry **)calloc(prof->num_pcs + 1,
+                                                 sizeof(ProfPCEntry *));
+    unsigned int n = 0;
+    for (unsigned int slot = 0; slot < PROF_PC_TABLE_SIZE; slot++)
+    {
+        if (prof->pcs[slot].valid)
+        {
+            order[n++] = &prof->pcs[slot];
+        }
+    }
+
+    unsigned int shown = (top_n < n) ? top_n : n;
+    std::partial_sort(order, order + shown, order + n, prof_cmp_miss);
+
+    printf("\n");
+    printf("PROF_NUM_PCS         \t\t : %10u\n", n);
+    for (unsigned int r = 0; r < shown; r++)
+    {
+        ProfPCEntry *e = order[r];
+        printf("PROF_TOP_PC_%02u       \t\t : 0x%08llx access %llu "
+               "l1_miss %llu l2_miss %llu %s\n",
+               r, (unsigned long long)e->pc, e->access,
+               e->miss[PROF_LEVEL_L1], e->miss[PROF_LEVEL_L2],
+               pattern_names[prof_classify(prof, e)]);
+
+        printf("PROF_TOP_PC_%02u_REUSE \t\t :", r);
+        for (unsigned int b = 0; b < PROF_NUM_BUCKETS; b++)
+        {
+            printf(" %llu", e->hist[b]);
+        }
+        printf("\n");
+    }
+
+    if (prof->other.access != 0 || prof->other.miss[PROF_LEVEL_L2] != 0)
+    {
+        printf("PROF_OTHER_PCS       \t\t : access %llu l1_miss %llu "
+               "l2_miss %llu\n",
+               prof->other.access, prof->other.miss[PROF_LEVEL_L1],
+               prof->other.miss[PROF_LEVEL_L2]);
+    }
+
+    free(order);
+}
+
+/**
+ * Free a profiler and its reuse-distance trackers.
+ *
+ * @param prof The profiler.
+ */
+void prof_free(Profiler *prof)
+{
+    for (unsigned int level = 0; level < PROF_NUM_LEVELS; level++)
+    {
+        for (unsigned int i = 0; i < PROF_MAX_CORES; i++)
+        {
+            ReuseTracker *rt = prof->tracker[level][i];
+            free(rt->hash_line);
+            free(rt->hash_time);
+            free(rt->fenwick);
+            free(rt->time_line);
+            free(rt);
+        }
+    }
+    free(prof->pcs);
+    free(prof);
+}
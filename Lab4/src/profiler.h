@@ -0,0 +1,180 @@
+// profiler.h
+// Declares the reuse-distance and per-PC locality profiler.
+//
+// The profiler observes the data accesses that reach the L1 data caches and
+// the L2 cache. For each core and level it keeps a histogram of reuse
+// distances (the number of distinct cache lines touched between two accesses
+// to the same line), and for each load/store PC it keeps miss counts and a
+// guess at the PC's access pattern. All tables have a fixed capacity, so the
+// memory footprint does not grow with the length of the trace.
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The maximum number of cores the profiler keeps separate histograms for. */
+#define PROF_MAX_CORES 2
+
+/**
+ * The number of reuse-distance histogram buckets.
+ *
+ * Bucket 0 counts a distance of 0, bucket b (b >= 1) counts distances in
+ * [2^(b-1), 2^b), and the last bucket counts cold accesses and accesses whose
+ * distance exceeds what the tracker can see.
+ */
+#define PROF_NUM_BUCKETS 24
+
+/** The number of PCs tracked individually. Further PCs are lumped together. */
+#define PROF_MAX_PCS 4096
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The cache levels the profiler records. */
+typedef enum ProfLevelEnum
+{
+    PROF_LEVEL_L1 = 0, // Accesses to an L1 data cache.
+    PROF_LEVEL_L2 = 1, // Demand accesses to the L2 cache.
+    PROF_NUM_LEVELS
+} ProfLevel;
+
+/** The access pattern classes reported for each PC. */
+typedef enum ProfPatternEnum
+{
+    PROF_PATTERN_STREAM = 0, // Constant stride of at most one cache line.
+    PROF_PATTERN_STRIDE = 1, // Constant stride larger than one cache line.
+
+    /**
+     * No stable stride. The trace does not carry loaded values, so this is
+     * where pointer-chasing loads end up.
+     */
+    PROF_PATTERN_PTRCHASE = 2,
+} ProfPattern;
+
+/**
+ * Tracks the reuse distance of a stream of cache line addresses.
+ *
+ * Every access gets a timestamp, and a Fenwick tree over the timestamps marks
+ * which of them is the latest access to its line. The reuse distance of an
+ * access is then the number of marks after the previous access to the same
+ * line. At most max_lines lines are remembered; when the table is full, the
+ * least recently used line is forgotten, and timestamps are compacted when
+ * they run out.
+ */
+typedef struct ReuseTracker
+{
+    /** The maximum number of lines remembered. */
+    uint64_t max_lines;
+    /** The number of lines currently remembered. */
+    uint64_t num_lines;
+
+    /** Open-addressed hash table of line addresses (slot empty if 0). */
+    uint64_t *hash_line;
+    /** The timestamp of the latest access to the line in each slot. */
+    uint64_t *hash_time;
+    /** The number of hash table slots (a power of two). */
+    uint64_t hash_size;
+
+    /** Fenwick tree over timestamps, 1-based. */
+    uint32_t *fenwick;
+    /** The line address each timestamp belongs to (0 if stale). */
+    uint64_t *time_line;
+    /** The number of timestamps available before compaction. */
+    uint64_t max_time;
+    /** The last timestamp handed out. */
+    uint64_t now;
+    /** The oldest timestamp that may still be live. */
+    uint64_t oldest;
+
+    /** The reuse-distance histogram. */
+    unsigned long long hist[PROF_NUM_BUCKETS];
+} ReuseTracker;
+
+/** Per-PC locality statistics. */
+typedef struct ProfPCEntry
+{
+    /** Whether this entry is in use. */
+    bool valid;
+    /** The PC. */
+    uint64_t pc;
+    unsigned long long access;
+    unsigned long long miss[PROF_NUM_LEVELS];
+
+    /** The last byte address accessed by this PC. */
+    uint64_t last_addr;
+    /** The last observed stride in bytes. */
+    int64_t last_stride;
+    /** The number of accesses whose stride matched the previous stride. */
+    unsigned long long stride_repeat;
+
+    /** The histogram of L1 reuse distances of this PC's accesses. */
+    unsigned long long hist[PROF_NUM_BUCKETS];
+} ProfPCEntry;
+
+/** The locality profiler. */
+typedef struct Profiler
+{
+    /** The cache line size in bytes, used to classify strides. */
+    uint64_t line_size;
+
+    /** Reuse-distance trackers, indexed by [level][core]. */
+    ReuseTracker *tracker[PROF_NUM_LEVELS][PROF_MAX_CORES];
+
+    /** Open-addressed per-PC table. */
+    ProfPCEntry *pcs;
+    /** The number of PCs in the table. */
+    unsigned int num_pcs;
+    /** Aggregate statistics of PCs that did not fit in the table. */
+    ProfPCEntry other;
+} Profiler;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a profiler.
+ *
+ * @param line_size The cache line size in bytes.
+ * @param max_lines The number of distinct lines each reuse-distance tracker
+ *                  remembers; this bounds the largest distance measured.
+ * @return A pointer to the profiler.
+ */
+Profiler *prof_new(uint64_t line_size, uint64_t max_lines);
+
+/**
+ * Record a data access at the given cache level.
+ *
+ * @param prof The profiler.
+ * @param level The cache level that was accessed.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the load or store instruction.
+ * @param addr The byte address accessed. For L2 accesses only the line
+ *             address matters.
+ * @param is_miss Whether the access missed at this level.
+ */
+void prof_record(Profiler *prof, ProfLevel level, unsigned int core_id,
+                 uint64_t pc, uint64_t addr, bool is_miss);
+
+/**
+ * Print the reuse-distance histograms and the top PCs by miss contribution.
+ *
+ * @param prof The profiler.
+ * @param top_n The number of PCs to print.
+ */
+void prof_print_stats(Profiler *prof, unsigned int top_n);
+
+/**
+ * Free a profiler and its reuse-distance trackers.
+ *
+ * @param prof The profiler.
+ */
+void prof_free(Profiler *prof);
+
+#endif // __PROFILER_H__
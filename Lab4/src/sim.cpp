@@ -9,70 +9,17 @@
 #include "types.h"
 #include "memsys.h"
 #include "core.h"
+#include "config.h"
+#include "eventq.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <algorithm>
 
 #define MAX_CORES 2
 #define PRINT_DOTS 1
 #define DOT_INTERVAL 100000
 
-/**
- * The current mode under which the simulation is running, corresponding to
- * which part of the lab is being evaluated.
- */
-Mode SIM_MODE = SIM_MODE_A;
-
-/** The number of bytes in a cache line. */
-uint64_t CACHE_LINESIZE = 64;
-
-/** The replacement policy to use for the L1 data and instruction caches. */
-ReplacementPolicy REPL_POLICY = LRU;
-
-/** The size of the data cache in bytes. */
-uint64_t DCACHE_SIZE = 32 * 1024;
-
-/** The associativity of the data cache. */
-uint64_t DCACHE_ASSOC = 8;
-
-/** The size of the instruction cache in bytes. */
-uint64_t ICACHE_SIZE = 32 * 1024;
-
-/** The associativity of the instruction cache. */
-uint64_t ICACHE_ASSOC = 8;
-
-/** The size of the L2 cache in bytes. */
-uint64_t L2CACHE_SIZE = 1024 * 1024;
-
-/** The associativity of the L2 cache. */
-uint64_t L2CACHE_ASSOC = 16;
-
-/** The replacement policy to use for the L2 cache. */
-ReplacementPolicy L2CACHE_REPL = LRU;
-
-/**
- * For static way partitioning, the quota of ways in each set that can be
- * assigned to core 0.
- * 
- * The remaining number of ways is the quota for core 1.
- * 
- * This is used to implement extra credit part E.
- */
-unsigned int SWP_CORE0_WAYS = 0;
-
-/** The number of cores being simulated. */
-unsigned int NUM_CORES = 0;
-
-/** Which page policy the DRAM should use. */
-DRAMPolicy DRAM_PAGE_POLICY = OPEN_PAGE;
-
-/**
- * The current clock cycle number.
- * 
- * This can be used as a timestamp for implementing the LRU replacement policy.
- */
-uint64_t current_cycle;
-
 MemorySystem *memsys;
 Core *core[MAX_CORES];
 const char *trace_filename[MAX_CORES];
@@ -91,7 +38,6 @@ int main(int argc, char **argv)
         return status;
     }
 
-    srand(42);
     memsys = memsys_new();
     for (unsigned int i = 0; i < NUM_CORES; i++)
     {
@@ -100,16 +46,33 @@ int main(int argc, char **argv)
 
     print_dots();
 
-    // Iterate until all cores are done.
-    bool all_cores_done = false;
-    while (!all_cores_done)
+    // Queue the first cycle of every core.
+    EventQueue *events = eventq_new(NUM_CORES);
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        if (!core[i]->done)
+        {
+            eventq_push(events, current_cycle, i);
+        }
+    }
+
+    // Iterate until all cores are done, jumping from each cycle to the next
+    // one in which a core wakes up, the memory system has work to do, or a
+    // dot is due.
+    while (true)
     {
-        all_cores_done = true;
+        // Requests whose data arrives this cycle complete before the cores
+        // run.
+        memsys_cycle(memsys);
 
-        for (unsigned int i = 0; i < NUM_CORES; i++)
+        while (eventq_next_cycle(events) <= current_cycle)
         {
+            unsigned int i = eventq_pop(events);
             core_cycle(core[i]);
-            all_cores_done = all_cores_done && core[i]->done;
+            if (!core[i]->done)
+            {
+                eventq_push(events, core_next_cycle(core[i]), i);
+            }
         }
 
         if (current_cycle - last_printdot_cycle >= DOT_INTERVAL)
@@ -117,8 +80,21 @@ int main(int argc, char **argv)
             print_dots();
         }
 
-        current_cycle++;
+        if (eventq_next_cycle(events) == UINT64_MAX)
+        {
+            break;
+        }
+
+        uint64_t next = eventq_next_cycle(events);
+        if (next > current_cycle + 1)
+        {
+            next = std::min(next, std::min(memsys_next_cycle(memsys),
+                                           last_printdot_cycle + DOT_INTERVAL));
+        }
+        current_cycle = next;
     }
+    current_cycle++;
+    eventq_free(events);
 
     print_stats();
     return 0;
@@ -143,145 +119,19 @@ int parse_args(int argc, char **argv)
                 print_usage(argv[0]);
                 return 2;
             }
-
-            else if (strcasecmp(argv[i], "-mode") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -mode\n");
-                    return 2;
-                }
-
-                int mode = atoi(argv[i]);
-                if (mode < 1 || mode > 4)
-                {
-                    fprintf(stderr, "Error: mode must be between 1 and 4\n");
-                    if (mode == 5)
-                    {
-                        fprintf(stderr, "Note: for part E, use -mode 4 "
-                                        "-L2repl 2\n");
-                    }
-                    if (mode == 6)
-                    {
-                        fprintf(stderr, "Note: for part F, use -mode 4 "
-                                        "-L2repl 3\n");
-                    }
-                    return 2;
-                }
-
-                SIM_MODE = (Mode)mode;
-            }
-
-            else if (strcasecmp(argv[i], "-linesize") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -linesize\n");
-                    return 2;
-                }
-                CACHE_LINESIZE = atoi(argv[i]);
-            }
-
-            else if (strcasecmp(argv[i], "-repl") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -repl\n");
-                    return 2;
-                }
-
-                int repl = atoi(argv[i]);
-                if (repl < 0 || repl > 3)
-                {
-                    fprintf(stderr, "Error: repl must be between 0 and 3\n");
-                    return 2;
-                }
-
-                REPL_POLICY = (ReplacementPolicy)repl;
-            }
-
-            else if (strcasecmp(argv[i], "-DsizeKB") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -DsizeKB\n");
-                    return 2;
-                }
-                DCACHE_SIZE = atoi(argv[i]) * 1024;
-            }
-
-            else if (strcasecmp(argv[i], "-Dassoc") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -Dassoc\n");
-                    return 2;
-                }
-                DCACHE_ASSOC = atoi(argv[i]);
-            }
-
-            else if (strcasecmp(argv[i], "-L2sizeKB") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -L2sizeKB\n");
-                    return 2;
-                }
-                L2CACHE_SIZE = atoi(argv[i]) * 1024;
-            }
-
-            else if (strcasecmp(argv[i], "-L2repl") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to -L2repl\n");
-                    return 2;
-                }
-
-                int l2repl = atoi(argv[i]);
-                if (l2repl < 0 || l2repl > 3)
-                {
-                    fprintf(stderr, "Error: L2repl must be between 0 and 3\n");
-                    return 2;
-                }
-
-                L2CACHE_REPL = (ReplacementPolicy)l2repl;
-            }
-
-            else if (strcasecmp(argv[i], "-SWP_core0ways") == 0)
-            {
-                if (++i >= argc)
-                {
-                    fprintf(stderr, "Error: missing argument to "
-                                    "-SWP_core0ways\n");
-                    return 2;
-                }
-                SWP_CORE0_WAYS = atoi(argv[i]);
-            }
-
-            else if (strcasecmp(argv[i], "-dram_policy") == 0)
+            else
             {
-                if (++i >= argc)
+                int status = config_parse_option(argc, argv, &i);
+                if (status == 1)
                 {
-                    fprintf(stderr, "Error: missing argument to "
-                                    "-dram_policy\n");
+                    fprintf(stderr, "Error: unrecognized option: %s\n",
+                            argv[i]);
                     return 2;
                 }
-
-                int dram_policy = atoi(argv[i]);
-                if (dram_policy < 0 || dram_policy > 1)
+                if (status != 0)
                 {
-                    fprintf(stderr, "Error: dram_policy must be between 0 and 1\n");
-                    return 2;
+                    return status;
                 }
-
-                DRAM_PAGE_POLICY = (DRAMPolicy)dram_policy;
-            }
-
-            else
-            {
-                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
-                return 2;
             }
         }
         else
@@ -344,7 +194,42 @@ void print_stats()
         core_print_stats(core[i]);
     }
 
+    if (memsys->memctrl && NUM_CORES > 1)
+    {
+        // Unfairness: the slowdown of the worst-treated core.
+        double max_slowdown = 1.0;
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            double slowdown = memctrl_core_slowdown(
+                memsys->memctrl, i, core[i]->done_cycle_count);
+            if (slowdown > max_slowdown)
+            {
+                max_slowdown = slowdown;
+            }
+        }
+        printf("\n");
+        printf("MAX_SLOWDOWN         \t\t : %10.3f\n", max_slowdown);
+    }
+
     memsys_print_stats(memsys);
+
+    if (memsys->prof)
+    {
+        prof_print_stats(memsys->prof, PROFILE_TOPN);
+    }
+
+    if (memsys->heatmap)
+    {
+        memsys_dump_heatmap(memsys);
+        heatmap_free(memsys->heatmap);
+        memsys->heatmap = NULL;
+    }
+
+    if (memsys->dram && memsys->dram->rec)
+    {
+        dramrec_finish(memsys->dram->rec);
+        memsys->dram->rec = NULL;
+    }
 }
 
 void print_usage(const char *program_name)
@@ -354,31 +239,5 @@ void print_usage(const char *program_name)
     fprintf(stderr, "\n");
     fprintf(stderr, "Trace driven memory system simulator\n");
     fprintf(stderr, "\n");
-    fprintf(stderr, "    -mode <num>             Set mode of the simulator "
-                    "[1: part A, 2: part B,\n");
-    fprintf(stderr, "                            3: part C, 4: part D/E/F] "
-                    "(default: 1)\n");
-    fprintf(stderr, "    -linesize <num>         Set cache line size in bytes "
-                    "for all caches\n");
-    fprintf(stderr, "                            (default: 64)\n");
-    fprintf(stderr, "    -repl <num>             Set replacement policy for "
-                    "L1 cache [0: LRU,\n");
-    fprintf(stderr, "                            1: random, 2: SWP, 3: DWP] "
-                    "(default: 0)\n");
-    fprintf(stderr, "    -DsizeKB <num>          Set capacity in KB of the L1 "
-                    "dcache (default: 32 KB)\n");
-    fprintf(stderr, "    -Dassoc <num>           Set associativity of the L1 "
-                    "dcache (default: 8)\n");
-    fprintf(stderr, "    -L2sizeKB <num>         Set capacity in KB of the "
-                    "unified L2 cache\n");
-    fprintf(stderr, "                            (default: 512 KB)\n");
-    fprintf(stderr, "    -L2repl <num>           Set replacement policy for "
-                    "L2 cache [0: LRU,\n");
-    fprintf(stderr, "                            1: random, 2: SWP, 3: DWP] "
-                    "(default: 0)\n");
-    fprintf(stderr, "    -SWP_core0ways <num>    Set static quota for core 0 "
-                    "in SWP (default: 1)\n");
-    fprintf(stderr, "    -dram_policy <num>      Set DRAM page policy "
-                    "[0: open-page, 1: close-page]\n");
-    fprintf(stderr, "                            (default: 0)\n");
+    config_print_usage();
 }
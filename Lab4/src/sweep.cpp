@@ -0,0 +1,700 @@
+// sweep.cpp
+// Runs many memory system configurations over the same traces in parallel and
+// collects their results in a single CSV file.
+//
+// Each trace is decoded once into memory and shared by every configuration.
+// A configuration runs on its own thread, so the thread-local simulator state
+// declared in config.h starts out at its defaults for every configuration.
+//
+// The configuration file has one configuration per line: a name followed by
+// the same options that sim accepts. Blank lines and lines starting with '#'
+// are ignored. For example:
+//
+//     A.repl_lru  -mode 1 -repl 0
+//     C.S1MB.OP   -mode 3 -L2sizeKB 1024 -dram_policy 0
+//
+// Since configurations run at the same time, the name of each configuration
+// is appended to its -heatmap prefix, so that each writes its own files.
+
+#include "types.h"
+#include "memsys.h"
+#include "core.h"
+#include "config.h"
+#include "eventq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+#define MAX_CORES 2
+#define MAX_LINE_LEN 4096
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** One configuration from the configuration file, and its results. */
+typedef struct SweepConfig
+{
+    /** The name of the configuration, printed in the first CSV column. */
+    char *name;
+    /** The options, in the form accepted by config_parse_option(). */
+    int argc;
+    char **argv;
+    /** The prefix of the heatmap files, or NULL if heatmaps are disabled. */
+    char *heatmap_prefix;
+
+    /** Whether the configuration ran to completion. */
+    bool done;
+
+    uint64_t cycles;
+    unsigned long long core_inst[MAX_CORES];
+    unsigned long long core_cycles[MAX_CORES];
+
+    double ifetch_delay_avg;
+    double load_delay_avg;
+    double store_delay_avg;
+
+    double icache_miss_perc;
+    double dcache_miss_perc;
+    double l2cache_miss_perc;
+
+    double dram_read_delay_avg;
+    double dram_write_delay_avg;
+} SweepConfig;
+
+/**
+ * A reusable barrier that keeps lock-step threads within one epoch of each
+ * other. Threads that finish leave the barrier so the others are not held up.
+ */
+typedef struct EpochBarrier
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    unsigned int participants;
+    unsigned int waiting;
+    unsigned long long generation;
+} EpochBarrier;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              GLOBAL VARIABLES                             //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The decoded traces, shared read-only by every configuration. */
+uint8_t *trace_buf[MAX_CORES];
+size_t trace_buf_size[MAX_CORES];
+unsigned int num_traces;
+
+std::vector<SweepConfig> configs;
+
+/** The number of configurations simulated at the same time. */
+unsigned int num_threads;
+/** The epoch length in cycles for lock-step runs, or 0 to run independently. */
+uint64_t lockstep_cycles;
+
+const char *config_filename;
+const char *out_filename;
+
+EpochBarrier barrier;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+int parse_args(int argc, char **argv);
+int load_configs(const char *filename);
+int check_config(SweepConfig *cfg, const char *filename,
+                 unsigned int line_num);
+void run_config(SweepConfig *cfg);
+void barrier_wait(EpochBarrier *b);
+void barrier_leave(EpochBarrier *b);
+double cache_miss_perc(Cache *c0, Cache *c1);
+int write_csv(const char *filename);
+void print_usage(const char *program_name);
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    int status = parse_args(argc, argv);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    status = load_configs(config_filename);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    for (unsigned int i = 0; i < num_traces; i++)
+    {
+        trace_buf[i] = trace_load(argv[argc - num_traces + i],
+                                  &trace_buf_size[i]);
+        if (!trace_buf[i])
+        {
+            return 1;
+        }
+    }
+
+    if (lockstep_cycles)
+    {
+        // The configurations step through the traces together, in groups of
+        // as many as run at once.
+        for (size_t first = 0; first < configs.size(); first += num_threads)
+        {
+            size_t last = std::min(configs.size(), first + num_threads);
+            barrier.participants = last - first;
+            std::vector<std::thread> threads;
+            for (size_t i = first; i < last; i++)
+            {
+                threads.push_back(std::thread(run_config, &configs[i]));
+            }
+            for (size_t i = 0; i < threads.size(); i++)
+            {
+                threads[i].join();
+            }
+        }
+    }
+    else
+    {
+        // Each worker claims the next configuration and runs it on a fresh
+        // thread, so that its thread-local state starts from the defaults.
+        std::atomic<size_t> next_config(0);
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < num_threads; w++)
+        {
+            workers.push_back(std::thread([&next_config]() {
+                size_t i;
+                while ((i = next_config++) < configs.size())
+                {
+                    std::thread(run_config, &configs[i]).join();
+                }
+            }));
+        }
+        for (size_t w = 0; w < workers.size(); w++)
+        {
+            workers[w].join();
+        }
+    }
+
+    return write_csv(out_filename);
+}
+
+int parse_args(int argc, char **argv)
+{
+    num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+    lockstep_cycles = 0;
+    out_filename = "sweep.csv";
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcasecmp(argv[i], "-h") == 0 ||
+            strcasecmp(argv[i], "-help") == 0)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else if (strcasecmp(argv[i], "-threads") == 0 && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+            if (num_threads == 0)
+            {
+                fprintf(stderr, "Error: -threads must be positive\n");
+                return 2;
+            }
+        }
+        else if (strcasecmp(argv[i], "-lockstep") == 0 && i + 1 < argc)
+        {
+            lockstep_cycles = strtoull(argv[++i], NULL, 10);
+            if (lockstep_cycles == 0)
+            {
+                fprintf(stderr, "Error: -lockstep must be positive\n");
+                return 2;
+            }
+        }
+        else if (strcasecmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            out_filename = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (i >= argc)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+    config_filename = argv[i++];
+
+    num_traces = argc - i;
+    if (num_traces == 0)
+    {
+        fprintf(stderr, "Error: no trace file specified\n");
+        return 2;
+    }
+    if (num_traces > MAX_CORES)
+    {
+        fprintf(stderr, "Error: too many trace files specified\n");
+        return 2;
+    }
+
+    return 0;
+}
+
+/**
+ * Read the configuration file and check every configuration's options.
+ *
+ * @param filename The configuration file.
+ * @return 0 on success, or a non-zero exit status.
+ */
+int load_configs(const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+    {
+        perror("Couldn't open configuration file");
+        return 1;
+    }
+
+    char line[MAX_LINE_LEN];
+    unsigned int line_num = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        line_num++;
+
+        SweepConfig cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.argv = (char **)calloc(strlen(line) + 1, sizeof(char *));
+
+        // The option parser expects argv[0] to be the program name, so the
+        // configuration name takes its place.
+        for (char *tok = strtok(line, " \t\r\n"); tok;
+             tok = strtok(NULL, " \t\r\n"))
+        {
+            cfg.argv[cfg.argc++] = strdup(tok);
+        }
+
+        if (cfg.argc == 0 || cfg.argv[0][0] == '#')
+        {
+            for (int i = 0; i < cfg.argc; i++)
+            {
+                free(cfg.argv[i]);
+            }
+            free(cfg.argv);
+            continue;
+        }
+        cfg.name = cfg.argv[0];
+
+        // Parse the options once here so that mistakes are reported before
+        // anything runs. Like a run, this happens on a thread of its own so
+        // that every line starts from the default configuration.
+        int status;
+        std::thread([&]() {
+            status = check_config(&cfg, filename, line_num);
+        }).join();
+        if (status != 0)
+        {
+            fclose(fp);
+            return status;
+        }
+
+        if (cfg.heatmap_prefix)
+        {
+            for (size_t c = 0; c < configs.size(); c++)
+            {
+                if (configs[c].heatmap_prefix &&
+                    strcmp(configs[c].heatmap_prefix, cfg.heatmap_prefix) == 0)
+                {
+                    fprintf(stderr, "Error: %s:%u: configuration %s writes "
+                                    "the same heatmap files as %s\n",
+                            filename, line_num, cfg.name, configs[c].name);
+                    fclose(fp);
+                    return 2;
+                }
+            }
+        }
+
+        configs.push_back(cfg);
+    }
+
+    fclose(fp);
+
+    if (configs.empty())
+    {
+        fprintf(stderr, "Error: no configurations in %s\n", filename);
+        return 2;
+    }
+
+    return 0;
+}
+
+/**
+ * Parse the options of one configuration, check that it can run on the
+ * traces, and set its heatmap prefix.
+ *
+ * This must run on a thread of its own, since it changes the thread-local
+ * simulator state.
+ *
+ * @param cfg The configuration.
+ * @param filename The configuration file, for error messages.
+ * @param line_num The line of the configuration, for error messages.
+ * @return 0 on success, or a non-zero exit status.
+ */
+int check_config(SweepConfig *cfg, const char *filename,
+                 unsigned int line_num)
+{
+    for (int i = 1; i < cfg->argc; i++)
+    {
+        int status = config_parse_option(cfg->argc, cfg->argv, &i);
+        if (status != 0)
+        {
+            fprintf(stderr, "Error: %s:%u: bad option: %s\n", filename,
+                    line_num, cfg->argv[i]);
+            return 2;
+        }
+    }
+
+    if (SIM_MODE == SIM_MODE_DEF && num_traces != 2)
+    {
+        fprintf(stderr, "Error: %s:%u: mode 4 needs two trace files\n",
+                filename, line_num);
+        return 2;
+    }
+
+    if (HEATMAP_PREFIX)
+    {
+        size_t len = strlen(HEATMAP_PREFIX) + strlen(cfg->name) + 2;
+        cfg->heatmap_prefix = (char *)malloc(len);
+        snprintf(cfg->heatmap_prefix, len, "%s_%s", HEATMAP_PREFIX,
+                 cfg->name);
+    }
+
+    return 0;
+}
+
+/**
+ * Simulate one configuration to completion and record its results.
+ *
+ * This must run on a thread of its own, since it changes the thread-local
+ * simulator state.
+ *
+ * @param cfg The configuration.
+ */
+void run_config(SweepConfig *cfg)
+{
+    for (int i = 1; i < cfg->argc; i++)
+    {
+        config_parse_option(cfg->argc, cfg->argv, &i);
+    }
+    HEATMAP_PREFIX = cfg->heatmap_prefix;
+    NUM_CORES = num_traces;
+    current_cycle = 0;
+
+    MemorySystem *memsys = memsys_new();
+    Core *core[MAX_CORES];
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        core[i] = core_new_from_buffer(memsys, trace_buf[i],
+                                       trace_buf_size[i], i);
+    }
+
+    // Queue the first cycle of every core.
+    EventQueue *events = eventq_new(NUM_CORES);
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        if (!core[i]->done)
+        {
+            eventq_push(events, current_cycle, i);
+        }
+    }
+
+    // Iterate until all cores are done, jumping from each cycle to the next
+    // one in which a core wakes up, the memory system has work to do, or the
+    // threads meet at the barrier.
+    while (true)
+    {
+        // Requests whose data arrives this cycle complete before the cores
+        // run.
+        memsys_cycle(memsys);
+
+        while (eventq_next_cycle(events) <= current_cycle)
+        {
+            unsigned int i = eventq_pop(events);
+            core_cycle(core[i]);
+            if (!core[i]->done)
+            {
+                eventq_push(events, core_next_cycle(core[i]), i);
+            }
+        }
+
+        if (eventq_next_cycle(events) == UINT64_MAX)
+        {
+            break;
+        }
+
+        uint64_t next = eventq_next_cycle(events);
+        if (next > current_cycle + 1)
+        {
+            next = std::min(next, memsys_next_cycle(memsys));
+        }
+        if (lockstep_cycles)
+        {
+            uint64_t epoch_end =
+                (current_cycle / lockstep_cycles + 1) * lockstep_cycles;
+            if (next >= epoch_end)
+            {
+                current_cycle = epoch_end;
+                barrier_wait(&barrier);
+                continue;
+            }
+        }
+        current_cycle = next;
+    }
+    current_cycle++;
+    eventq_free(events);
+
+    if (lockstep_cycles)
+    {
+        barrier_leave(&barrier);
+    }
+
+    cfg->cycles = current_cycle;
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        cfg->core_inst[i] = core[i]->done_inst_count;
+        cfg->core_cycles[i] = core[i]->done_cycle_count;
+        core_free(core[i]);
+    }
+
+    if (memsys->stat_ifetch_access)
+    {
+        cfg->ifetch_delay_avg = (double)(memsys->stat_ifetch_delay) /
+                                (double)(memsys->stat_ifetch_access);
+    }
+    if (memsys->stat_load_access)
+    {
+        cfg->load_delay_avg = (double)(memsys->stat_load_delay) /
+                              (double)(memsys->stat_load_access);
+    }
+    if (memsys->stat_store_access)
+    {
+        cfg->store_delay_avg = (double)(memsys->stat_store_delay) /
+                               (double)(memsys->stat_store_access);
+    }
+
+    if (SIM_MODE == SIM_MODE_DEF)
+    {
+        cfg->icache_miss_perc = cache_miss_perc(memsys->icache_coreid[0],
+                                                memsys->icache_coreid[1]);
+        cfg->dcache_miss_perc = cache_miss_perc(memsys->dcache_coreid[0],
+                                                memsys->dcache_coreid[1]);
+    }
+    else
+    {
+        cfg->icache_miss_perc = cache_miss_perc(memsys->icache, NULL);
+        cfg->dcache_miss_perc = cache_miss_perc(memsys->dcache, NULL);
+    }
+    cfg->l2cache_miss_perc = cache_miss_perc(memsys->l2cache, NULL);
+
+    DRAM *dram = memsys->dram;
+    if (dram && dram->stat_read_access)
+    {
+        cfg->dram_read_delay_avg = (double)(dram->stat_read_delay) /
+                                   (double)(dram->stat_read_access);
+    }
+    if (dram && dram->stat_write_access)
+    {
+        cfg->dram_write_delay_avg = (double)(dram->stat_write_delay) /
+                                    (double)(dram->stat_write_access);
+    }
+
+    if (memsys->heatmap)
+    {
+        memsys_dump_heatmap(memsys);
+        heatmap_free(memsys->heatmap);
+        memsys->heatmap = NULL;
+    }
+
+    memsys_free(memsys);
+
+    cfg->done = true;
+}
+
+/**
+ * Wait until every thread still taking part in the barrier has arrived.
+ *
+ * @param b The barrier.
+ */
+void barrier_wait(EpochBarrier *b)
+{
+    std::unique_lock<std::mutex> guard(b->lock);
+    unsigned long long generation = b->generation;
+
+    b->waiting++;
+    if (b->waiting == b->participants)
+    {
+        b->waiting = 0;
+        b->generation++;
+        b->cond.notify_all();
+        return;
+    }
+
+    while (generation == b->generation)
+    {
+        b->cond.wait(guard);
+    }
+}
+
+/**
+ * Stop taking part in the barrier, releasing the others if they were only
+ * waiting for this thread.
+ *
+ * @param b The barrier.
+ */
+void barrier_leave(EpochBarrier *b)
+{
+    std::unique_lock<std::mutex> guard(b->lock);
+
+    b->participants--;
+    if (b->waiting && b->waiting == b->participants)
+    {
+        b->waiting = 0;
+        b->generation++;
+        b->cond.notify_all();
+    }
+}
+
+/**
+ * Compute the combined read and write miss percentage of up to two caches.
+ *
+ * @param c0 The first cache, or NULL.
+ * @param c1 The second cache, or NULL.
+ * @return The miss percentage, or 0 if the caches were never accessed.
+ */
+double cache_miss_perc(Cache *c0, Cache *c1)
+{
+    unsigned long long access = 0;
+    unsigned long long miss = 0;
+
+    Cache *caches[2] = {c0, c1};
+    for (int i = 0; i < 2; i++)
+    {
+        if (caches[i])
+        {
+            access += caches[i]->stat_read_access +
+                      caches[i]->stat_write_access;
+            miss += caches[i]->stat_read_miss + caches[i]->stat_write_miss;
+        }
+    }
+
+    if (!access)
+    {
+        return 0.0;
+    }
+    return 100.0 * (double)miss / (double)access;
+}
+
+/**
+ * Write the results of every configuration to a CSV file.
+ *
+ * @param filename The output file, or "-" for stdout.
+ * @return 0 on success, or a non-zero exit status.
+ */
+int write_csv(const char *filename)
+{
+    FILE *fp = stdout;
+    if (strcmp(filename, "-") != 0)
+    {
+        fp = fopen(filename, "w");
+        if (!fp)
+        {
+            perror("Couldn't open output file");
+            return 1;
+        }
+    }
+
+    fprintf(fp, "name,cycles");
+    for (unsigned int i = 0; i < num_traces; i++)
+    {
+        fprintf(fp, ",core_%u_inst,core_%u_cycles,core_%u_ipc", i, i, i);
+    }
+    fprintf(fp, ",ifetch_avgdelay,load_avgdelay,store_avgdelay"
+                ",icache_miss_perc,dcache_miss_perc,l2cache_miss_perc"
+                ",dram_read_delay_avg,dram_write_delay_avg\n");
+
+    for (size_t c = 0; c < configs.size(); c++)
+    {
+        SweepConfig *cfg = &configs[c];
+
+        fprintf(fp, "%s,%llu", cfg->name, (unsigned long long)cfg->cycles);
+        for (unsigned int i = 0; i < num_traces; i++)
+        {
+            double ipc = 0.0;
+            if (cfg->core_cycles[i])
+            {
+                ipc = (double)(cfg->core_inst[i]) /
+                      (double)(cfg->core_cycles[i]);
+            }
+            fprintf(fp, ",%llu,%llu,%.3f", cfg->core_inst[i],
+                    cfg->core_cycles[i], ipc);
+        }
+        fprintf(fp, ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                cfg->ifetch_delay_avg, cfg->load_delay_avg,
+                cfg->store_delay_avg, cfg->icache_miss_perc,
+                cfg->dcache_miss_perc, cfg->l2cache_miss_perc,
+                cfg->dram_read_delay_avg, cfg->dram_write_delay_avg);
+    }
+
+    if (fp != stdout)
+    {
+        fclose(fp);
+    }
+    return 0;
+}
+
+void print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-option <value>] <config file> trace_0 "
+                    "<trace_1>\n",
+            program_name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Runs every configuration in the config file over the "
+                    "same traces in parallel\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "    -threads <num>        Number of configurations "
+                    "simulated at once (default: number of CPUs)\n");
+    fprintf(stderr, "    -lockstep <cycles>    Run -threads configurations at "
+                    "a time, synchronizing every <cycles> cycles\n");
+    fprintf(stderr, "                            (default: each configuration "
+                    "runs independently)\n");
+    fprintf(stderr, "    -o <file>             CSV output file, or - for "
+                    "stdout (default: sweep.csv)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Each line of the config file is a name followed by sim "
+                    "options:\n");
+    fprintf(stderr, "\n");
+    config_print_usage();
+}
@@ -0,0 +1,144 @@
+// tlb.cpp
+// Defines the functions for the translation lookaside buffers.
+
+#include "tlb.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The current clock cycle number.
+ *
+ * This is used as a timestamp for the LRU replacement policy.
+ */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION DEFINITIONS                           //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a TLB.
+ *
+ * @param num_entries The total number of entries.
+ * @param associativity The associativity, or 0 for a fully associative TLB.
+ * @return A pointer to the TLB.
+ */
+TLB *tlb_new(uint64_t num_entries, uint64_t associativity)
+{
+    TLB *tlb = (TLB *)calloc(1, sizeof(TLB));
+
+    tlb->num_ways = associativity ? associativity : num_entries;
+    tlb->num_sets = num_entries / tlb->num_ways;
+    if (tlb->num_sets == 0)
+    {
+        fprintf(stderr, "Error: a %llu-entry TLB can't be %llu-way "
+                        "associative\n",
+                (unsigned long long)num_entries,
+                (unsigned long long)tlb->num_ways);
+        exit(1);
+    }
+
+    tlb->entries = (TLBEntry *)calloc(tlb->num_sets * tlb->num_ways,
+                                      sizeof(TLBEntry));
+    return tlb;
+}
+
+/**
+ * Look up a translation, updating the LRU state and statistics.
+ *
+ * @param tlb The TLB.
+ * @param vpn The virtual page number, in units of the page size.
+ * @param huge Whether the page is a 2MB page.
+ * @param core_id The CPU core ID that requested this translation.
+ * @return Whether the lookup hit.
+ */
+bool tlb_lookup(TLB *tlb, uint64_t vpn, bool huge, unsigned int core_id)
+{
+    TLBEntry *set = &tlb->entries[(vpn % tlb->num_sets) * tlb->num_ways];
+
+    tlb->stat_access++;
+
+    for (uint64_t way = 0; way < tlb->num_ways; way++)
+    {
+        if (set[way].valid && set[way].vpn == vpn && set[way].huge == huge &&
+            set[way].core_id == core_id)
+        {
+            set[way].last_access_time = current_cycle;
+            return true;
+        }
+    }
+
+    tlb->stat_miss++;
+    return false;
+}
+
+/**
+ * Install a translation, replacing the least recently used entry in its set.
+ *
+ * @param tlb The TLB.
+ * @param vpn The virtual page number, in units of the page size.
+ * @param huge Whether the page is a 2MB page.
+ * @param core_id The CPU core ID that requested this translation.
+ */
+void tlb_install(TLB *tlb, uint64_t vpn, bool huge, unsigned int core_id)
+{
+    TLBEntry *set = &tlb->entries[(vpn % tlb->num_sets) * tlb->num_ways];
+
+    // Use an invalid entry if there is one, else the least recently used.
+    TLBEntry *victim = &set[0];
+    for (uint64_t way = 0; way < tlb->num_ways; way++)
+    {
+        if (!set[way].valid)
+        {
+            victim = &set[way];
+            break;
+        }
+        if (set[way].last_access_time < victim->last_access_time)
+        {
+            victim = &set[way];
+        }
+    }
+
+    victim->valid = true;
+    victim->huge = huge;
+    victim->vpn = vpn;
+    victim->core_id = core_id;
+    victim->last_access_time = current_cycle;
+}
+
+/**
+ * Print the statistics of the given TLB.
+ *
+ * @param tlb The TLB.
+ * @param header A label used as a prefix for each statistic.
+ */
+void tlb_print_stats(TLB *tlb, const char *header)
+{
+    double miss_percent = 0.0;
+
+    if (tlb->stat_access)
+    {
+        miss_percent = 100.0 * (double)(tlb->stat_miss) /
+                       (double)(tlb->stat_access);
+    }
+
+    printf("\n");
+    printf("%s_ACCESS    \t\t : %10llu\n", header, tlb->stat_access);
+    printf("%s_MISS      \t\t : %10llu\n", header, tlb->stat_miss);
+    printf("%s_MISS_PERC \t\t : %10.3f\n", header, miss_percent);
+}
+
+/**
+ * Free a TLB.
+ *
+ * @param tlb The TLB.
+ */
+void tlb_free(TLB *tlb)
+{
+    free(tlb->entries);
+    free(tlb);
+}
@@ -0,0 +1,88 @@
+// tlb.h
+// Declares the translation lookaside buffer structure and related functions.
+
+#ifndef __TLB_H__
+#define __TLB_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A single TLB entry. */
+typedef struct TLBEntry
+{
+    bool valid;
+    /** Whether this entry maps a 2MB page rather than a 4KB page. */
+    bool huge;
+    /** The virtual page number (in units of the entry's page size). */
+    uint64_t vpn;
+    /** The core whose address space the entry belongs to. */
+    unsigned int core_id;
+    uint64_t last_access_time; // LRU Time
+} TLBEntry;
+
+/** A set-associative TLB with LRU replacement. */
+typedef struct TLB
+{
+    uint64_t num_sets;
+    uint64_t num_ways;
+
+    /** num_sets * num_ways entries, way w of set s at s * num_ways + w. */
+    TLBEntry *entries;
+
+    unsigned long long stat_access;
+    unsigned long long stat_miss;
+} TLB;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a TLB.
+ *
+ * @param num_entries The total number of entries.
+ * @param associativity The associativity, or 0 for a fully associative TLB.
+ * @return A pointer to the TLB.
+ */
+TLB *tlb_new(uint64_t num_entries, uint64_t associativity);
+
+/**
+ * Look up a translation, updating the LRU state and statistics.
+ *
+ * @param tlb The TLB.
+ * @param vpn The virtual page number, in units of the page size.
+ * @param huge Whether the page is a 2MB page.
+ * @param core_id The CPU core ID that requested this translation.
+ * @return Whether the lookup hit.
+ */
+bool tlb_lookup(TLB *tlb, uint64_t vpn, bool huge, unsigned int core_id);
+
+/**
+ * Install a translation, replacing the least recently used entry in its set.
+ *
+ * @param tlb The TLB.
+ * @param vpn The virtual page number, in units of the page size.
+ * @param huge Whether the page is a 2MB page.
+ * @param core_id The CPU core ID that requested this translation.
+ */
+void tlb_install(TLB *tlb, uint64_t vpn, bool huge, unsigned int core_id);
+
+/**
+ * Print the statistics of the given TLB.
+ *
+ * @param tlb The TLB.
+ * @param header A label used as a prefix for each statistic.
+ */
+void tlb_print_stats(TLB *tlb, const char *header);
+
+/**
+ * Free a TLB.
+ *
+ * @param tlb The TLB.
+ */
+void tlb_free(TLB *tlb);
+
+#endif // __TLB_H__
@@ -36,4 +36,22 @@ typedef enum ModeEnum
     SIM_MODE_DEF = 4,   // Simulate a multicore system (in parts D, E, and F).
 } Mode;
 
+/** Possible timing models of the CPU cores. */
+typedef enum CoreModelEnum
+{
+    CORE_BLOCKING = 0,  // In order, stalling on every access that misses.
+    CORE_OOO = 1,       // Out of order, with an instruction window and LSQ.
+} CoreModel;
+
+/**
+ * Tracks the DRAM reads an access is waiting on when the memory controller
+ * is enabled. The controller decrements pending as each read returns and
+ * raises ready_cycle to the cycle its data arrived.
+ */
+typedef struct MemWait
+{
+    unsigned int pending;
+    uint64_t ready_cycle;
+} MemWait;
+
 #endif // __TYPES_H__